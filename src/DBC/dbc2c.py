@@ -0,0 +1,359 @@
+#!/usr/bin/env python3
+#
+# dbc2c.py
+#
+#      Author: Spiropoulos Vasilis
+#
+# Generates C packing / unpacking functions and message tables from a DBC file,
+# for the CAN_FRAME type of mcp2515.h.
+#
+# Usage: python3 dbc2c.py <file.dbc> <output base name> [--prefix GMLAN]
+#   e.g. python3 dbc2c.py corsa_ipc.dbc ../SDK/gmlan_dbc
+#   writes ../SDK/gmlan_dbc.h and ../SDK/gmlan_dbc.c
+#
+# For every message <MSG> and signal <SIG> the header gets:
+#   <PREFIX>_<MSG>_ID, <PREFIX>_<MSG>_LEN          message identifier and data length
+#   <PREFIX>_<SIG>_START, <PREFIX>_<SIG>_LEN       signal start bit and length (Intel numbering)
+#   <PREFIX>_<SIG>_<VALUE>                         VAL_ table entries
+#   <PREFIX>_<MSG>                                 struct with one raw field per signal
+#   <prefix>_pack<Msg>() / <prefix>_unpack<Msg>()  static inline, shifts and masks only
+#
+# The pack / unpack functions contain no branches and no table lookups, every position
+# is a constant, so the compiler folds them to the same code as hand-packed frames.
+# The .c file holds the message / signal tables (diagnostics only) and a round-trip
+# self test. Only the Python 3 standard library is needed.
+
+import os
+import re
+import sys
+
+
+class Signal:
+    def __init__(self, name, start, length, intel, signed, factor, offset, minimum, maximum, unit):
+        self.name = name
+        self.start = start
+        self.length = length
+        self.intel = intel
+        self.signed = signed
+        self.factor = factor
+        self.offset = offset
+        self.minimum = minimum
+        self.maximum = maximum
+        self.unit = unit
+        self.comment = ""
+        self.values = []            # (raw value, name)
+
+
+class Message:
+    def __init__(self, msg_id, name, length, sender):
+        self.id = msg_id
+        self.name = name
+        self.length = length
+        self.sender = sender
+        self.signals = []
+        self.comment = ""
+
+
+RE_BO = re.compile(r'^BO_\s+(\d+)\s+(\w+)\s*:\s*(\d+)\s+(\w+)')
+RE_SG = re.compile(r'^SG_\s+(\w+)\s*(M|m\d+)?\s*:\s*(\d+)\|(\d+)@([01])([+-])\s*'
+                   r'\(\s*([-+0-9.eE]+)\s*,\s*([-+0-9.eE]+)\s*\)\s*'
+                   r'\[\s*([-+0-9.eE]+)\s*\|\s*([-+0-9.eE]+)\s*\]\s*"([^"]*)"')
+RE_CM_BO = re.compile(r'^CM_\s+BO_\s+(\d+)\s+"([^"]*)"\s*;')
+RE_CM_SG = re.compile(r'^CM_\s+SG_\s+(\d+)\s+(\w+)\s+"([^"]*)"\s*;')
+RE_VAL = re.compile(r'^VAL_\s+(\d+)\s+(\w+)\s+(.*);')
+RE_VAL_ENTRY = re.compile(r'(-?\d+)\s+"([^"]*)"')
+
+
+def fail(msg):
+    sys.stderr.write("dbc2c: " + msg + "\n")
+    sys.exit(1)
+
+
+def parse_dbc(path):
+    messages = []
+    by_id = {}
+    msg = None
+    with open(path, encoding="latin-1") as f:
+        for line in f:
+            line = line.strip()
+            m = RE_BO.match(line)
+            if m:
+                msg_id = int(m.group(1)) & 0x1FFFFFFF
+                msg = Message(msg_id, m.group(2), int(m.group(3)), m.group(4))
+                if msg.length > 8:
+                    fail("message %s: data length %d > 8" % (msg.name, msg.length))
+                messages.append(msg)
+                by_id[int(m.group(1))] = msg
+                continue
+            m = RE_SG.match(line)
+            if m:
+                if msg is None:
+                    fail("signal %s outside a message" % m.group(1))
+                if m.group(2):
+                    fail("signal %s: multiplexed signals are not supported" % m.group(1))
+                sig = Signal(m.group(1), int(m.group(3)), int(m.group(4)), m.group(5) == "1",
+                             m.group(6) == "-", float(m.group(7)), float(m.group(8)),
+                             float(m.group(9)), float(m.group(10)), m.group(11))
+                msg.signals.append(sig)
+                continue
+            if not line.startswith("SG_"):
+                msg = None
+            m = RE_CM_BO.match(line)
+            if m and int(m.group(1)) in by_id:
+                by_id[int(m.group(1))].comment = m.group(2)
+                continue
+            m = RE_CM_SG.match(line)
+            if m and int(m.group(1)) in by_id:
+                for sig in by_id[int(m.group(1))].signals:
+                    if sig.name == m.group(2):
+                        sig.comment = m.group(3)
+                continue
+            m = RE_VAL.match(line)
+            if m and int(m.group(1)) in by_id:
+                for sig in by_id[int(m.group(1))].signals:
+                    if sig.name == m.group(2):
+                        sig.values = [(int(v), n) for v, n in RE_VAL_ENTRY.findall(m.group(3))]
+    return messages
+
+
+def check(messages):
+    names = set()
+    for msg in messages:
+        for sig in msg.signals:
+            if sig.name in names:
+                fail("signal name %s is not unique" % sig.name)
+            names.add(sig.name)
+            if sig.length < 1 or sig.length > 64:
+                fail("signal %s: length %d" % (sig.name, sig.length))
+            lo, hi = bit_span(sig)
+            if lo < 0 or hi >= msg.length * 8:
+                fail("signal %s does not fit in message %s" % (sig.name, msg.name))
+            if sig.factor != int(sig.factor) or sig.offset != 0:
+                sys.stderr.write("dbc2c: signal %s: only integer factors without offset go in the "
+                                 "signal table, raw values are packed unchanged\n" % sig.name)
+
+
+def bit_span(sig):
+    # Lowest and highest Intel bit index used by the signal
+    if sig.intel:
+        return sig.start, sig.start + sig.length - 1
+    msb = (sig.start // 8) * 8 + (7 - sig.start % 8)      # big-endian (Motorola) bit index
+    lsb = msb + sig.length - 1
+    bits = [(b // 8) * 8 + (7 - b % 8) for b in (msb, lsb)]
+    return min(bits), max(bits)
+
+
+def be_shift(sig):
+    # Shift of a Motorola signal inside the byte-swapped 64-bit data word
+    msb = (sig.start // 8) * 8 + (7 - sig.start % 8)
+    return 63 - (msb + sig.length - 1)
+
+
+def c_type(sig):
+    for bits, name in ((8, "u8"), (16, "u16"), (32, "u32"), (64, "u64")):
+        if sig.length <= bits:
+            return ("s" + name[1:]) if sig.signed and bits < 64 else name
+    return "u64"
+
+
+def mask(length):
+    return "0x%XULL" % ((1 << length) - 1)
+
+
+def camel(name):
+    return "".join(p.capitalize() for p in name.lower().split("_"))
+
+
+def field(sig):
+    return sig.name.lower()
+
+
+def gen_header(messages, prefix, dbc_name, base):
+    lp = prefix.lower()
+    guard = "SRC_" + base.upper() + "_H_"
+    o = []
+    o.append("/*")
+    o.append(" * %s.h" % base)
+    o.append(" *")
+    o.append(" *  Generated by dbc2c.py from %s, do not edit." % dbc_name)
+    o.append(" */")
+    o.append("")
+    o.append("#ifndef %s" % guard)
+    o.append("#define %s" % guard)
+    o.append("")
+    o.append('#include "xil_types.h"')
+    o.append('#include "mcp2515.h"\t\t// CAN_FRAME, BytesUnion')
+    o.append("")
+    o.append("")
+    o.append("// Signal table entry, used for diagnostics and by the self test")
+    o.append("typedef struct {")
+    o.append("\tconst char *name;")
+    o.append("\tu32 id;\t\t\t\t// message identifier")
+    o.append("\tu8 start;\t\t\t// start bit, Intel order")
+    o.append("\tu8 len;\t\t\t\t// length in bits")
+    o.append("\tu16 scale;\t\t\t// physical units per raw count")
+    o.append("} %s_SIGNAL;" % prefix)
+    o.append("")
+    o.append("// Message table entry")
+    o.append("typedef struct {")
+    o.append("\tconst char *name;")
+    o.append("\tu32 id;")
+    o.append("\tu8 length;")
+    o.append("\tu8 first_signal;\t\t// index in %s_signals[]" % lp)
+    o.append("\tu8 signal_cnt;")
+    o.append("} %s_MESSAGE;" % prefix)
+    o.append("")
+    o.append("extern const %s_SIGNAL %s_signals[];" % (prefix, lp))
+    o.append("extern const u8 %s_signal_cnt;" % lp)
+    o.append("extern const %s_MESSAGE %s_messages[];" % (prefix, lp))
+    o.append("extern const u8 %s_message_cnt;" % lp)
+    o.append("")
+    for msg in messages:
+        o.append("")
+        o.append("// %s%s" % (msg.name, (": " + msg.comment) if msg.comment else ""))
+        o.append("#define %s_%s_ID\t\t0x%03X" % (prefix, msg.name, msg.id))
+        o.append("#define %s_%s_LEN\t\t%d" % (prefix, msg.name, msg.length))
+        for sig in msg.signals:
+            o.append("")
+            if sig.comment:
+                o.append("// %s: %s" % (sig.name, sig.comment))
+            if not sig.intel:
+                o.append("// Motorola byte order, START is the DBC msb position")
+            o.append("#define %s_%s_START\t%d" % (prefix, sig.name, sig.start))
+            o.append("#define %s_%s_LEN\t%d" % (prefix, sig.name, sig.length))
+            for value, name in sig.values:
+                o.append("#define %s_%s_%s\t0x%X" % (prefix, sig.name, name, value & ((1 << sig.length) - 1)))
+        o.append("")
+        o.append("typedef struct {")
+        for sig in msg.signals:
+            o.append("\t%s %s;" % (c_type(sig), field(sig)))
+        o.append("} %s_%s;" % (prefix, msg.name))
+        o.append("")
+        # pack
+        intel = [s for s in msg.signals if s.intel]
+        motorola = [s for s in msg.signals if not s.intel]
+        o.append("static inline void %s_pack%s(CAN_FRAME *frame, const %s_%s *msg) {" % (lp, camel(msg.name), prefix, msg.name))
+        o.append("\tframe->id = %s_%s_ID;" % (prefix, msg.name))
+        o.append("\tframe->length = %s_%s_LEN;" % (prefix, msg.name))
+        terms = ["(((u64)msg->%s & %s) << %d)" % (field(s), mask(s.length), s.start) for s in intel]
+        if motorola:
+            be = ["(((u64)msg->%s & %s) << %d)" % (field(s), mask(s.length), be_shift(s)) for s in motorola]
+            terms.append("__builtin_bswap64(" + "\n\t                  | ".join(be) + ")")
+        if not terms:
+            terms = ["0"]
+        o.append("\tframe->data.value = " + "\n\t                  | ".join(terms) + ";")
+        o.append("}")
+        o.append("")
+        # unpack
+        o.append("static inline void %s_unpack%s(const CAN_FRAME *frame, %s_%s *msg) {" % (lp, camel(msg.name), prefix, msg.name))
+        if motorola:
+            o.append("\tu64 be = __builtin_bswap64(frame->data.value);")
+        for s in msg.signals:
+            src = "frame->data.value" if s.intel else "be"
+            shift = s.start if s.intel else be_shift(s)
+            if s.signed and s.length < 64:
+                # sign extension by shifting the field to the top of a signed word
+                o.append("\tmsg->%s = (%s)((s64)(%s << %d) >> %d);" % (field(s), c_type(s), src, 64 - s.length - shift, 64 - s.length))
+            else:
+                o.append("\tmsg->%s = (%s)((%s >> %d) & %s);" % (field(s), c_type(s), src, shift, mask(s.length)))
+        o.append("}")
+    o.append("")
+    o.append("")
+    o.append("int %s_dbcSelfTest();" % lp)
+    o.append("")
+    o.append("")
+    o.append("#endif /* %s */" % guard)
+    return "\n".join(o) + "\n"
+
+
+def gen_source(messages, prefix, dbc_name, base):
+    lp = prefix.lower()
+    o = []
+    o.append("/*")
+    o.append(" * %s.c" % base)
+    o.append(" *")
+    o.append(" *  Generated by dbc2c.py from %s, do not edit." % dbc_name)
+    o.append(" */")
+    o.append("")
+    o.append('#include "%s.h"' % base)
+    o.append('#include "xil_printf.h"')
+    o.append('#include "xstatus.h"')
+    o.append("")
+    o.append("const %s_SIGNAL %s_signals[] = {" % (prefix, lp))
+    for msg in messages:
+        for s in msg.signals:
+            o.append('\t{ "%s", %s_%s_ID, %s_%s_START, %s_%s_LEN, %d },' % (
+                s.name, prefix, msg.name, prefix, s.name, prefix, s.name, max(1, int(s.factor))))
+    o.append("};")
+    o.append("")
+    o.append("const u8 %s_signal_cnt = sizeof(%s_signals) / sizeof(%s_signals[0]);" % (lp, lp, lp))
+    o.append("")
+    o.append("const %s_MESSAGE %s_messages[] = {" % (prefix, lp))
+    idx = 0
+    for msg in messages:
+        o.append('\t{ "%s", %s_%s_ID, %s_%s_LEN, %d, %d },' % (msg.name, prefix, msg.name, prefix, msg.name, idx, len(msg.signals)))
+        idx += len(msg.signals)
+    o.append("};")
+    o.append("")
+    o.append("const u8 %s_message_cnt = sizeof(%s_messages) / sizeof(%s_messages[0]);" % (lp, lp, lp))
+    o.append("")
+    o.append("")
+    o.append("// Round trip of every message with all-ones and alternating bit patterns,")
+    o.append("// checks that pack followed by unpack returns every signal unchanged")
+    o.append("int %s_dbcSelfTest() {" % lp)
+    o.append("\tCAN_FRAME frame;")
+    o.append("\tint Status = XST_SUCCESS;")
+    for msg in messages:
+        o.append("")
+        o.append("\t{")
+        o.append("\t\t%s_%s in, out;" % (prefix, msg.name))
+        o.append("\t\tfor (u8 pattern = 0; pattern < 3; pattern++) {")
+        o.append("\t\t\tu64 bits = (pattern == 0) ? ~0ULL : (pattern == 1) ? 0x5555555555555555ULL : 0xAAAAAAAAAAAAAAAAULL;")
+        for s in msg.signals:
+            o.append("\t\t\tin.%s = (%s)(bits & %s);" % (field(s), c_type(s), mask(s.length)))
+            if s.signed and s.length < 64:
+                o.append("\t\t\tin.%s = (%s)((s64)((u64)in.%s << %d) >> %d);" % (field(s), c_type(s), field(s), 64 - s.length, 64 - s.length))
+        o.append("\t\t\t%s_pack%s(&frame, &in);" % (lp, camel(msg.name)))
+        o.append("\t\t\t%s_unpack%s(&frame, &out);" % (lp, camel(msg.name)))
+        for s in msg.signals:
+            o.append("\t\t\tif (in.%s != out.%s) {" % (field(s), field(s)))
+            o.append('\t\t\t\txil_printf("%s round trip failed \\n");' % s.name)
+            o.append("\t\t\t\tStatus = XST_FAILURE;")
+            o.append("\t\t\t}")
+        o.append("\t\t}")
+        o.append("\t}")
+    o.append("")
+    o.append("\treturn Status;")
+    o.append("}")
+    return "\n".join(o) + "\n"
+
+
+def main(argv):
+    args = [a for a in argv[1:] if not a.startswith("--")]
+    prefix = "GMLAN"
+    for i, a in enumerate(argv):
+        if a == "--prefix" and i + 1 < len(argv):
+            prefix = argv[i + 1].upper()
+            args.remove(argv[i + 1])
+    if len(args) != 2:
+        sys.stderr.write(__doc__ if __doc__ else "usage: dbc2c.py <file.dbc> <output base name> [--prefix NAME]\n")
+        return 1
+
+    dbc_path, out = args
+    messages = parse_dbc(dbc_path)
+    if not messages:
+        fail("no messages in " + dbc_path)
+    check(messages)
+
+    base = os.path.basename(out)
+    dbc_name = os.path.basename(dbc_path)
+    # CRLF line endings, as the other SDK sources
+    with open(out + ".h", "w", newline="\r\n") as f:
+        f.write(gen_header(messages, prefix, dbc_name, base))
+    with open(out + ".c", "w", newline="\r\n") as f:
+        f.write(gen_source(messages, prefix, dbc_name, base))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,86 @@
+/*
+ * anim.c
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#include "anim.h"
+
+
+// Value of the track at time t. The current keyframe only moves forward.
+static u8 anim_evaluate(ANIM_TRACK *track, u16 t) {
+	while (((track->key + 1) < track->key_cnt) && (t >= track->keys[track->key + 1].time))
+		track->key++;
+
+	const ANIM_KEY *k0 = &track->keys[track->key];
+	if ((k0->curve == ANIM_STEP) || ((track->key + 1) >= track->key_cnt) || (t <= k0->time))
+		return k0->value;
+
+	const ANIM_KEY *k1 = k0 + 1;
+	s32 dv = (s32)k1->value - (s32)k0->value;
+	s32 dt = (s32)(t - k0->time);
+	s32 span = (s32)(k1->time - k0->time);
+	if (dv >= 0)
+		return k0->value + (u8)((dv * dt) / span);
+	return k0->value - (u8)((-dv * dt) / span);
+}
+
+void anim_trackInit(ANIM_TRACK *track, const ANIM_KEY keys[], u8 key_cnt) {
+	track->keys = keys;
+	track->key_cnt = key_cnt;
+	track->key = 0;
+	track->value = (key_cnt > 0) ? keys[0].value : 0;
+	track->changed = false;
+}
+
+void anim_init(ANIM *anim, ANIM_TRACK tracks[], u8 track_cnt) {
+	anim->tracks = tracks;
+	anim->track_cnt = track_cnt;
+	anim->duration = 0;
+	for (u8 i = 0; i < track_cnt; i++) {
+		if ((tracks[i].key_cnt > 0) && (tracks[i].keys[tracks[i].key_cnt - 1].time > anim->duration))
+			anim->duration = tracks[i].keys[tracks[i].key_cnt - 1].time;
+	}
+	anim->state = ANIM_IDLE;
+}
+
+// Starts (or restarts) the animation, the first anim_update() reports every track as changed
+void anim_start(ANIM *anim, u32 now) {
+	for (u8 i = 0; i < anim->track_cnt; i++) {
+		anim->tracks[i].key = 0;
+		anim->tracks[i].changed = false;
+	}
+	anim->start = now;
+	anim->state = ANIM_RUNNING;
+	anim->first = true;
+}
+
+// Advances the animation to time now (msec). Returns true if any track value changed,
+// check track->changed for which ones. The state becomes ANIM_DONE after the last keyframe.
+bool anim_update(ANIM *anim, u32 now) {
+	if (anim->state != ANIM_RUNNING)
+		return false;
+
+	u32 elapsed = now - anim->start;
+	u16 t = (elapsed >= anim->duration) ? anim->duration : (u16)elapsed;
+	bool any = false;
+
+	for (u8 i = 0; i < anim->track_cnt; i++) {
+		ANIM_TRACK *track = &anim->tracks[i];
+		if (track->key_cnt == 0)
+			continue;
+		u8 value = anim_evaluate(track, t);
+		track->changed = anim->first || (value != track->value);
+		track->value = value;
+		any |= track->changed;
+	}
+
+	anim->first = false;
+	if (elapsed >= anim->duration)
+		anim->state = ANIM_DONE;
+	return any;
+}
+
+bool anim_running(ANIM *anim) {
+	return (anim->state == ANIM_RUNNING);
+}
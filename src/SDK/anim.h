@@ -0,0 +1,63 @@
+/*
+ * anim.h
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#ifndef SRC_ANIM_H_
+#define SRC_ANIM_H_
+
+#include "xil_types.h"
+#include "stdbool.h"
+
+
+// Keyframe animation engine.
+// An animation is a set of tracks on a common timeline (msec from its start). A track is a list
+// of keyframes, each with the curve used up to the next keyframe: ANIM_STEP holds the value,
+// ANIM_LINEAR interpolates (rounded down, so a ramp of n over n*T msec steps once every T msec).
+// What a value means is up to the application: a dial position, an index into a table of led
+// masks or segment patterns, a mode flag.
+// anim_update() is called from the main loop with the 1 msec counter. It only moves forward
+// through the keyframes, so every call costs the same, and it reports which tracks changed,
+// so the application redraws only when something moved. Nothing blocks.
+
+#define ANIM_STEP        0
+#define ANIM_LINEAR      1
+
+// Animation states
+#define ANIM_IDLE        0
+#define ANIM_RUNNING     1
+#define ANIM_DONE        2
+
+typedef struct {
+	u16 time;				// msec from the start of the animation, ascending
+	u8 value;
+	u8 curve;				// ANIM_STEP or ANIM_LINEAR towards the next keyframe
+} ANIM_KEY;
+
+typedef struct {
+	const ANIM_KEY *keys;
+	u8 key_cnt;
+	u8 key;					// current keyframe, keys[key].time <= time < keys[key + 1].time
+	u8 value;				// current value
+	bool changed;			// value changed by the last anim_update()
+} ANIM_TRACK;
+
+typedef struct {
+	ANIM_TRACK *tracks;
+	u8 track_cnt;
+	u16 duration;			// time of the last keyframe of all tracks
+	u32 start;				// 1 msec counter value at anim_start()
+	u8 state;
+	bool first;				// next anim_update() is the first one, report every track
+} ANIM;
+
+
+void anim_trackInit(ANIM_TRACK *track, const ANIM_KEY keys[], u8 key_cnt);
+void anim_init(ANIM *anim, ANIM_TRACK tracks[], u8 track_cnt);
+void anim_start(ANIM *anim, u32 now);
+bool anim_update(ANIM *anim, u32 now);
+bool anim_running(ANIM *anim);
+
+
+#endif /* SRC_ANIM_H_ */
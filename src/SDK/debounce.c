@@ -0,0 +1,79 @@
+/*
+ * debounce.c
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#include "debounce.h"
+
+static u64 deb_mask;					// inputs that are debounced, the others never give events
+static u64 deb_state;					// debounced state
+static u64 deb_ct0, deb_ct1;			// vertical counter, bit n of both words is the count of input n
+static u64 deb_press;					// went high, not yet fetched by debounce_pressed()
+static u64 deb_release;					// went low, not yet fetched by debounce_released()
+static u16 deb_period;					// msec per sample
+static volatile u16 deb_ms;				// msec counted by debounce_tick() since the last sample
+
+
+// mask selects the debounced inputs, initial is the current snapshot (no events for it)
+void debounce_init(u64 mask, u64 initial, u16 stable_ms) {
+	deb_mask = mask;
+	deb_state = initial & mask;
+	deb_ct0 = ~(u64)0;
+	deb_ct1 = ~(u64)0;
+	deb_press = 0;
+	deb_release = 0;
+	deb_ms = 0;
+	debounce_setStable(stable_ms);
+}
+
+// Time an input must stay unchanged before its new state is accepted, rounded down to a multiple of DEBOUNCE_SAMPLES msec
+void debounce_setStable(u16 stable_ms) {
+	deb_period = stable_ms / DEBOUNCE_SAMPLES;
+	if (deb_period == 0)
+		deb_period = 1;
+}
+
+void debounce_tick() {
+	if (deb_ms < 0xFFFF)
+		deb_ms++;
+}
+
+// Main loop: true once the sample period elapsed, read the ports then and pass them to debounce_task()
+bool debounce_due() {
+	return deb_ms >= deb_period;
+}
+
+// Main loop: one sample of raw per sample period. Returns true if press or release events are waiting.
+bool debounce_task(u64 raw) {
+	if (deb_ms >= deb_period) {
+		deb_ms = 0;
+
+		u64 diff = (raw & deb_mask) ^ deb_state;	// inputs that differ from their debounced state
+		deb_ct0 = ~(deb_ct0 & diff);				// count down the differing inputs, the others restart at 3
+		deb_ct1 = deb_ct0 ^ (deb_ct1 & diff);
+		diff &= deb_ct0 & deb_ct1;					// counted past 0: DEBOUNCE_SAMPLES samples in a row
+		deb_state ^= diff;
+		deb_press |= diff & deb_state;
+		deb_release |= diff & ~deb_state;
+	}
+	return (deb_press | deb_release) != 0;
+}
+
+u64 debounce_state() {
+	return deb_state;
+}
+
+// Inputs pressed (went high) since the last call
+u64 debounce_pressed() {
+	u64 press = deb_press;
+	deb_press = 0;
+	return press;
+}
+
+// Inputs released (went low) since the last call
+u64 debounce_released() {
+	u64 release = deb_release;
+	deb_release = 0;
+	return release;
+}
@@ -0,0 +1,39 @@
+/*
+ * debounce.h
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#ifndef SRC_DEBOUNCE_H_
+#define SRC_DEBOUNCE_H_
+
+#include "xil_types.h"
+#include "stdbool.h"
+
+
+// Switch debouncing on the 48-bit MCP23S17 port snapshot (mcp_scanPorts, GPIO A & B only).
+// A 2-bit vertical counter per input, kept in two words for all inputs at once: an input
+// changes state only after DEBOUNCE_SAMPLES samples in a row differ from its debounced state,
+// a bounce restarts its count. One sample costs the same few word operations for any number of switches.
+// debounce_tick() runs in the 1 msec timer ISR and paces the samples. Once per sample period
+// (stable time / DEBOUNCE_SAMPLES) debounce_due() tells the main loop to read the ports, and
+// debounce_task() takes that sample: the inputs are sampled on the timer schedule, not only
+// when an interrupt makes the main loop read them.
+// Presses and releases are kept until fetched, so one that came and went between two input
+// passes is not lost.
+
+#define DEBOUNCE_SAMPLES     4			// samples per stable time (2-bit vertical counter)
+#define DEBOUNCE_STABLE_MS   20			// default stable time (msec)
+
+
+void debounce_init(u64 mask, u64 initial, u16 stable_ms);
+void debounce_setStable(u16 stable_ms);
+void debounce_tick();
+bool debounce_due();
+bool debounce_task(u64 raw);
+u64 debounce_state();
+u64 debounce_pressed();
+u64 debounce_released();
+
+
+#endif /* SRC_DEBOUNCE_H_ */
@@ -0,0 +1,180 @@
+/*
+ * display.c
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#include "display.h"
+
+static u8 disp_buf[2][MAX_CNT][8];		// front and back buffer
+static volatile u8 disp_front;			// index of the front buffer, the other one is the back buffer
+static volatile bool disp_pending;		// front buffer not yet sent
+static volatile bool disp_due;			// frame period elapsed, set by display_tick()
+static u16 disp_period;					// msec per frame
+static u16 disp_count;					// msec since the last frame
+static DISPLAY_STATS disp_stats;
+
+typedef struct {
+	u8 data[MAX_CNT][8];
+	u8 mask[MAX_CNT][8];		// bits of data shown over the layers below
+	volatile bool active;
+	volatile bool visible;		// blink phase
+	volatile u32 remaining;		// msec until the layer ends, DISPLAY_FOREVER: no end
+	u16 blink_half;				// msec per blink phase, 0: steady
+	volatile u16 blink_cnt;
+} DISPLAY_LAYER;
+
+static DISPLAY_LAYER disp_layer[DISPLAY_LAYERS];
+
+
+// Sets the frame rate, fps from 1 to DISPLAY_FPS_MAX
+void display_setRate(u16 fps) {
+	if (fps == 0)
+		fps = 1;
+	if (fps > DISPLAY_FPS_MAX)
+		fps = DISPLAY_FPS_MAX;
+	disp_period = 1000 / fps;
+}
+
+// Clears both buffers, the next frame is sent at the first due refresh
+void display_init(u16 fps) {
+	for (u8 b = 0; b < 2; b++)
+		for (u8 icNumber = 0; icNumber < MAX_CNT; icNumber++)
+			for (u8 digit = 0; digit < 8; digit++)
+				disp_buf[b][icNumber][digit] = 0x00;
+	disp_front = 0;
+	disp_pending = false;
+	disp_due = false;
+	disp_count = 0;
+	for (u8 layer = 0; layer < DISPLAY_LAYERS; layer++) {
+		disp_layer[layer].active = false;
+		display_layerClear(layer);
+	}
+	display_setRate(fps);
+}
+
+// Draws one digit register into the back buffer
+void display_setRow(u8 icNumber, u8 digit, u8 value) {
+	disp_buf[disp_front ^ 1][icNumber][digit] = value;
+}
+
+u8 display_getRow(u8 icNumber, u8 digit) {
+	return disp_buf[disp_front ^ 1][icNumber][digit];
+}
+
+// Publishes the back buffer. The new back buffer starts as a copy of it, so the
+// application keeps drawing incrementally (only the rows it changes).
+void display_swap() {
+	u8 back = disp_front ^ 1;
+
+	if (disp_pending)
+		disp_stats.coalesced++;
+	disp_front = back;					// single byte write, the swap is atomic
+	disp_pending = true;
+	disp_stats.swaps++;
+
+	for (u8 icNumber = 0; icNumber < MAX_CNT; icNumber++)
+		for (u8 digit = 0; digit < 8; digit++)
+			disp_buf[back ^ 1][icNumber][digit] = disp_buf[back][icNumber][digit];
+}
+
+// 1 msec timer ISR: no SPI access, only marks the refresh as due and counts the layer
+// blink phases and expiry times down. A layer that changes forces a new frame.
+void display_tick() {
+	for (u8 layer = 0; layer < DISPLAY_LAYERS; layer++) {
+		DISPLAY_LAYER *l = &disp_layer[layer];
+		if (!l->active)
+			continue;
+		if ((l->remaining != DISPLAY_FOREVER) && (--l->remaining == 0)) {
+			l->active = false;
+			disp_pending = true;
+			continue;
+		}
+		if ((l->blink_half != 0) && (++l->blink_cnt >= l->blink_half)) {
+			l->blink_cnt = 0;
+			l->visible = !l->visible;
+			disp_pending = true;
+		}
+	}
+	if (++disp_count >= disp_period) {
+		disp_count = 0;
+		disp_due = true;
+	}
+}
+
+// Main loop: sends the front buffer once per frame period, if a new frame was published.
+// Returns true if a frame was sent.
+bool display_task() {
+	if (!disp_due)
+		return false;
+	disp_due = false;
+	if (!disp_pending)
+		return false;
+
+	u8 front = disp_front;
+	disp_pending = false;
+	bool shown[DISPLAY_LAYERS];
+	for (u8 layer = 0; layer < DISPLAY_LAYERS; layer++)
+		shown[layer] = disp_layer[layer].active && disp_layer[layer].visible;
+
+	for (u8 icNumber = 0; icNumber < MAX_CNT; icNumber++) {
+		for (u8 digit = 0; digit < 8; digit++) {
+			u8 value = disp_buf[front][icNumber][digit];
+			for (u8 layer = 0; layer < DISPLAY_LAYERS; layer++) {
+				if (shown[layer]) {
+					u8 mask = disp_layer[layer].mask[icNumber][digit];
+					value = (value & ~mask) | (disp_layer[layer].data[icNumber][digit] & mask);
+				}
+			}
+			setRowDeferred(icNumber, digit, value);
+		}
+	}
+	disp_stats.writes += flushMAX7221();
+	disp_stats.flushes++;
+	return true;
+}
+
+// Empties a layer (nothing covered). Draw a layer while it is hidden, then show it.
+void display_layerClear(u8 layer) {
+	for (u8 icNumber = 0; icNumber < MAX_CNT; icNumber++) {
+		for (u8 digit = 0; digit < 8; digit++) {
+			disp_layer[layer].data[icNumber][digit] = 0x00;
+			disp_layer[layer].mask[icNumber][digit] = 0x00;
+		}
+	}
+}
+
+// Draws one digit register of a layer: the bits of mask are shown as in value
+void display_layerSetRow(u8 layer, u8 icNumber, u8 digit, u8 value, u8 mask) {
+	disp_layer[layer].data[icNumber][digit] = value;
+	disp_layer[layer].mask[icNumber][digit] = mask;
+}
+
+// Shows a layer for ms msec (DISPLAY_FOREVER: until hidden), blinking with a period of
+// blink msec (0: steady). Showing it again restarts its time.
+void display_layerShow(u8 layer, u32 ms, u16 blink) {
+	DISPLAY_LAYER *l = &disp_layer[layer];
+
+	l->active = false;					// the timer ISR leaves the layer alone meanwhile
+	l->remaining = ms;
+	l->blink_half = blink / 2;
+	l->blink_cnt = 0;
+	l->visible = true;
+	l->active = true;
+	disp_pending = true;
+}
+
+void display_layerHide(u8 layer) {
+	if (disp_layer[layer].active) {
+		disp_layer[layer].active = false;
+		disp_pending = true;
+	}
+}
+
+bool display_layerActive(u8 layer) {
+	return disp_layer[layer].active;
+}
+
+const DISPLAY_STATS *display_stats() {
+	return &disp_stats;
+}
@@ -0,0 +1,60 @@
+/*
+ * display.h
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#ifndef SRC_DISPLAY_H_
+#define SRC_DISPLAY_H_
+
+#include "xil_types.h"
+#include "stdbool.h"
+#include "max7221.h"		// MAX_CNT, setRowDeferred, flushMAX7221
+
+
+// Double buffered refresh of the MAX7221 digit registers (switch leds, dial leds, 7-seg displays).
+// The application draws into the back buffer with display_setRow() and publishes a complete
+// frame with display_swap(). display_tick() runs in the 1 msec timer ISR and only marks a refresh
+// as due, display_task() (main loop, owns the SPI bus) then flushes the front buffer through
+// the MAX7221 shadow framebuffer, so only the digits that changed are sent.
+// At most one flush per frame period: the display costs the same no matter how often the
+// control logic redraws.
+// Overlay layers (lamp test, alarm blink, value pop-up) are kept apart from the application
+// frame and merged over it in display_task(), each frame, in the order of their priority (layer
+// number, highest on top). A layer covers only the bits of its mask, it can blink and it can
+// expire; display_tick() counts both down, so nothing waits for a layer to end.
+
+#define DISPLAY_LAYER_POPUP  0			// value pop-up, e.g. a dial mode on its 7-seg led display
+#define DISPLAY_LAYER_ALARM  1			// alarm indication, usually blinking
+#define DISPLAY_LAYER_TEST   2			// lamp test, on top of everything
+#define DISPLAY_LAYERS       3
+
+#define DISPLAY_FOREVER      0			// layer time: shown until display_layerHide()
+
+#define DISPLAY_FPS_DEFAULT  50			// frames per second
+#define DISPLAY_FPS_MAX      1000		// one frame per timer tick
+
+typedef struct {
+	u32 swaps;				// frames published by the application
+	u32 flushes;			// frames sent to the MAX7221s
+	u32 coalesced;			// frames merged into a newer one before they were sent
+	u32 writes;				// digit registers written
+} DISPLAY_STATS;
+
+
+void display_init(u16 fps);
+void display_setRate(u16 fps);
+void display_setRow(u8 icNumber, u8 digit, u8 value);
+u8 display_getRow(u8 icNumber, u8 digit);
+void display_swap();
+void display_tick();
+bool display_task();
+void display_layerClear(u8 layer);
+void display_layerSetRow(u8 layer, u8 icNumber, u8 digit, u8 value, u8 mask);
+void display_layerShow(u8 layer, u32 ms, u16 blink);
+void display_layerHide(u8 layer);
+bool display_layerActive(u8 layer);
+const DISPLAY_STATS *display_stats();
+
+
+#endif /* SRC_DISPLAY_H_ */
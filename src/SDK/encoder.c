@@ -0,0 +1,104 @@
+/*
+ * encoder.c
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#include "encoder.h"
+
+// Quarter step from the previous (bits 3-2) and the new (bits 1-0) A/B state, 0 for no move or an invalid jump
+static const s8 enc_dir[16] = {
+	 0,  1, -1,  0,
+	-1,  0,  0,  1,
+	 1,  0,  0, -1,
+	 0, -1,  1,  0 };
+
+// Default acceleration: slow turns move one step per click, a fast spin up to 4
+static const ENC_ACCEL enc_defaultCurve[] = {{30, 4}, {60, 3}, {100, 2}};
+
+static ENC_STATE enc[ENC_CNT];
+static ENC_ACCEL enc_curve[ENC_CURVE_MAX];
+static u8 enc_curveLen;
+
+
+// state is the current A/B state of the encoder, so the first edge is decoded from it
+void enc_init(u8 icNumber, u8 state, u32 now) {
+	ENC_STATE *e = &enc[icNumber];
+
+	e->state = state & 0x03;
+	e->quarter = 0;
+	e->dir = 0;
+	e->delta = 0;
+	e->click_time = now;
+	e->period = ENC_IDLE_MS;
+	e->clicks = 0;
+	if (enc_curveLen == 0)
+		enc_setCurve(enc_defaultCurve, sizeof(enc_defaultCurve) / sizeof(enc_defaultCurve[0]));
+}
+
+// Copies the acceleration curve, len 0 turns acceleration off (1 step per click)
+void enc_setCurve(const ENC_ACCEL *curve, u8 len) {
+	if (len > ENC_CURVE_MAX)
+		len = ENC_CURVE_MAX;
+	for (u8 i = 0; i < len; i++)
+		enc_curve[i] = curve[i];
+	enc_curveLen = len;
+}
+
+static u8 enc_mult(u16 period) {
+	for (u8 i = 0; i < enc_curveLen; i++)
+		if (period <= enc_curve[i].period)
+			return enc_curve[i].mult;
+	return 1;
+}
+
+// Feeds a captured A/B state, now is the capture time (msec). Returns true if the state changed.
+bool enc_edge(u8 icNumber, u8 state, u32 now) {
+	ENC_STATE *e = &enc[icNumber];
+
+	state &= 0x03;
+	if (state == e->state)
+		return false;
+	e->quarter += enc_dir[(e->state << 2) | state];
+	e->state = state;
+	if ((e->quarter < ENC_STATES_PER_CLICK) && (e->quarter > -ENC_STATES_PER_CLICK))
+		return true;
+
+	// One click: velocity from the time since the previous click in the same direction
+	s8 dir = (e->quarter > 0) ? 1 : -1;
+	u32 elapsed = now - e->click_time;
+	e->quarter = 0;
+	if ((dir != e->dir) || (elapsed >= ENC_IDLE_MS))
+		e->period = ENC_IDLE_MS;
+	else
+		e->period = (e->period + elapsed) / 2;		// smoothed over the last clicks
+	e->dir = dir;
+	e->click_time = now;
+	e->clicks++;
+	e->delta += dir * enc_mult(e->period);
+	return true;
+}
+
+// Steps added up since the last call, positive CW
+s16 enc_delta(u8 icNumber) {
+	s16 delta = enc[icNumber].delta;
+	enc[icNumber].delta = 0;
+	return delta;
+}
+
+// Rotational velocity in clicks per second, 0 once ENC_IDLE_MS passed without a click
+u16 enc_velocity(u8 icNumber, u32 now) {
+	ENC_STATE *e = &enc[icNumber];
+
+	if (((now - e->click_time) >= ENC_IDLE_MS) || (e->period == 0))
+		return 0;
+	return 1000 / e->period;
+}
+
+// True while an encoder is between detents (a click not completed)
+bool enc_moving() {
+	for (u8 i = 0; i < ENC_CNT; i++)
+		if (enc[i].quarter != 0)
+			return true;
+	return false;
+}
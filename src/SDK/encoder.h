@@ -0,0 +1,52 @@
+/*
+ * encoder.h
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#ifndef SRC_ENCODER_H_
+#define SRC_ENCODER_H_
+
+#include "xil_types.h"
+#include "stdbool.h"
+
+
+// Rotary encoder decoding with velocity based acceleration.
+// enc_edge() is fed the 2-bit A/B state of an encoder with the time it was captured (msec),
+// 4 valid quadrature states make one click. The time between clicks in the same direction
+// gives the rotational velocity, an acceleration curve turns fast clicks into several steps.
+// Steps are added up until the main loop takes them with enc_delta(), so a fast turn
+// gives one larger change instead of one event per click.
+
+#define ENC_CNT              3
+#define ENC_STATES_PER_CLICK 4
+#define ENC_IDLE_MS          250		// clicks further apart, or after a reversal, count as slow
+#define ENC_CURVE_MAX        8
+
+// Acceleration curve point: clicks up to period msec apart move mult steps.
+// Points are in ascending period order, clicks slower than the last point move 1 step.
+typedef struct {
+	u16 period;
+	u8 mult;
+} ENC_ACCEL;
+
+typedef struct {
+	u8 state;				// last A/B state
+	s8 quarter;				// valid states counted into the current click, -3 to 3
+	s8 dir;					// direction of the last click, 1 CW, -1 CCW, 0 none
+	s16 delta;				// steps not yet taken by enc_delta()
+	u32 click_time;			// time of the last click
+	u16 period;				// smoothed msec between clicks, ENC_IDLE_MS when idle
+	u32 clicks;				// statistics
+} ENC_STATE;
+
+
+void enc_init(u8 icNumber, u8 state, u32 now);
+void enc_setCurve(const ENC_ACCEL *curve, u8 len);
+bool enc_edge(u8 icNumber, u8 state, u32 now);
+s16 enc_delta(u8 icNumber);
+u16 enc_velocity(u8 icNumber, u32 now);
+bool enc_moving();
+
+
+#endif /* SRC_ENCODER_H_ */
@@ -0,0 +1,71 @@
+/*
+ * evq.c
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#include "evq.h"
+
+static volatile EVQ_EVENT evq_buf[EVQ_SIZE];
+static volatile u16 evq_head = 0;		// written only by evq_push() (interrupt context)
+static volatile u16 evq_tail = 0;		// written only by evq_pop() (main loop)
+static volatile u16 evq_high = 0;		// most events waiting at once
+static volatile u32 evq_overflow = 0;	// events dropped because the queue was full
+static volatile u8 evq_seq = 0;
+
+
+void evq_init() {
+	evq_head = 0;
+	evq_tail = 0;
+	evq_high = 0;
+	evq_overflow = 0;
+	evq_seq = 0;
+}
+
+// Interrupt context only. Returns false if the queue was full and the event was dropped
+bool evq_push(u8 source, u32 time) {
+	u16 head = evq_head;
+	u16 next = (head + 1) & (EVQ_SIZE - 1);
+
+	evq_seq++;
+	if (next == evq_tail) {
+		evq_overflow++;
+		return false;
+	}
+	evq_buf[head].time = time;
+	evq_buf[head].source = source;
+	evq_buf[head].seq = evq_seq;
+	evq_head = next;		// publish the event
+
+	u16 count = (next - evq_tail) & (EVQ_SIZE - 1);
+	if (count > evq_high)
+		evq_high = count;
+	return true;
+}
+
+// Main loop only. Copies the oldest event, returns false if the queue is empty
+bool evq_pop(EVQ_EVENT *event) {
+	u16 tail = evq_tail;
+
+	if (tail == evq_head)
+		return false;
+	event->time = evq_buf[tail].time;
+	event->source = evq_buf[tail].source;
+	event->seq = evq_buf[tail].seq;
+	evq_tail = (tail + 1) & (EVQ_SIZE - 1);		// free the slot
+	return true;
+}
+
+// Events waiting
+u16 evq_count() {
+	return (evq_head - evq_tail) & (EVQ_SIZE - 1);
+}
+
+// Most events waiting at once since evq_init(), for sizing EVQ_SIZE
+u16 evq_highWater() {
+	return evq_high;
+}
+
+u32 evq_overflows() {
+	return evq_overflow;
+}
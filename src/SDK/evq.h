@@ -0,0 +1,43 @@
+/*
+ * evq.h
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#ifndef SRC_EVQ_H_
+#define SRC_EVQ_H_
+
+#include "xil_types.h"
+#include "stdbool.h"
+
+
+// Input event queue: single producer (interrupt context), single consumer (main loop) ring buffer.
+// No locks: evq_push() writes only the head, evq_pop() only the tail, an event is complete
+// before the head moves past it. Interrupts that come while the main loop is busy each keep their
+// own event, time and order, instead of merging into one flag. A full queue drops the new event and counts it.
+// An event carries no port state: the SPI bus belongs to the main loop, so the ports are read by the
+// consumer (mcp_captureAll). The MCP23S17 latches only the first change (INTCAP) and holds INT until
+// then, so the input pass gets the state at the first interrupt, dated by the first MCP event, and the
+// live state (GPIO). Changes in between are not recovered.
+
+#define EVQ_SIZE             32			// events, must be a power of 2
+
+// Event sources
+#define EVQ_SRC_MCP          0			// MCP23S17 INT pin (input change)
+
+typedef struct {
+	u32 time;				// millis when the interrupt came
+	u8 source;				// EVQ_SRC_...
+	u8 seq;					// push counter, a gap between events shows dropped events
+} EVQ_EVENT;
+
+
+void evq_init();
+bool evq_push(u8 source, u32 time);
+bool evq_pop(EVQ_EVENT *event);
+u16 evq_count();
+u16 evq_highWater();
+u32 evq_overflows();
+
+
+#endif /* SRC_EVQ_H_ */
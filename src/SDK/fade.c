@@ -0,0 +1,170 @@
+/*
+ * fade.c
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#include "fade.h"
+
+// Perceptual level to intensity register. Level l has lightness L* = 100 * l / 31,
+// relative luminance Y from CIE 1931, register r gives a duty cycle of (2r + 1) / 32.
+static const u8 fade_curve[FADE_LEVEL_MAX + 1] = {
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,  1,  2,  2,
+	 3,  3,  4,  4,  5,  6,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15};
+
+static FADE_CHIP fade_chip[MAX_CNT];
+static volatile u16 fade_ms;			// msec counted by fade_tick() since the last step
+static volatile u32 fade_idle_ms;		// msec without fade_activity()
+static u32 fade_idle_timeout;			// 0: no idle dimming
+static u8 fade_idle_level;
+static u8 fade_active_level;
+static bool fade_idle;					// dimmed for idle
+
+
+static u8 fade_clamp(u8 level) {
+	return (level > FADE_LEVEL_MAX) ? FADE_LEVEL_MAX : level;
+}
+
+// Sets every chip to level at once (no SPI), the registers are written by the next fade_task()
+void fade_init(u8 level) {
+	level = fade_clamp(level);
+	for (u8 icNumber = 0; icNumber < MAX_CNT; icNumber++) {
+		fade_chip[icNumber].effect = FADE_HOLD;
+		fade_chip[icNumber].level = level;
+		fade_chip[icNumber].reg = 0xFF;		// unknown, forces a write
+	}
+	fade_ms = 0;
+	fade_idle_ms = 0;
+	fade_idle_timeout = 0;
+	fade_idle = false;
+}
+
+// Ramps the chips in the mask from their current level to level in ms msec
+void fade_to(u32 chips, u8 level, u16 ms) {
+	for (u8 icNumber = 0; icNumber < MAX_CNT; icNumber++) {
+		if ((chips & ((u32)1 << icNumber)) == 0)
+			continue;
+		FADE_CHIP *chip = &fade_chip[icNumber];
+		chip->effect = FADE_RAMP;
+		chip->from = chip->level;
+		chip->to = fade_clamp(level);
+		chip->time = 0;
+		chip->duration = (ms == 0) ? 1 : ms;
+	}
+}
+
+// Pulses the chips in the mask between low and high, one triangle per period msec, until fade_stop().
+// Periods below 2 * FADE_STEP_MS are raised to it.
+void fade_pulse(u32 chips, u8 low, u8 high, u16 period) {
+	if (low > high) {
+		u8 level = low;
+		low = high;
+		high = level;
+	}
+	for (u8 icNumber = 0; icNumber < MAX_CNT; icNumber++) {
+		if ((chips & ((u32)1 << icNumber)) == 0)
+			continue;
+		FADE_CHIP *chip = &fade_chip[icNumber];
+		chip->effect = FADE_PULSE;
+		chip->from = fade_clamp(low);
+		chip->to = fade_clamp(high);
+		chip->time = 0;
+		chip->duration = (period < 2 * FADE_STEP_MS) ? 2 * FADE_STEP_MS : period;
+	}
+}
+
+// Ends a pulse: ramps back to level
+void fade_stop(u32 chips, u8 level, u16 ms) {
+	fade_to(chips, level, ms);
+}
+
+// Idle dimming: after timeout msec without fade_activity() the chips that hold a level
+// fade to dim_level, the next activity brings them back to level. timeout 0 turns it off.
+void fade_setIdle(u32 timeout, u8 dim_level, u8 level) {
+	fade_idle_timeout = timeout;
+	fade_idle_level = fade_clamp(dim_level);
+	fade_active_level = fade_clamp(level);
+	fade_idle_ms = 0;
+}
+
+// User input seen (switch, rotary encoder), cancels idle dimming
+void fade_activity() {
+	fade_idle_ms = 0;
+}
+
+// 1 msec timer ISR: no SPI access
+void fade_tick() {
+	if (fade_ms < 0xFFFF)
+		fade_ms++;
+	fade_idle_ms++;
+}
+
+// Main loop: advances the effects once per FADE_STEP_MS and sends the changed intensity
+// registers in one chain transfer. Returns true if the MAX7221s were written.
+bool fade_task() {
+	if (fade_ms < FADE_STEP_MS)
+		return false;
+	u16 step = fade_ms;
+	fade_ms = 0;
+
+	// Idle dimming of the chips that are not busy with an effect
+	if (fade_idle_timeout != 0) {
+		bool idle = (fade_idle_ms >= fade_idle_timeout);
+		if (idle != fade_idle) {
+			fade_idle = idle;
+			for (u8 icNumber = 0; icNumber < MAX_CNT; icNumber++) {
+				if (fade_chip[icNumber].effect != FADE_PULSE)
+					fade_to((u32)1 << icNumber, idle ? fade_idle_level : fade_active_level, idle ? FADE_IDLE_DIM_MS : FADE_IDLE_WAKE_MS);
+			}
+		}
+	}
+
+	u8 opcode[MAX_CNT];
+	u8 data[MAX_CNT];
+	bool send = false;
+
+	for (u8 icNumber = 0; icNumber < MAX_CNT; icNumber++) {
+		FADE_CHIP *chip = &fade_chip[icNumber];
+
+		switch (chip->effect) {
+		case FADE_RAMP:
+			chip->time += step;
+			if (chip->time >= chip->duration) {
+				chip->level = chip->to;
+				chip->effect = FADE_HOLD;
+			} else if (chip->to >= chip->from) {
+				chip->level = chip->from + ((u32)(chip->to - chip->from) * chip->time) / chip->duration;
+			} else {
+				chip->level = chip->from - ((u32)(chip->from - chip->to) * chip->time) / chip->duration;
+			}
+			break;
+		case FADE_PULSE: {
+			chip->time = (chip->time + step) % chip->duration;
+			u16 half = chip->duration / 2;		// duration is at least 2 * FADE_STEP_MS, half is not 0
+			u16 t = (chip->time < half) ? chip->time : (chip->duration - chip->time);	// triangle
+			if (t > half)						// odd period: duration - time may be half + 1
+				t = half;
+			chip->level = chip->from + ((u32)(chip->to - chip->from) * t) / half;
+			break;}
+		default:
+			break;
+		}
+
+		u8 reg = fade_curve[chip->level];
+		if (reg != chip->reg) {
+			chip->reg = reg;
+			opcode[icNumber] = MAX7221_INTENSITY_REG;
+			data[icNumber] = reg;
+			send = true;
+		} else {
+			opcode[icNumber] = MAX7221_NO_OP_REG;
+			data[icNumber] = 0x00;
+		}
+	}
+
+	if (!send)
+		return false;
+	XSpi_SetSlaveSelect(&SpiInstance, 0x02);					    // Select CS for MAX7221s
+	sendSPIChain(opcode, data);
+	return true;
+}
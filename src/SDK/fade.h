@@ -0,0 +1,58 @@
+/*
+ * fade.h
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#ifndef SRC_FADE_H_
+#define SRC_FADE_H_
+
+#include "xil_types.h"
+#include "stdbool.h"
+#include "max7221.h"		// MAX_CNT, sendSPIChain
+
+
+// Brightness fading of the MAX7221 intensity registers, per chip.
+// Brightness is given in perceptual levels 0 to FADE_LEVEL_MAX (CIE 1931 lightness),
+// a table maps them to the 16 intensity register values, so equal steps look equal.
+// Effects: ramp to a level (fade-in at boot), dim after an idle time, pulse (alarm).
+// fade_tick() runs in the 1 msec timer ISR, fade_task() in the main loop advances the
+// effects once per FADE_STEP_MS and writes only the chips whose register changed,
+// all of them in one chain transfer.
+
+#define FADE_LEVEL_MAX       31
+#define FADE_LEVEL_NORMAL    24			// intensity register 8
+#define FADE_LEVEL_DIM       12			// intensity register 1
+#define FADE_STEP_MS         10			// msec per fading step
+#define FADE_IDLE_DIM_MS     1000		// ramp to the idle level
+#define FADE_IDLE_WAKE_MS    200		// ramp back on activity
+
+#define FADE_ALL             ((u32)(((u64)1 << MAX_CNT) - 1))	// chip mask, all MAX7221s
+
+// Effect of a chip
+#define FADE_HOLD            0
+#define FADE_RAMP            1
+#define FADE_PULSE           2
+
+typedef struct {
+	u8 effect;
+	u8 level;				// current perceptual level
+	u8 from;				// ramp: start level, pulse: low level
+	u8 to;					// ramp: end level, pulse: high level
+	u16 time;				// msec into the ramp / pulse period
+	u16 duration;			// ramp length / pulse period (msec)
+	u8 reg;					// intensity register value in the chip
+} FADE_CHIP;
+
+
+void fade_init(u8 level);
+void fade_to(u32 chips, u8 level, u16 ms);
+void fade_pulse(u32 chips, u8 low, u8 high, u16 period);
+void fade_stop(u32 chips, u8 level, u16 ms);
+void fade_setIdle(u32 timeout, u8 dim_level, u8 level);
+void fade_activity();
+void fade_tick();
+bool fade_task();
+
+
+#endif /* SRC_FADE_H_ */
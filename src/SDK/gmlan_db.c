@@ -0,0 +1,72 @@
+/*
+ * gmlan_db.c
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#include "gmlan_db.h"
+#include "xil_printf.h"
+#include "xstatus.h"
+
+// Function to print all signals of a frame, decoded with the signal table
+void gmlan_dumpFrame(CAN_FRAME *frame) {
+	xil_printf("ID %03X, DLC %d, data %08X %08X \n", frame->id, frame->length, frame->data.high, frame->data.low);
+	for (u8 i = 0; i < gmlan_signal_cnt; i++) {
+		if (gmlan_signals[i].id == frame->id) {
+			u32 raw = (u32)gmlan_unpack(frame->data.value, gmlan_signals[i].start, gmlan_signals[i].len);
+			xil_printf("  %s : %X \n", gmlan_signals[i].name, raw);
+		}
+	}
+}
+
+
+// Compare one built frame with the hand-packed constants it replaces
+static int gmlan_check(const char *name, CAN_FRAME *frame, u32 id, u8 length, u32 low, u32 high) {
+	if ((frame->id == id) && (frame->length == length) && (frame->data.low == low) && (frame->data.high == high))
+		return XST_SUCCESS;
+
+	xil_printf("GMLAN %s mismatch: %03X/%d %08X %08X, expected %03X/%d %08X %08X \n", name,
+			frame->id, frame->length, frame->data.high, frame->data.low, id, length, high, low);
+	return XST_FAILURE;
+}
+
+// Function to verify that the message builders produce the same bytes as the
+// hand-packed frames previously used in main.c
+int gmlan_selfTest() {
+	CAN_FRAME frame;
+	int Status = XST_SUCCESS;
+
+	gmlan_wakeup(&frame);
+	Status |= gmlan_check("wake-up", &frame, 0x632, 8, 0x00504800, 0x00000000);
+
+	gmlan_ipcDial(&frame, GMLAN_DC_CPID_RPM, 158);
+	Status |= gmlan_check("rpm dial", &frame, 0x255, 8, 0x0109AE04, 0x0000009E);
+	gmlan_ipcDial(&frame, GMLAN_DC_CPID_FUEL, 245);
+	Status |= gmlan_check("fuel dial", &frame, 0x255, 8, 0x010AAE04, 0x000000F5);
+	gmlan_ipcDial(&frame, GMLAN_DC_CPID_SPEED, 0);
+	Status |= gmlan_check("speed dial", &frame, 0x255, 8, 0x0108AE04, 0x00000000);
+
+	gmlan_ipcLamps(&frame, 3, 0xA5);
+	Status |= gmlan_check("lamps", &frame, 0x255, 8, 0xA503AE04, 0x000000A5);
+	gmlan_ipcLamps(&frame, 1, 0x00);
+	Status |= gmlan_check("lamps off", &frame, 0x255, 8, 0x0001AE04, 0x00000000);
+
+	gmlan_ipcOdoTest(&frame, true);
+	Status |= gmlan_check("odo test on", &frame, 0x255, 8, 0x010DAE04, 0x00000001);
+	gmlan_ipcOdoTest(&frame, false);
+	Status |= gmlan_check("odo test off", &frame, 0x255, 8, 0x000DAE04, 0x00000000);
+
+	gmlan_hazard(&frame, true);
+	Status |= gmlan_check("hazard on", &frame, 0x260, 3, 0x0080327F, 0x00000000);
+	gmlan_hazard(&frame, false);
+	Status |= gmlan_check("hazard off", &frame, 0x260, 3, 0x00000000, 0x00000000);
+
+	gmlan_chimeBeep(&frame);
+	Status |= gmlan_check("chime", &frame, 0x281, 5, 0x021E0560, 0x00000033);
+
+	// pack / unpack round trip of every generated message
+	Status |= gmlan_dbcSelfTest();
+
+	xil_printf("GMLAN self test %s \n", (Status == XST_SUCCESS) ? "passed" : "FAILED");
+	return (Status == XST_SUCCESS) ? XST_SUCCESS : XST_FAILURE;
+}
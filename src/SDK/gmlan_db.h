@@ -0,0 +1,91 @@
+/*
+ * gmlan_db.h
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#ifndef SRC_GMLAN_DB_H_
+#define SRC_GMLAN_DB_H_
+
+#include "xil_types.h"
+#include "stdbool.h"
+#include "mcp2515.h"		// CAN_FRAME, BytesUnion
+#include "gmlan_dbc.h"		// generated from src/DBC/corsa_ipc.dbc by dbc2c.py
+
+
+// GMLAN signal database for the Corsa Instrument Panel Cluster (IPC) messages.
+// Message identifiers, signal positions (<signal>_START / _LEN, Intel order) and the
+// pack / unpack functions are generated from src/DBC/corsa_ipc.dbc into gmlan_dbc.h.
+// The builders below name the frames used by main.c, they are static inline with
+// constant arguments, so the compiler folds them to the same constants as hand-packed frames.
+
+// Mask of a len-bit signal
+#define GMLAN_MASK(len)            (((len) >= 64) ? ~0ULL : ((1ULL << (len)) - 1))
+
+// Pack / unpack a single signal by name, e.g. GMLAN_PACK(GMLAN_DC_CPID, 0x09)
+#define GMLAN_PACK(sig, raw)       gmlan_pack((raw), sig##_START, sig##_LEN)
+#define GMLAN_UNPACK(sig, data)    gmlan_unpack((data), sig##_START, sig##_LEN)
+
+static inline u64 gmlan_pack(u64 raw, u8 start, u8 len) {
+	return (raw & GMLAN_MASK(len)) << start;
+}
+
+static inline u64 gmlan_unpack(u64 data, u8 start, u8 len) {
+	return (data >> start) & GMLAN_MASK(len);
+}
+
+
+// Message builders, every frame sent to the IPC is built by one of these
+
+static inline void gmlan_wakeup(CAN_FRAME *frame) {
+	const GMLAN_WAKEUP msg = { .wakeup_data = GMLAN_WAKEUP_DATA_WAKE };
+	gmlan_packWakeup(frame, &msg);
+}
+
+static inline void gmlan_ipcDeviceControl(CAN_FRAME *frame, u8 cpid, u8 ctrl, u8 value) {
+	const GMLAN_IPC_DC msg = {
+		.dc_pci = GMLAN_DC_PCI_SF_LEN_4,
+		.dc_sid = GMLAN_DC_SID_DEVICE_CONTROL,
+		.dc_cpid = cpid,
+		.dc_ctrl = ctrl,
+		.dc_value = value,
+	};
+	gmlan_packIpcDc(frame, &msg);
+}
+
+// Dial position: cpid is GMLAN_DC_CPID_RPM/FUEL/SPEED, value is the calibrated dial value
+static inline void gmlan_ipcDial(CAN_FRAME *frame, u8 cpid, u8 value) {
+	gmlan_ipcDeviceControl(frame, cpid, GMLAN_DC_CTRL_DIAL, value);
+}
+
+// Switch indications of one group (1-5), status is the group bit mask (lights_status[] in main.c)
+static inline void gmlan_ipcLamps(CAN_FRAME *frame, u8 group, u8 status) {
+	gmlan_ipcDeviceControl(frame, group, status, status);
+}
+
+static inline void gmlan_ipcOdoTest(CAN_FRAME *frame, bool on) {
+	gmlan_ipcDeviceControl(frame, GMLAN_DC_CPID_ODO_TEST, on, on);
+}
+
+static inline void gmlan_hazard(CAN_FRAME *frame, bool on) {
+	const GMLAN_HAZARD msg = { .hazard_ctrl = on ? GMLAN_HAZARD_CTRL_ON : GMLAN_HAZARD_CTRL_OFF };
+	gmlan_packHazard(frame, &msg);
+}
+
+static inline void gmlan_chimeBeep(CAN_FRAME *frame) {
+	const GMLAN_CHIME msg = {
+		.chime_tone = GMLAN_CHIME_TONE_BEEP,
+		.chime_cadence = GMLAN_CHIME_CADENCE_BEEP,
+		.chime_duration = GMLAN_CHIME_DURATION_BEEP,
+		.chime_repeat = GMLAN_CHIME_REPEAT_BEEP,
+		.chime_volume = GMLAN_CHIME_VOLUME_BEEP,
+	};
+	gmlan_packChime(frame, &msg);
+}
+
+
+void gmlan_dumpFrame(CAN_FRAME *frame);
+int gmlan_selfTest();
+
+
+#endif /* SRC_GMLAN_DB_H_ */
@@ -0,0 +1,141 @@
+/*
+ * gmlan_dbc.c
+ *
+ *  Generated by dbc2c.py from corsa_ipc.dbc, do not edit.
+ */
+
+#include "gmlan_dbc.h"
+#include "xil_printf.h"
+#include "xstatus.h"
+
+const GMLAN_SIGNAL gmlan_signals[] = {
+	{ "WAKEUP_DATA", GMLAN_WAKEUP_ID, GMLAN_WAKEUP_DATA_START, GMLAN_WAKEUP_DATA_LEN, 1 },
+	{ "DC_PCI", GMLAN_IPC_DC_ID, GMLAN_DC_PCI_START, GMLAN_DC_PCI_LEN, 1 },
+	{ "DC_SID", GMLAN_IPC_DC_ID, GMLAN_DC_SID_START, GMLAN_DC_SID_LEN, 1 },
+	{ "DC_CPID", GMLAN_IPC_DC_ID, GMLAN_DC_CPID_START, GMLAN_DC_CPID_LEN, 1 },
+	{ "DC_CTRL", GMLAN_IPC_DC_ID, GMLAN_DC_CTRL_START, GMLAN_DC_CTRL_LEN, 1 },
+	{ "DC_VALUE", GMLAN_IPC_DC_ID, GMLAN_DC_VALUE_START, GMLAN_DC_VALUE_LEN, 1 },
+	{ "HAZARD_CTRL", GMLAN_HAZARD_ID, GMLAN_HAZARD_CTRL_START, GMLAN_HAZARD_CTRL_LEN, 1 },
+	{ "CHIME_TONE", GMLAN_CHIME_ID, GMLAN_CHIME_TONE_START, GMLAN_CHIME_TONE_LEN, 1 },
+	{ "CHIME_CADENCE", GMLAN_CHIME_ID, GMLAN_CHIME_CADENCE_START, GMLAN_CHIME_CADENCE_LEN, 1 },
+	{ "CHIME_DURATION", GMLAN_CHIME_ID, GMLAN_CHIME_DURATION_START, GMLAN_CHIME_DURATION_LEN, 1 },
+	{ "CHIME_REPEAT", GMLAN_CHIME_ID, GMLAN_CHIME_REPEAT_START, GMLAN_CHIME_REPEAT_LEN, 1 },
+	{ "CHIME_VOLUME", GMLAN_CHIME_ID, GMLAN_CHIME_VOLUME_START, GMLAN_CHIME_VOLUME_LEN, 1 },
+};
+
+const u8 gmlan_signal_cnt = sizeof(gmlan_signals) / sizeof(gmlan_signals[0]);
+
+const GMLAN_MESSAGE gmlan_messages[] = {
+	{ "WAKEUP", GMLAN_WAKEUP_ID, GMLAN_WAKEUP_LEN, 0, 1 },
+	{ "IPC_DC", GMLAN_IPC_DC_ID, GMLAN_IPC_DC_LEN, 1, 5 },
+	{ "HAZARD", GMLAN_HAZARD_ID, GMLAN_HAZARD_LEN, 6, 1 },
+	{ "CHIME", GMLAN_CHIME_ID, GMLAN_CHIME_LEN, 7, 5 },
+};
+
+const u8 gmlan_message_cnt = sizeof(gmlan_messages) / sizeof(gmlan_messages[0]);
+
+
+// Round trip of every message with all-ones and alternating bit patterns,
+// checks that pack followed by unpack returns every signal unchanged
+int gmlan_dbcSelfTest() {
+	CAN_FRAME frame;
+	int Status = XST_SUCCESS;
+
+	{
+		GMLAN_WAKEUP in, out;
+		for (u8 pattern = 0; pattern < 3; pattern++) {
+			u64 bits = (pattern == 0) ? ~0ULL : (pattern == 1) ? 0x5555555555555555ULL : 0xAAAAAAAAAAAAAAAAULL;
+			in.wakeup_data = (u16)(bits & 0xFFFFULL);
+			gmlan_packWakeup(&frame, &in);
+			gmlan_unpackWakeup(&frame, &out);
+			if (in.wakeup_data != out.wakeup_data) {
+				xil_printf("WAKEUP_DATA round trip failed \n");
+				Status = XST_FAILURE;
+			}
+		}
+	}
+
+	{
+		GMLAN_IPC_DC in, out;
+		for (u8 pattern = 0; pattern < 3; pattern++) {
+			u64 bits = (pattern == 0) ? ~0ULL : (pattern == 1) ? 0x5555555555555555ULL : 0xAAAAAAAAAAAAAAAAULL;
+			in.dc_pci = (u8)(bits & 0xFFULL);
+			in.dc_sid = (u8)(bits & 0xFFULL);
+			in.dc_cpid = (u8)(bits & 0xFFULL);
+			in.dc_ctrl = (u8)(bits & 0xFFULL);
+			in.dc_value = (u8)(bits & 0xFFULL);
+			gmlan_packIpcDc(&frame, &in);
+			gmlan_unpackIpcDc(&frame, &out);
+			if (in.dc_pci != out.dc_pci) {
+				xil_printf("DC_PCI round trip failed \n");
+				Status = XST_FAILURE;
+			}
+			if (in.dc_sid != out.dc_sid) {
+				xil_printf("DC_SID round trip failed \n");
+				Status = XST_FAILURE;
+			}
+			if (in.dc_cpid != out.dc_cpid) {
+				xil_printf("DC_CPID round trip failed \n");
+				Status = XST_FAILURE;
+			}
+			if (in.dc_ctrl != out.dc_ctrl) {
+				xil_printf("DC_CTRL round trip failed \n");
+				Status = XST_FAILURE;
+			}
+			if (in.dc_value != out.dc_value) {
+				xil_printf("DC_VALUE round trip failed \n");
+				Status = XST_FAILURE;
+			}
+		}
+	}
+
+	{
+		GMLAN_HAZARD in, out;
+		for (u8 pattern = 0; pattern < 3; pattern++) {
+			u64 bits = (pattern == 0) ? ~0ULL : (pattern == 1) ? 0x5555555555555555ULL : 0xAAAAAAAAAAAAAAAAULL;
+			in.hazard_ctrl = (u32)(bits & 0xFFFFFFULL);
+			gmlan_packHazard(&frame, &in);
+			gmlan_unpackHazard(&frame, &out);
+			if (in.hazard_ctrl != out.hazard_ctrl) {
+				xil_printf("HAZARD_CTRL round trip failed \n");
+				Status = XST_FAILURE;
+			}
+		}
+	}
+
+	{
+		GMLAN_CHIME in, out;
+		for (u8 pattern = 0; pattern < 3; pattern++) {
+			u64 bits = (pattern == 0) ? ~0ULL : (pattern == 1) ? 0x5555555555555555ULL : 0xAAAAAAAAAAAAAAAAULL;
+			in.chime_tone = (u8)(bits & 0xFFULL);
+			in.chime_cadence = (u8)(bits & 0xFFULL);
+			in.chime_duration = (u8)(bits & 0xFFULL);
+			in.chime_repeat = (u8)(bits & 0xFFULL);
+			in.chime_volume = (u8)(bits & 0xFFULL);
+			gmlan_packChime(&frame, &in);
+			gmlan_unpackChime(&frame, &out);
+			if (in.chime_tone != out.chime_tone) {
+				xil_printf("CHIME_TONE round trip failed \n");
+				Status = XST_FAILURE;
+			}
+			if (in.chime_cadence != out.chime_cadence) {
+				xil_printf("CHIME_CADENCE round trip failed \n");
+				Status = XST_FAILURE;
+			}
+			if (in.chime_duration != out.chime_duration) {
+				xil_printf("CHIME_DURATION round trip failed \n");
+				Status = XST_FAILURE;
+			}
+			if (in.chime_repeat != out.chime_repeat) {
+				xil_printf("CHIME_REPEAT round trip failed \n");
+				Status = XST_FAILURE;
+			}
+			if (in.chime_volume != out.chime_volume) {
+				xil_printf("CHIME_VOLUME round trip failed \n");
+				Status = XST_FAILURE;
+			}
+		}
+	}
+
+	return Status;
+}
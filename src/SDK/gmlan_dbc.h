@@ -0,0 +1,199 @@
+/*
+ * gmlan_dbc.h
+ *
+ *  Generated by dbc2c.py from corsa_ipc.dbc, do not edit.
+ */
+
+#ifndef SRC_GMLAN_DBC_H_
+#define SRC_GMLAN_DBC_H_
+
+#include "xil_types.h"
+#include "mcp2515.h"		// CAN_FRAME, BytesUnion
+
+
+// Signal table entry, used for diagnostics and by the self test
+typedef struct {
+	const char *name;
+	u32 id;				// message identifier
+	u8 start;			// start bit, Intel order
+	u8 len;				// length in bits
+	u16 scale;			// physical units per raw count
+} GMLAN_SIGNAL;
+
+// Message table entry
+typedef struct {
+	const char *name;
+	u32 id;
+	u8 length;
+	u8 first_signal;		// index in gmlan_signals[]
+	u8 signal_cnt;
+} GMLAN_MESSAGE;
+
+extern const GMLAN_SIGNAL gmlan_signals[];
+extern const u8 gmlan_signal_cnt;
+extern const GMLAN_MESSAGE gmlan_messages[];
+extern const u8 gmlan_message_cnt;
+
+
+// WAKEUP: GMLAN wake-up, sent every 1 second
+#define GMLAN_WAKEUP_ID		0x632
+#define GMLAN_WAKEUP_LEN		8
+
+#define GMLAN_WAKEUP_DATA_START	8
+#define GMLAN_WAKEUP_DATA_LEN	16
+#define GMLAN_WAKEUP_DATA_WAKE	0x5048
+
+typedef struct {
+	u16 wakeup_data;
+} GMLAN_WAKEUP;
+
+static inline void gmlan_packWakeup(CAN_FRAME *frame, const GMLAN_WAKEUP *msg) {
+	frame->id = GMLAN_WAKEUP_ID;
+	frame->length = GMLAN_WAKEUP_LEN;
+	frame->data.value = (((u64)msg->wakeup_data & 0xFFFFULL) << 8);
+}
+
+static inline void gmlan_unpackWakeup(const CAN_FRAME *frame, GMLAN_WAKEUP *msg) {
+	msg->wakeup_data = (u16)((frame->data.value >> 8) & 0xFFFFULL);
+}
+
+// IPC_DC: IPC device control, diagnostic $AE request in a single frame
+#define GMLAN_IPC_DC_ID		0x255
+#define GMLAN_IPC_DC_LEN		8
+
+// DC_PCI: ISO-TP single frame PCI (payload length)
+#define GMLAN_DC_PCI_START	0
+#define GMLAN_DC_PCI_LEN	8
+#define GMLAN_DC_PCI_SF_LEN_4	0x4
+
+// DC_SID: diagnostic service
+#define GMLAN_DC_SID_START	8
+#define GMLAN_DC_SID_LEN	8
+#define GMLAN_DC_SID_DEVICE_CONTROL	0xAE
+
+// DC_CPID: control packet identifier
+#define GMLAN_DC_CPID_START	16
+#define GMLAN_DC_CPID_LEN	8
+#define GMLAN_DC_CPID_LAMPS_1	0x1
+#define GMLAN_DC_CPID_LAMPS_2	0x2
+#define GMLAN_DC_CPID_LAMPS_3	0x3
+#define GMLAN_DC_CPID_LAMPS_4	0x4
+#define GMLAN_DC_CPID_LAMPS_5	0x5
+#define GMLAN_DC_CPID_SPEED	0x8
+#define GMLAN_DC_CPID_RPM	0x9
+#define GMLAN_DC_CPID_FUEL	0xA
+#define GMLAN_DC_CPID_ODO_TEST	0xD
+
+// DC_CTRL: control byte (dial enable / lamp mask / test on)
+#define GMLAN_DC_CTRL_START	24
+#define GMLAN_DC_CTRL_LEN	8
+#define GMLAN_DC_CTRL_DIAL	0x1
+
+// DC_VALUE: value byte (dial position / lamp state / test on)
+#define GMLAN_DC_VALUE_START	32
+#define GMLAN_DC_VALUE_LEN	8
+
+typedef struct {
+	u8 dc_pci;
+	u8 dc_sid;
+	u8 dc_cpid;
+	u8 dc_ctrl;
+	u8 dc_value;
+} GMLAN_IPC_DC;
+
+static inline void gmlan_packIpcDc(CAN_FRAME *frame, const GMLAN_IPC_DC *msg) {
+	frame->id = GMLAN_IPC_DC_ID;
+	frame->length = GMLAN_IPC_DC_LEN;
+	frame->data.value = (((u64)msg->dc_pci & 0xFFULL) << 0)
+	                  | (((u64)msg->dc_sid & 0xFFULL) << 8)
+	                  | (((u64)msg->dc_cpid & 0xFFULL) << 16)
+	                  | (((u64)msg->dc_ctrl & 0xFFULL) << 24)
+	                  | (((u64)msg->dc_value & 0xFFULL) << 32);
+}
+
+static inline void gmlan_unpackIpcDc(const CAN_FRAME *frame, GMLAN_IPC_DC *msg) {
+	msg->dc_pci = (u8)((frame->data.value >> 0) & 0xFFULL);
+	msg->dc_sid = (u8)((frame->data.value >> 8) & 0xFFULL);
+	msg->dc_cpid = (u8)((frame->data.value >> 16) & 0xFFULL);
+	msg->dc_ctrl = (u8)((frame->data.value >> 24) & 0xFFULL);
+	msg->dc_value = (u8)((frame->data.value >> 32) & 0xFFULL);
+}
+
+// HAZARD: Emergency lights (hazard flashers)
+#define GMLAN_HAZARD_ID		0x260
+#define GMLAN_HAZARD_LEN		3
+
+#define GMLAN_HAZARD_CTRL_START	0
+#define GMLAN_HAZARD_CTRL_LEN	24
+#define GMLAN_HAZARD_CTRL_OFF	0x0
+#define GMLAN_HAZARD_CTRL_ON	0x80327F
+
+typedef struct {
+	u32 hazard_ctrl;
+} GMLAN_HAZARD;
+
+static inline void gmlan_packHazard(CAN_FRAME *frame, const GMLAN_HAZARD *msg) {
+	frame->id = GMLAN_HAZARD_ID;
+	frame->length = GMLAN_HAZARD_LEN;
+	frame->data.value = (((u64)msg->hazard_ctrl & 0xFFFFFFULL) << 0);
+}
+
+static inline void gmlan_unpackHazard(const CAN_FRAME *frame, GMLAN_HAZARD *msg) {
+	msg->hazard_ctrl = (u32)((frame->data.value >> 0) & 0xFFFFFFULL);
+}
+
+// CHIME: Chime (beep sound), field names as reverse engineered
+#define GMLAN_CHIME_ID		0x281
+#define GMLAN_CHIME_LEN		5
+
+#define GMLAN_CHIME_TONE_START	0
+#define GMLAN_CHIME_TONE_LEN	8
+#define GMLAN_CHIME_TONE_BEEP	0x60
+
+#define GMLAN_CHIME_CADENCE_START	8
+#define GMLAN_CHIME_CADENCE_LEN	8
+#define GMLAN_CHIME_CADENCE_BEEP	0x5
+
+#define GMLAN_CHIME_DURATION_START	16
+#define GMLAN_CHIME_DURATION_LEN	8
+#define GMLAN_CHIME_DURATION_BEEP	0x1E
+
+#define GMLAN_CHIME_REPEAT_START	24
+#define GMLAN_CHIME_REPEAT_LEN	8
+#define GMLAN_CHIME_REPEAT_BEEP	0x2
+
+#define GMLAN_CHIME_VOLUME_START	32
+#define GMLAN_CHIME_VOLUME_LEN	8
+#define GMLAN_CHIME_VOLUME_BEEP	0x33
+
+typedef struct {
+	u8 chime_tone;
+	u8 chime_cadence;
+	u8 chime_duration;
+	u8 chime_repeat;
+	u8 chime_volume;
+} GMLAN_CHIME;
+
+static inline void gmlan_packChime(CAN_FRAME *frame, const GMLAN_CHIME *msg) {
+	frame->id = GMLAN_CHIME_ID;
+	frame->length = GMLAN_CHIME_LEN;
+	frame->data.value = (((u64)msg->chime_tone & 0xFFULL) << 0)
+	                  | (((u64)msg->chime_cadence & 0xFFULL) << 8)
+	                  | (((u64)msg->chime_duration & 0xFFULL) << 16)
+	                  | (((u64)msg->chime_repeat & 0xFFULL) << 24)
+	                  | (((u64)msg->chime_volume & 0xFFULL) << 32);
+}
+
+static inline void gmlan_unpackChime(const CAN_FRAME *frame, GMLAN_CHIME *msg) {
+	msg->chime_tone = (u8)((frame->data.value >> 0) & 0xFFULL);
+	msg->chime_cadence = (u8)((frame->data.value >> 8) & 0xFFULL);
+	msg->chime_duration = (u8)((frame->data.value >> 16) & 0xFFULL);
+	msg->chime_repeat = (u8)((frame->data.value >> 24) & 0xFFULL);
+	msg->chime_volume = (u8)((frame->data.value >> 32) & 0xFFULL);
+}
+
+
+int gmlan_dbcSelfTest();
+
+
+#endif /* SRC_GMLAN_DBC_H_ */
@@ -0,0 +1,278 @@
+/*
+ * isotp.c
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#include "isotp.h"
+
+// Protocol Control Information, upper nibble of the first data byte
+#define ISOTP_PCI_SF         0x00		// Single Frame
+#define ISOTP_PCI_FF         0x10		// First Frame
+#define ISOTP_PCI_CF         0x20		// Consecutive Frame
+#define ISOTP_PCI_FC         0x30		// Flow Control
+
+// Flow status of a Flow Control frame
+#define ISOTP_FS_CTS         0x00		// continue to send
+#define ISOTP_FS_WAIT        0x01
+#define ISOTP_FS_OVFLW       0x02		// overflow, abort
+
+
+// Separation time in msec from the raw STmin value
+static u8 isotp_stminMs(u8 stmin) {
+	if (stmin <= 0x7F)
+		return stmin;
+	if ((stmin >= 0xF1) && (stmin <= 0xF9))
+		return 1;			// 100 - 900 usec, rounded up to the 1 msec tick
+	return 0x7F;			// reserved values: use the longest time
+}
+
+// Send one frame if the MCP2515 transmit buffer is free, returns false if it is still busy
+static bool isotp_txFrame(ISOTP_LINK *link, CAN_FRAME *frame) {
+	if (sendCANMessage(link->can, frame) != XST_SUCCESS)
+		return false;
+	link->frames_tx++;
+	return true;
+}
+
+static void isotp_frameInit(ISOTP_LINK *link, CAN_FRAME *frame) {
+	frame->id = link->tx_id;
+	frame->length = 8;
+	for (u8 i = 0; i < 8; i++)
+		frame->data.byte[i] = ISOTP_PAD_BYTE;
+}
+
+
+void isotp_init(ISOTP_LINK *link, MCP2515 *can, u32 tx_id, u32 rx_id, u8 *rx_buf, u16 rx_size) {
+	link->can = can;
+	link->tx_id = tx_id;
+	link->rx_id = rx_id;
+	link->bs = ISOTP_DEFAULT_BS;
+	link->stmin = ISOTP_DEFAULT_STMIN;
+	link->tx_state = ISOTP_IDLE;
+	link->tx_wait_fc = false;
+	link->rx_state = ISOTP_IDLE;
+	link->rx_buf = rx_buf;
+	link->rx_size = rx_size;
+	link->rx_fc_pending = false;
+	link->frames_tx = 0;
+	link->frames_rx = 0;
+	link->errors = 0;
+}
+
+// Flow control parameters advertised to a sender: bs consecutive frames per block
+// (0 = unlimited) and stmin (raw ISO-TP value, 0-127 msec or 0xF1-0xF9 for 100-900 usec)
+void isotp_setParams(ISOTP_LINK *link, u8 bs, u8 stmin) {
+	link->bs = bs;
+	link->stmin = stmin;
+}
+
+// Start sending len bytes of data. The buffer must stay valid until the transfer is done.
+// Returns XST_DEVICE_BUSY if a transfer is still running.
+int isotp_send(ISOTP_LINK *link, const u8 *data, u16 len, u32 now) {
+	if (link->tx_state == ISOTP_BUSY)
+		return XST_DEVICE_BUSY;
+	if ((len == 0) || (len > ISOTP_MAX_LEN))
+		return XST_FAILURE;
+
+	link->tx_data = data;
+	link->tx_len = len;
+	link->tx_pos = 0;
+	link->tx_sn = 1;
+	link->tx_wait_fc = false;
+	link->tx_wait_cnt = 0;
+	link->tx_time = now;
+	link->tx_state = ISOTP_BUSY;
+	return XST_SUCCESS;
+}
+
+// Handle one received frame. Frames with another identifier are ignored.
+void isotp_onFrame(ISOTP_LINK *link, CAN_FRAME *frame, u32 now) {
+	if ((frame->id != link->rx_id) || (frame->length == 0))
+		return;
+
+	u8 *d = frame->data.byte;
+	link->frames_rx++;
+
+	switch (d[0] & 0xF0) {
+	case ISOTP_PCI_SF: {
+		u8 len = d[0] & 0x0F;
+		if ((len == 0) || (len > 7) || (len > frame->length - 1) || (len > link->rx_size)) {
+			link->errors++;
+			return;
+		}
+		for (u8 i = 0; i < len; i++)
+			link->rx_buf[i] = d[1 + i];
+		link->rx_len = len;
+		link->rx_state = ISOTP_DONE;
+		break;}
+
+	case ISOTP_PCI_FF: {
+		u16 len = ((d[0] & 0x0F) << 8) | d[1];
+		if ((len < 8) || (frame->length < 8)) {
+			link->errors++;
+			return;
+		}
+		link->rx_time = now;
+		if (len > link->rx_size) {				// does not fit, tell the sender to abort
+			link->rx_fc_status = ISOTP_FS_OVFLW;
+			link->rx_fc_pending = true;
+			link->rx_state = ISOTP_ERROR;
+			link->errors++;
+			return;
+		}
+		for (u8 i = 0; i < 6; i++)
+			link->rx_buf[i] = d[2 + i];
+		link->rx_len = len;
+		link->rx_pos = 6;
+		link->rx_sn = 1;
+		link->rx_bs_cnt = 0;
+		link->rx_fc_status = ISOTP_FS_CTS;
+		link->rx_fc_pending = true;
+		link->rx_state = ISOTP_BUSY;
+		break;}
+
+	case ISOTP_PCI_CF: {
+		if (link->rx_state != ISOTP_BUSY)
+			return;
+		if ((d[0] & 0x0F) != link->rx_sn) {		// lost or repeated frame, abort the reception
+			link->rx_state = ISOTP_ERROR;
+			link->errors++;
+			return;
+		}
+		u16 cnt = link->rx_len - link->rx_pos;
+		if (cnt > 7)
+			cnt = 7;
+		for (u8 i = 0; i < cnt; i++)
+			link->rx_buf[link->rx_pos + i] = d[1 + i];
+		link->rx_pos += cnt;
+		link->rx_sn = (link->rx_sn + 1) & 0x0F;
+		link->rx_time = now;
+
+		if (link->rx_pos >= link->rx_len) {
+			link->rx_state = ISOTP_DONE;
+		} else if (link->bs != 0) {
+			if (++link->rx_bs_cnt == link->bs) {	// end of block, allow the next one
+				link->rx_bs_cnt = 0;
+				link->rx_fc_status = ISOTP_FS_CTS;
+				link->rx_fc_pending = true;
+			}
+		}
+		break;}
+
+	case ISOTP_PCI_FC:
+		if ((link->tx_state != ISOTP_BUSY) || (!link->tx_wait_fc) || (frame->length < 3))
+			return;
+		switch (d[0] & 0x0F) {
+		case ISOTP_FS_CTS:
+			link->tx_bs = d[1];
+			link->tx_stmin = isotp_stminMs(d[2]);
+			link->tx_bs_cnt = 0;
+			link->tx_wait_fc = false;
+			link->tx_time = now - link->tx_stmin - 1;	// the first consecutive frame may go out at once
+			break;
+		case ISOTP_FS_WAIT:
+			link->tx_time = now;
+			if (++link->tx_wait_cnt > ISOTP_MAX_WAIT) {
+				link->tx_state = ISOTP_ERROR;
+				link->errors++;
+			}
+			break;
+		default:								// overflow or invalid flow status
+			link->tx_state = ISOTP_ERROR;
+			link->errors++;
+			break;
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+// Advance the transfers: sends at most one frame per call and checks the timeouts
+void isotp_poll(ISOTP_LINK *link, u32 now) {
+	CAN_FRAME frame;
+
+	// Receive side: pending Flow Control frame first, then the consecutive frame timeout
+	if (link->rx_fc_pending) {
+		isotp_frameInit(link, &frame);
+		frame.data.byte[0] = ISOTP_PCI_FC | link->rx_fc_status;
+		frame.data.byte[1] = link->bs;
+		frame.data.byte[2] = link->stmin;
+		if (isotp_txFrame(link, &frame))
+			link->rx_fc_pending = false;
+		return;
+	}
+	if ((link->rx_state == ISOTP_BUSY) && ((now - link->rx_time) > ISOTP_TIMEOUT_CR)) {
+		link->rx_state = ISOTP_ERROR;
+		link->errors++;
+	}
+
+	// Transmit side
+	if (link->tx_state != ISOTP_BUSY)
+		return;
+
+	if (link->tx_wait_fc) {
+		if ((now - link->tx_time) > ISOTP_TIMEOUT_BS) {
+			link->tx_state = ISOTP_ERROR;
+			link->errors++;
+		}
+		return;
+	}
+
+	isotp_frameInit(link, &frame);
+
+	if (link->tx_pos == 0) {
+		if (link->tx_len <= 7) {				// Single Frame
+			frame.data.byte[0] = ISOTP_PCI_SF | link->tx_len;
+			for (u8 i = 0; i < link->tx_len; i++)
+				frame.data.byte[1 + i] = link->tx_data[i];
+			if (isotp_txFrame(link, &frame))
+				link->tx_state = ISOTP_DONE;
+			return;
+		}
+		frame.data.byte[0] = ISOTP_PCI_FF | (link->tx_len >> 8);	// First Frame
+		frame.data.byte[1] = link->tx_len & 0xFF;
+		for (u8 i = 0; i < 6; i++)
+			frame.data.byte[2 + i] = link->tx_data[i];
+		if (isotp_txFrame(link, &frame)) {
+			link->tx_pos = 6;
+			link->tx_wait_fc = true;
+			link->tx_time = now;
+		}
+		return;
+	}
+
+	// Separation time not yet elapsed. now is a msec tick: frames STmin ticks apart may be only
+	// STmin - 1 msec apart, so with STmin > 0 one more tick is waited.
+	if ((link->tx_stmin != 0) && ((now - link->tx_time) <= link->tx_stmin))
+		return;
+
+	u16 cnt = link->tx_len - link->tx_pos;		// Consecutive Frame
+	if (cnt > 7)
+		cnt = 7;
+	frame.data.byte[0] = ISOTP_PCI_CF | link->tx_sn;
+	for (u8 i = 0; i < cnt; i++)
+		frame.data.byte[1 + i] = link->tx_data[link->tx_pos + i];
+	if (!isotp_txFrame(link, &frame))
+		return;
+
+	link->tx_pos += cnt;
+	link->tx_sn = (link->tx_sn + 1) & 0x0F;
+	link->tx_time = now;
+
+	if (link->tx_pos >= link->tx_len) {
+		link->tx_state = ISOTP_DONE;
+	} else if ((link->tx_bs != 0) && (++link->tx_bs_cnt == link->tx_bs)) {
+		link->tx_wait_fc = true;				// end of block, wait for the next Flow Control
+	}
+}
+
+// Returns the length of a completely received payload (in link->rx_buf) once, 0 if none
+u16 isotp_received(ISOTP_LINK *link) {
+	if (link->rx_state != ISOTP_DONE)
+		return 0;
+	link->rx_state = ISOTP_IDLE;
+	return link->rx_len;
+}
@@ -0,0 +1,94 @@
+/*
+ * isotp.h
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#ifndef SRC_ISOTP_H_
+#define SRC_ISOTP_H_
+
+#include "xil_types.h"
+#include "xstatus.h"
+#include "stdbool.h"
+#include "mcp2515.h"		// CAN_FRAME, sendCANMessage, receiveCANMessage
+
+
+// ISO 15765-2 (ISO-TP) transport on top of the MCP2515 send / receive layer.
+// Payloads up to 4095 bytes are segmented into a First Frame and Consecutive Frames,
+// the receiver paces the sender with Flow Control frames (block size BS, separation time STmin).
+// Nothing blocks: isotp_send() only starts a transfer, isotp_poll() sends at most one frame
+// per call and isotp_onFrame() handles one received frame. Both are called from the main loop.
+// Time is passed in msec (millis in main.c), so STmin values below 1 msec (0xF1-0xF9) count as 1 msec,
+// and consecutive frames are sent STmin + 1 ticks apart, at least STmin msec.
+
+// Identifiers of the IPC diagnostic link (USDT request / response).
+// The request uses the device control identifier, the response identifier is an assumption, check on the cluster.
+#define ISOTP_IPC_TX_ID      0x255
+#define ISOTP_IPC_RX_ID      0x655
+
+#define ISOTP_MAX_LEN        4095
+#define ISOTP_PAD_BYTE       0x00		// unused bytes of a frame, frames are always sent with DLC 8
+
+// Default flow control parameters, advertised when receiving (tune with isotp_setParams)
+#define ISOTP_DEFAULT_BS     0			// 0: no further flow control frames after the first
+#define ISOTP_DEFAULT_STMIN  0			// msec between consecutive frames
+
+// Timeouts (msec)
+#define ISOTP_TIMEOUT_BS     1000		// N_Bs: sender waiting for a Flow Control frame
+#define ISOTP_TIMEOUT_CR     1000		// N_Cr: receiver waiting for a Consecutive Frame
+#define ISOTP_MAX_WAIT       8			// Flow Control WAIT frames accepted before aborting
+
+// Transfer states
+#define ISOTP_IDLE           0
+#define ISOTP_BUSY           1
+#define ISOTP_DONE           2
+#define ISOTP_ERROR          3
+
+typedef struct {
+	MCP2515 *can;				// controller the link runs on
+	u32 tx_id;					// identifier of the frames we send
+	u32 rx_id;					// identifier of the frames we accept
+	u8 bs;						// block size advertised when receiving
+	u8 stmin;					// STmin advertised when receiving (raw ISO-TP value)
+
+	// Transmit side
+	u8 tx_state;
+	const u8 *tx_data;
+	u16 tx_len;
+	u16 tx_pos;					// next payload byte to send
+	u8 tx_sn;					// next sequence number
+	bool tx_wait_fc;			// waiting for a Flow Control frame
+	u8 tx_bs;					// block size requested by the receiver
+	u8 tx_bs_cnt;				// consecutive frames sent in this block
+	u8 tx_stmin;				// separation time requested by the receiver (msec)
+	u8 tx_wait_cnt;				// Flow Control WAIT frames received
+	u32 tx_time;				// time of the last frame sent / received
+
+	// Receive side
+	u8 rx_state;
+	u8 *rx_buf;
+	u16 rx_size;
+	u16 rx_len;					// length announced by the First Frame
+	u16 rx_pos;					// payload bytes received
+	u8 rx_sn;					// expected sequence number
+	u8 rx_bs_cnt;				// consecutive frames received in this block
+	bool rx_fc_pending;			// a Flow Control frame must be sent by isotp_poll()
+	u8 rx_fc_status;			// flow status of the pending Flow Control frame
+	u32 rx_time;				// time of the last frame received
+
+	// Statistics
+	u32 frames_tx;
+	u32 frames_rx;
+	u32 errors;
+} ISOTP_LINK;
+
+
+void isotp_init(ISOTP_LINK *link, MCP2515 *can, u32 tx_id, u32 rx_id, u8 *rx_buf, u16 rx_size);
+void isotp_setParams(ISOTP_LINK *link, u8 bs, u8 stmin);
+int isotp_send(ISOTP_LINK *link, const u8 *data, u16 len, u32 now);
+void isotp_onFrame(ISOTP_LINK *link, CAN_FRAME *frame, u32 now);
+void isotp_poll(ISOTP_LINK *link, u32 now);
+u16 isotp_received(ISOTP_LINK *link);
+
+
+#endif /* SRC_ISOTP_H_ */
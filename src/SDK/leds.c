@@ -0,0 +1,111 @@
+/*
+ * leds.c
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#include "leds.h"
+
+// Dial masks: led bar mode, leds 0 to pos on / dot mode, only led pos on
+static const u32 led_bar[LED_DIAL_MAX] = {
+	0x0000001, 0x0000003, 0x0000007, 0x000000F, 0x000001F,
+	0x000003F, 0x000007F, 0x00000FF, 0x00001FF, 0x00003FF,
+	0x00007FF, 0x0000FFF, 0x0001FFF, 0x0003FFF, 0x0007FFF,
+	0x000FFFF, 0x001FFFF, 0x003FFFF, 0x007FFFF, 0x00FFFFF,
+	0x01FFFFF, 0x03FFFFF, 0x07FFFFF, 0x0FFFFFF, 0x1FFFFFF,
+};
+static const u32 led_dot[LED_DIAL_MAX] = {
+	0x0000001, 0x0000002, 0x0000004, 0x0000008, 0x0000010,
+	0x0000020, 0x0000040, 0x0000080, 0x0000100, 0x0000200,
+	0x0000400, 0x0000800, 0x0001000, 0x0002000, 0x0004000,
+	0x0008000, 0x0010000, 0x0020000, 0x0040000, 0x0080000,
+	0x0100000, 0x0200000, 0x0400000, 0x0800000, 0x1000000,
+};
+
+
+void led_init(LED_STATE *s) {
+	for (u8 w = 0; w < LED_WORDS; w++)
+		s->word[w] = 0;
+	for (u8 r = 0; r < LED_REGS; r++)
+		s->reg[r] = 0x00;
+	s->valid = false;
+}
+
+// Leds of a dial at position pos: bar mode (leds 0 to pos) or dot mode (led pos only)
+u32 led_dialMask(u8 pos, bool dot_mode) {
+	if (pos >= LED_DIAL_MAX)
+		pos = LED_DIAL_MAX - 1;
+	return dot_mode ? led_dot[pos] : led_bar[pos];
+}
+
+// Wiring: register bytes of the packed leds, bit 0 first. Constant shifts only, a few
+// instructions per byte (no per-bit walk).
+static void led_build(const u32 *w, u8 reg[]) {
+	u32 sw0 = w[LED_W_SW0], sw1 = w[LED_W_SW1];
+
+	reg[0] = sw0 >> 1;													// MAX_1 digit 0: S1 - S8
+	reg[1] = ((sw0 >> 9) & 0x03) | ((w[LED_W_S11] & 0x03) << 2) |		// MAX_1 digit 1: S9, S10, S11 red, yellow,
+			((sw0 >> 8) & 0x70) | (w[LED_W_RPM] << 7);					//                S12 - S14, RPM 0
+	reg[2] = w[LED_W_RPM] >> 1;											// MAX_1 digit 2: RPM 1 - 8
+	reg[3] = w[LED_W_RPM] >> 9;											// MAX_1 digit 3: RPM 9 - 16
+	reg[4] = ((sw0 >> 23) & 0x01) | ((sw0 >> 21) & 0x02) |				// MAX_2 digit 1: S23, S22, S21, S20,
+			((sw0 >> 19) & 0x04) | ((sw0 >> 17) & 0x08) |
+			((sw0 >> 20) & 0x30) | ((sw1 << 3) & 0x40) | (w[LED_W_SP] << 7);	//                S24, S25, S35, speed 0
+	reg[5] = ((sw0 >> 15) & 0x1F) | ((sw0 >> 21) & 0x20) |				// MAX_2 digit 2: S15 - S19, S26, bit 6 not used,
+			(w[LED_W_FUEL] << 7);										//                fuel 0
+	reg[6] = w[LED_W_FUEL] >> 1;										// MAX_2 digit 3: fuel 1 - 8
+	reg[7] = (sw0 >> 27) | (sw1 << 5);									// MAX_3 digit 0: S27 - S34
+	reg[8] = w[LED_W_SP] >> 1;											// MAX_3 digit 1: speed 1 - 8
+	reg[9] = w[LED_W_SP] >> 9;											// MAX_3 digit 2: speed 9 - 16
+	reg[10] = w[LED_W_SP] >> 17;										// MAX_3 digit 3: speed 17 - 24
+}
+
+// Recomputes the register bytes if a led changed since the last gather.
+// sw11_red is the color of the S11 bi-color led (switch 11 on: red or yellow).
+// Returns a mask of the register bytes that changed (bit r = s->reg[r]), 0 if none did.
+u16 led_gather(LED_STATE *s, bool sw11_red) {
+	u16 dirty = 0;
+	u8 reg[LED_REGS];
+
+	if (LED_GET(s->word, 11))
+		s->word[LED_W_S11] = sw11_red ? LED_S11_RED : LED_S11_YELLOW;
+	else
+		s->word[LED_W_S11] = 0;
+
+	// Word by word, a vector compare of the words would wait for the led stores of the caller
+	u32 changed = (s->word[LED_W_SW0] ^ s->gathered[LED_W_SW0]) | (s->word[LED_W_SW1] ^ s->gathered[LED_W_SW1]) |
+			(s->word[LED_W_RPM] ^ s->gathered[LED_W_RPM]) | (s->word[LED_W_FUEL] ^ s->gathered[LED_W_FUEL]) |
+			(s->word[LED_W_SP] ^ s->gathered[LED_W_SP]) | (s->word[LED_W_S11] ^ s->gathered[LED_W_S11]);
+	if ((changed == 0) && s->valid)				// no led changed since the last gather
+		return 0;
+	for (u8 w = 0; w < LED_WORDS; w++)
+		s->gathered[w] = s->word[w];
+
+	led_build(s->word, reg);
+	for (u8 r = 0; r < LED_REGS; r++) {
+		if (reg[r] != s->reg[r])
+			dirty |= 1 << r;
+		s->reg[r] = reg[r];
+	}
+	if (!s->valid) {
+		dirty = (1 << LED_REGS) - 1;
+		s->valid = true;
+	}
+	return dirty;
+}
+
+// Copies the register bytes into a MAX7221 byte value table (digits 0-3, MAX_2 digit 0 not used)
+void led_toTable(const LED_STATE *s, u8 mx[][8]) {
+	mx[0][0] = s->reg[0];
+	mx[0][1] = s->reg[1];
+	mx[0][2] = s->reg[2];
+	mx[0][3] = s->reg[3];
+	mx[1][1] = s->reg[4];
+	mx[1][2] = s->reg[5];
+	mx[1][3] = s->reg[6];
+	mx[2][0] = s->reg[7];
+	mx[2][1] = s->reg[8];
+	mx[2][2] = s->reg[9];
+	mx[2][3] = s->reg[10];
+}
+
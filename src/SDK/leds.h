@@ -0,0 +1,57 @@
+/*
+ * leds.h
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#ifndef SRC_LEDS_H_
+#define SRC_LEDS_H_
+
+#include "xil_types.h"
+#include "stdbool.h"
+
+
+// Packed state of the switch leds and dial leds (one bit per led) and their MAX7221 register bytes.
+// The register bytes are rebuilt with constant shifts (no per-bit walk), only if a led changed
+// since the last gather, and the gather reports the bytes that changed: a pass without a led
+// change draws nothing.
+// Dial masks (led bar / dot mode) come from lookup tables: the MicroBlaze barrel shifter is
+// optional, a variable shift may be a loop.
+
+// Words of LED_STATE.word[]
+#define LED_W_SW0            0			// switch leds 0 to 31, bit n = switch n (bit 0 not used)
+#define LED_W_SW1            1			// switch leds 32 to 35, bit n = switch 32 + n
+#define LED_W_RPM            2			// RPM dial leds 0 to 16
+#define LED_W_FUEL           3			// fuel dial leds 0 to 8
+#define LED_W_SP             4			// speed dial leds 0 to 24
+#define LED_W_S11            5			// S11 bi-color led, set by led_gather() from switch 11 and its color
+#define LED_WORDS            6
+#define LED_SW_WORDS         2			// words of a switch led map
+
+#define LED_S11_RED          0x01		// bits of word LED_W_S11
+#define LED_S11_YELLOW       0x02
+
+#define LED_REGS             11			// MAX7221 register bytes with leds (digits 0-3, MAX_2 digit 0 not used)
+#define LED_DIAL_MAX         25			// longest dial
+
+// Switch led maps: u32 array, bit n = switch n (LED_STATE.word, or a map of LED_SW_WORDS words)
+#define LED_GET(map, n)      (((map)[(n) >> 5] >> ((n) & 0x1F)) & 1)
+#define LED_SET(map, n)      ((map)[(n) >> 5] |= ((u32)1 << ((n) & 0x1F)))
+#define LED_CLR(map, n)      ((map)[(n) >> 5] &= ~((u32)1 << ((n) & 0x1F)))
+#define LED_PUT(map, n, on)  do { if (on) LED_SET(map, n); else LED_CLR(map, n); } while (0)
+
+typedef struct {
+	u32 word[LED_WORDS];		// packed leds, see LED_W_*
+	u32 gathered[LED_WORDS];	// words the register bytes were gathered from
+	u8 reg[LED_REGS];			// register bytes, in the order of led_regPos
+	bool valid;					// false: the next gather recomputes every byte
+} LED_STATE;
+
+
+void led_init(LED_STATE *s);
+u32 led_dialMask(u8 pos, bool dot_mode);
+u16 led_gather(LED_STATE *s, bool sw11_red);
+void led_toTable(const LED_STATE *s, u8 mx[][8]);
+
+
+#endif /* SRC_LEDS_H_ */
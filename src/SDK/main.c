@@ -31,11 +31,24 @@
 #include "sleep.h"
 #include "spi_api.h"		// include before ICs header files
 #include "gpio_api.h"		// include before ICs header files
+#include "uart_api.h"		// UART telemetry input
 #include "max7221.h"		// Led Controller     IC max7221  header file
+#include "display.h"		// Double buffered MAX7221 display refresh
+#include "fade.h"			// MAX7221 intensity fading
 #include "mcp23s17.h"		// I/O Expander       IC mcp23s17 header file
 #include "mcp2515.h"		// CAN-Bus Controller IC mcp2515  header file
 #include "stdbool.h"
 #include "int_init.h"
+#include "telemetry.h"		// UART telemetry stream parser
+#include "gmlan_db.h"		// GMLAN signal database for the IPC CAN-Bus messages
+#include "isotp.h"			// ISO-TP transport for multi-frame CAN-Bus transfers
+#include "anim.h"			// Keyframe animations (demonstration)
+#include "seg7.h"			// 7-seg led display text and number glyphs
+#include "leds.h"			// Packed switch leds & dial leds, MAX7221 register bytes
+#include "debounce.h"		// Switch debouncing on the port snapshot
+#include "encoder.h"		// Rotary Enc decoding with acceleration
+#include "evq.h"			// Input event queue, interrupts to main loop
+#include "switches.h"		// Bit-parallel switch decoding of the port snapshot
 
 
 // u8 = unsigned char
@@ -48,6 +61,54 @@
 #define demoDelayTime4 600
 #define demoDelayTime5 200
 #define demoDelayTime6 200
+#define demoSweepTime 1200      // dial leds from 0 to maximum
+#define demoScrollTime 150      // 7-seg led display text, one digit per step
+
+// Demonstration animations, played one after the other: 7-seg displays, switch leds, dial leds
+#define DEMO_SEGS      0
+#define DEMO_SWITCHES  1
+#define DEMO_DIALS     2
+#define DEMO_CNT       3
+
+// demo_segs() frames: 0-7 snake, 8-15 snake with decimal point, then all on, all off, text scrolling in
+#define DEMO_SEG_ALL_ON   16
+#define DEMO_SEG_ALL_OFF  17
+#define DEMO_SEG_TEXT     18
+
+// Dial leds keyframes: up, pause, down, pause, in dot mode and then in led bar mode, all dials together
+#define DEMO_DIAL_KEYS(max) { \
+	{0,                                          0,   ANIM_LINEAR}, \
+	{  demoSweepTime,                            max, ANIM_STEP},   \
+	{  demoSweepTime +   demoDelayTime5,         max, ANIM_LINEAR}, \
+	{2*demoSweepTime +   demoDelayTime5,         0,   ANIM_STEP},   \
+	{2*demoSweepTime + 2*demoDelayTime5,         0,   ANIM_LINEAR}, \
+	{3*demoSweepTime + 2*demoDelayTime5,         max, ANIM_STEP},   \
+	{3*demoSweepTime + 3*demoDelayTime5,         max, ANIM_LINEAR}, \
+	{4*demoSweepTime + 3*demoDelayTime5,         0,   ANIM_STEP},   \
+	{4*demoSweepTime + 4*demoDelayTime5,         0,   ANIM_STEP}}
+
+// Leds intensity
+#define FADE_IN_TIME     600    // msec, fade-in at power up
+#define IDLE_DIM_TIME  60000    // msec without switch / rotary enc activity before the leds dim
+#define ALARM_PULSE     800     // msec per intensity pulse while the Emergency Lights are on
+
+// Display overlays
+#define LAMP_TEST_TIME  2000    // msec, S35 all leds on test
+#define POPUP_TIME      1000    // msec, dial mode pop-up on the 7-seg led display
+
+// Info leds on IC3 Port B_7-4 (outputs), bits 3-0 are switch inputs
+#define INFO_LED_MASK  0xF0
+
+// Rotary Enc A/B inputs in the 48-bit port snapshot (see enc_states)
+#define ENC_PORT_MASK  0x000300180600ULL   // IC3: A_1,0   IC2: A_4,3   IC1: B_2,1
+
+// CAN-Bus messages to the Instrument Panel Cluster are queued, and sent at least IPC_TX_GAP apart
+#define IPC_TX_GAP        30    // msec
+
+// CAN-Bus messages that follow the telemetry stream: one message per period at most, only for the
+// dials / indication groups that changed, the latest value when it is sent (33.3 kbps GMLAN)
+#define TELEM_CAN_PERIOD  30    // msec between two messages
+#define TELEM_CAN_SLOTS   8     // RPM, fuel, speed dial, indication groups 1-5
 
 // Maximum number of dial leds
 #define rpm_max  17
@@ -59,35 +120,40 @@ volatile bool flg = false;          // the flag is set when switch is pressed/re
 volatile bool wake = false;         // the flag is set every 1 second
 
 // Amount of time in milliseconds passed since Timer2 initialized
-u32 millis = 0;
+volatile u32 millis = 0;
+
+// MCP2515 on the Instrument Panel Cluster CAN-Bus (GMLAN single wire CAN, 20 MHz crystal)
+MCP2515 can_ipc;
 
-typedef struct {                    // demo_dial_leds function
-	int time;
-	unsigned char rpm;
-	unsigned char fuel;
-	unsigned char sp;
-} DemoData;
 
 
 void MCPisCalling();                // Interrupt Service Routine for MCP23S17 port status change
 void WakeUp();                      // Timer1 calls WakeUp() every 1 second to set the "wake" flag, in order to send a wake-up message over CAN-Bus
 
-void fill_led_table(bool led_rpm[], bool led_fuel[], bool led_sp[], bool led_sw[], bool *led_sw11_color, unsigned char mx[][8]);
+void enc_states(u64 ports, unsigned char enc[]);
+bool dial_step(unsigned char *value, s16 delta, unsigned char max);
+bool fill_led_table(LED_STATE *leds, bool led_sw11_color, unsigned char mx[][8]);
 void set_led_table(unsigned char mx[][8]);
-void calc_rpm_leds(unsigned char *rpm, bool mode[], bool led_rpm[]);
-void calc_fuel_leds(unsigned char *fuel, bool mode[], bool led_fuel[]);
-void calc_sp_leds(unsigned char *sp, bool mode[], bool led_sp[]);
+void calc_rpm_leds(unsigned char *rpm, bool mode[], u32 *led_rpm);
+void calc_fuel_leds(unsigned char *fuel, bool mode[], u32 *led_fuel);
+void calc_sp_leds(unsigned char *sp, bool mode[], u32 *led_sp);
 void show_leds(unsigned char mx[][8], unsigned char *info_led);
 void show_num_rpm(unsigned int rpm_value, unsigned char *info_led);
 void show_num_fuel(unsigned int fuel_value, unsigned char *info_led);
 void show_num_sp(unsigned int sp_value, unsigned char *info_led);
 void set_num_all(unsigned char *info_led);
-void clear_leds_on_lcd(bool led_sw[], bool led_sw_old[], unsigned char lights_status[], unsigned char *info_led);    // Not used
-void clear_switch_leds(bool led_sw[], bool led_sw_old[], unsigned char lights_status[], unsigned char *info_led);
-void clear_dials(unsigned char *rpm, unsigned char *fuel, unsigned char *sp, bool mode[], bool led_rpm[], bool led_fuel[], bool led_sp[], unsigned char *info_led);
-void demo_segs(unsigned char demoSeg[], unsigned char rfs[]);
-void demo_switch_leds(bool led_sw[], unsigned char demoButtons[], bool led_rpm[], bool led_fuel[], bool led_sp[], bool *led_sw11_color, unsigned char mx[][8], unsigned char *info_led);
-void demo_dial_leds(DemoData demo[], bool led_sw[], bool *led_sw11_color, unsigned char mx[][8], unsigned char *info_led);
+void show_lamp_test(unsigned char mx[][8], unsigned char *info_led);
+void set_alarm_layer();
+void show_mode_popup(unsigned char icNumber, bool dot_mode);
+void clear_leds_on_lcd(u32 led_sw[], u32 led_sw_old[], unsigned char lights_status[], unsigned char *info_led);    // Not used
+void clear_switch_leds(u32 led_sw[], u32 led_sw_old[], unsigned char lights_status[], unsigned char *info_led);
+void clear_dials(unsigned char *rpm, unsigned char *fuel, unsigned char *sp, bool mode[], u32 *led_rpm, u32 *led_fuel, u32 *led_sp, unsigned char *info_led);
+void demo_segs(unsigned char frame, unsigned char demoSeg[], const char *demoText[], SEG7_MARQUEE marquee[], unsigned int now);
+void demo_switch_leds(unsigned char count, bool sw11_red, unsigned char demoButtons[], LED_STATE *leds, unsigned char mx[][8], unsigned char *info_led);
+void demo_dial_leds(unsigned char rpm, unsigned char fuel, unsigned char sp, bool dot_mode, u32 led_sw[], bool *led_sw11_color, unsigned char mx[][8], unsigned char *info_led);
+bool apply_telemetry(TELEM_DATA *telem, TELEM_DATA *telem_old, unsigned char dial_want[], unsigned char *rpm, unsigned char *fuel, unsigned char *sp, bool mode[], u32 *led_rpm, u32 *led_fuel, u32 *led_sp, const unsigned char rpm_dial[], const unsigned char fuel_dial[], const unsigned char sp_dial[], unsigned char *info_led);
+unsigned char apply_telemetry_flags(TELEM_DATA *telem, TELEM_DATA *telem_old, u32 led_sw[], u32 led_sw_old[], unsigned char lights[][2], unsigned char lights_status[], unsigned char *info_led);
+bool send_telemetry_can(unsigned char dial_want[], unsigned char dial_sent[], unsigned char *lamps_pending, unsigned char lights_status[], unsigned char *slot);
 
 
 // Main application setup
@@ -96,50 +162,51 @@ int main() {
 
 	gpio_init();			// Initialize AXI GPIO
 
+	uart_init();			// Initialize AXI UartLite (telemetry input)
+
 	spi_init();				// Initialize AXI SPI
 	XSpi_IntrGlobalDisable(&SpiInstance);
 
+	evq_init();				// Input event queue, before the interrupts are enabled
 	initInterruptController();	// Initialize Interrupt Controller
 
 	unsigned char mx[3][8] = {0};   // MAX7221 byte value tables
+	unsigned char mx_test[3][8] = {0};  // MAX7221 byte value tables of the lamp test layer
 
     // Switch leds & dial leds
-	bool led_rpm[rpm_max] = {0};    // RPM dial leds
-	bool led_fuel[fuel_max] = {0};  // Fuel dial leds
-	bool led_sp[sp_max] = {0};      // Speed dial leds
+	LED_STATE leds;                 // Packed switch leds & dial leds, one bit per led
+	led_init(&leds);
+	u32 *led_rpm = &leds.word[LED_W_RPM];    // RPM dial leds, bit n = led n
+	u32 *led_fuel = &leds.word[LED_W_FUEL];  // Fuel dial leds
+	u32 *led_sp = &leds.word[LED_W_SP];      // Speed dial leds
 	bool mode[4] = {0};             // Dial leds mode, 0=Led_bar_mode 1=Dot_led_mode, index 0 not used, (rpm,fuel,speed)=(1,2,3)
-	bool led_sw[36] = {0};          // Switch leds, index 0 not used
-	bool led_sw_old[36] = {0};      // Switch leds previous state, index 0 not used
+	u32 *led_sw = leds.word;        // Switch leds, bit n = switch n (LED_GET / LED_PUT), bit 0 not used
+	u32 led_sw_old[LED_SW_WORDS] = {0};  // Switch leds previous state, bit 0 not used
 	bool led_sw11_color = 0;        // 0 is Yellow, 1 is Red
 	bool led_sw11_changed = 0;      // flag to change state: Off -> On Yellow -> On Red -> Off
 	bool sw25_on = 0;               // flag to auto reset switch 25 led (Beep switch)
 
-	bool sw[36] = {0};              // Switch state, 0=released 1=pressed, index 0 not used
-	bool enc_sw[4] = {0};           // Rotary Enc switch state, 0=released 1=pressed, index 0 not used
-	unsigned char enc[4] = {0};     // Rotary Enc state, 0=released 1=pressed, index 0 not used, (enc_1,enc_2,enc_3)=(1,2,3)
-	unsigned char thisState[4] = {0}; // bits 1-0 for ind (knobPosition index), index 0 not used
-	unsigned char oldState[4] = {0};  // bits 3-2 for ind (knobPosition index), index 0 not used
-	const int8_t KNOBDIR[] = {        // Array decisive for completeness of 4 states per Rotary Enc click, CW or CCW
-		 0,  1, -1,  0,
-		-1,  0,  0,  1,
-	     1,  0,  0, -1,
-		 0, -1,  1,  0  };
-
-	signed char knobPosition[4] = {0};  // Rotary Enc state during movement, CW: 0 ->  1 ->  2 ->  3 ->  4(=0)    (enc_1,enc_2,enc_3)=(1,2,3)
-	int ind;                        // index for knobPosition               CCW: 0 -> -1 -> -2 -> -3 -> -4(=0)    (index 0 not used)
-	bool rotary_move[4] = {0};      // Rotary Enc in movement, 1 means the 4 states per click not completed, index 0 is any R.Enc in movement
+	SW_DECODE switches = {0};       // Switches in logical order (bit n = Sn, SW_ENC_SW(n) = Rotary Enc switch n), debounced
+	u64 sw_held = 0;                // presses held while a Rotary Enc is between detents
+	u64 sw_todo;                    // switches to update: pressed, or switch led changed
+	u64 led_diff;                   // switch leds that differ from their previous state
+	int sw_i;
+	unsigned char enc[4] = {0};     // Rotary Enc A/B state (bits 1-0), index 0 not used, (enc_1,enc_2,enc_3)=(1,2,3)
 
 	// RPM/Fuel/Speed dial leds
 	unsigned char rpm = 0;
 	unsigned char fuel = 0;
 	unsigned char sp = 0;
 
-	unsigned char port_1A;  // IC1 Port A
-	unsigned char port_1B;  // IC1 Port A
-	unsigned char port_2A;  // IC2 Port A
-	unsigned char port_2B;  // IC2 Port B
-	unsigned char port_3A;  // IC3 Port A
-	unsigned char port_3B;  // IC3 Port B
+	u64 ports;              // 48-bit snapshot of all ports, live state (mcp_scanPorts, mcp_captureAll)
+	u64 ports_old;          // 48-bit snapshot of the previous pass or switch sample
+	u64 ports_cap;          // 48-bit snapshot latched at the interrupt (INTCAP)
+	EVQ_EVENT input_event;  // interrupt event from the input event queue
+	u32 mcp_int_ms;         // time of the first MCP23S17 interrupt since the previous pass, time of the INTCAP state
+	u8 mcp_restored;        // IC number + 1 whose configuration the background check restored
+	u32 mcp_edge_lost = 0;  // input changes found by a switch sample that no INT edge reported
+	u64 enc_step[2];        // port states fed to the Rotary Enc logic: at the interrupt, then live
+	unsigned char enc_steps;
 	unsigned char info_led = 0xF0;    // bit-encoded variable: bits 7:4 represent: "Led", "Switch", "R.Encoder", "Seg.Display" activity. All leds active-low
 
 	unsigned char cnt = 0;            // variable that counts how many times the flag "wake" becomes true (every second)
@@ -151,42 +218,49 @@ int main() {
 
 	// 7-seg led display message data
 	unsigned char demoSeg[8] = {0x02, 0x40, 0x20, 0x01, 0x04, 0x08, 0x10, 0x01};                      // snake movement: F, A, B, G, E, D, C, G
-	unsigned char rfs[12] = {0x05, 0x67, 0x15, 0x11 ,0x47, 0x3E, 0x4F, 0x0E, 0x5B, 0x67, 0x4F, 0x4F}; // "rPri", "FuEL" and "SPEE" meaning "RPM", "FUEL" and "SPEED"
-	unsigned char errMCP[4] = {0x00, 0x4F, 0x05, 0x05};                                               // " Err" meaning "Error"		(not used in SDK)
-
-	DemoData demo[33] = {{   0,  0, 0,  0},     // dial leds demonstration, parallel dial movement
-                         {  50,  0, 0,  1},     // (time from demo start, rpm leds, fuel leds, speed leds)
-                         {  75,  1, 0,  1},
-                         { 100,  1, 0,  2},
-                         { 150,  2, 1,  3},
-                         { 200,  2, 1,  4},
-                         { 225,  3, 1,  4},
-                         { 250,  3, 1,  5},
-                         { 300,  4, 2,  6},
-                         { 350,  4, 2,  7},
-                         { 375,  5, 2,  7},
-                         { 400,  5, 2,  8},
-                         { 450,  6, 3,  9},
-                         { 500,  6, 3, 10},
-                         { 525,  7, 3, 10},
-                         { 550,  7, 3, 11},
-                         { 600,  8, 4, 12},
-                         { 650,  8, 4, 13},
-                         { 675,  9, 4, 13},
-                         { 700,  9, 4, 14},
-                         { 750, 10, 5, 15},
-                         { 800, 10, 5, 16},
-                         { 825, 11, 5, 16},
-                         { 850, 11, 5, 17},
-                         { 900, 12, 6, 18},
-                         { 950, 12, 6, 19},
-                         { 975, 13, 6, 19},
-                         {1000, 13, 6, 20},
-                         {1050, 14, 7, 21},
-                         {1100, 14, 7, 22},
-                         {1125, 15, 7, 22},
-                         {1150, 15, 7, 23},
-                         {1200, 16, 8, 24}};
+	const char *demoText[3] = {"rPM", "FUEL", "SPEEd"};                                               // rendered by seg7.c, scrolled in on the RPM, fuel and speed displays
+	const char errMCP[] = " Err";                                                                      // "Error", MCP23S17 configuration lost
+	SEG7_MARQUEE demo_marquee[3] = {{0}};  // not running until the text frame
+
+	// Demonstration keyframes (msec from the start of each animation, value, curve to the next keyframe)
+	static const ANIM_KEY demo_seg_keys[] = {
+		{0,                                    0,                ANIM_LINEAR},  // one snake frame every demoDelayTime1
+		{16 * demoDelayTime1,                  DEMO_SEG_ALL_ON,  ANIM_STEP},
+		{16 * demoDelayTime1 + demoDelayTime2, DEMO_SEG_ALL_OFF, ANIM_STEP},
+		{16 * demoDelayTime1 + 2*demoDelayTime2, DEMO_SEG_TEXT,  ANIM_STEP},  // text scrolls in (up to 5 steps), then stays
+		{16 * demoDelayTime1 + 3*demoDelayTime2 + 5*demoScrollTime, DEMO_SEG_TEXT, ANIM_STEP}};
+	static const ANIM_KEY demo_sw_keys[] = {                                    // number of demoButtons leds on
+		{0,                                        1,  ANIM_LINEAR},            // one more led every demoDelayTime3
+		{5 * demoDelayTime3,                       6,  ANIM_STEP},              // S11 on, yellow, then red
+		{9 * demoDelayTime3,                       7,  ANIM_LINEAR},
+		{37 * demoDelayTime3,                      35, ANIM_STEP},
+		{38 * demoDelayTime3 + demoDelayTime4,     0,  ANIM_STEP}};
+	static const ANIM_KEY demo_sw11_keys[] = {                                  // S11 led red
+		{0,                                        0,  ANIM_STEP},
+		{8 * demoDelayTime3,                       1,  ANIM_STEP},
+		{38 * demoDelayTime3 + demoDelayTime4,     0,  ANIM_STEP}};
+	static const ANIM_KEY demo_rpm_keys[] = DEMO_DIAL_KEYS(rpm_max - 1);
+	static const ANIM_KEY demo_fuel_keys[] = DEMO_DIAL_KEYS(fuel_max - 1);
+	static const ANIM_KEY demo_sp_keys[] = DEMO_DIAL_KEYS(sp_max - 1);
+	static const ANIM_KEY demo_mode_keys[] = {                                  // 1 = dot mode, 0 = led bar mode
+		{0,                                          1,   ANIM_STEP},
+		{2*demoSweepTime + 2*demoDelayTime5,         0,   ANIM_STEP}};
+
+	ANIM demo_anim[DEMO_CNT];
+	ANIM_TRACK demo_seg_track[1];
+	ANIM_TRACK demo_sw_track[2];
+	ANIM_TRACK demo_dial_track[4];      // rpm, fuel, sp, dot mode
+	unsigned char demo_step = 0;        // running animation, DEMO_CNT when the demonstration is over
+	anim_trackInit(&demo_seg_track[0], demo_seg_keys, sizeof(demo_seg_keys) / sizeof(ANIM_KEY));
+	anim_trackInit(&demo_sw_track[0], demo_sw_keys, sizeof(demo_sw_keys) / sizeof(ANIM_KEY));
+	anim_trackInit(&demo_sw_track[1], demo_sw11_keys, sizeof(demo_sw11_keys) / sizeof(ANIM_KEY));
+	anim_trackInit(&demo_dial_track[0], demo_rpm_keys, sizeof(demo_rpm_keys) / sizeof(ANIM_KEY));
+	anim_trackInit(&demo_dial_track[1], demo_fuel_keys, sizeof(demo_fuel_keys) / sizeof(ANIM_KEY));
+	anim_trackInit(&demo_dial_track[2], demo_sp_keys, sizeof(demo_sp_keys) / sizeof(ANIM_KEY));
+	anim_trackInit(&demo_dial_track[3], demo_mode_keys, sizeof(demo_mode_keys) / sizeof(ANIM_KEY));
+	anim_init(&demo_anim[DEMO_SEGS], demo_seg_track, 1);
+	anim_init(&demo_anim[DEMO_SWITCHES], demo_sw_track, 2);
+	anim_init(&demo_anim[DEMO_DIALS], demo_dial_track, 4);
 
 	// Order of switch led illumination during demo
 	unsigned char demoButtons[35] = {4, 3, 2, 1, 10, 11, 12, 13, 8, 7, 6, 5, 9, 14, 15, 16, 17, 18, 19, 34, 33, 32, 31, 27, 28, 29, 30, 26, 20, 21, 22, 23, 24, 25, 35};
@@ -200,52 +274,71 @@ int main() {
 
 	unsigned char lights_status[6] = {0};   // Keeps track of the state of the switch leds, index = CAN_Bus data byte 3  , index 0 not used
 
+	// UART telemetry stream
+	TELEM_PARSER telem_parser;              // incremental frame parser state
+	TELEM_DATA telem = {0};                 // latest decoded telemetry frame
+	TELEM_DATA telem_old = {0};             // telemetry frame applied to the dials & leds
+	bool telem_new = false;                 // a telemetry frame was decoded and not yet applied
+	unsigned char dial_want[3] = {0xFF, 0xFF, 0xFF};   // RPM/fuel/speed dial values of the telemetry stream
+	unsigned char dial_sent[3] = {0xFF, 0xFF, 0xFF};   // last RPM/fuel/speed dial values sent over CAN-Bus by the telemetry stream
+	unsigned char lamps_pending = 0;        // bit n set: CAN-Bus indication group n changed by the telemetry stream, not yet sent
+	unsigned char telem_can_slot = 0;       // next message to check, dials & indication groups in turn
+	u32 telem_can_ms = 0;                   // millis value of the last telemetry CAN-Bus message
+	unsigned char rx_data[32];              // UART bytes taken from the receive buffer per pass
+	int rx_cnt;
+	telem_init(&telem_parser);
+
+	// ISO-TP diagnostic link to the Instrument Panel Cluster
+	ISOTP_LINK ipc_link;
+	unsigned char ipc_rx_buf[256];          // received ISO-TP payload
+	static const u8 ipc_vin_req[] = {0x1A, 0x90};   // GMLAN ReadDataByIdentifier ($1A) of the VIN ($90), multi-frame response
+	CAN_FRAME frame_rx;
+	u32 can_poll_ms = 0;                    // millis value of the last CAN-Bus receive poll
+	u16 ipc_rx_len;
+	initMCP2515(&can_ipc, &SpiInstance, MCP2515_CS_IPC, MCP2515_OSC_20MHZ, MCP2515_BITRATE_SWCAN);
+	setTxGapCan(&can_ipc, IPC_TX_GAP);
+	isotp_init(&ipc_link, &can_ipc, ISOTP_IPC_TX_ID, ISOTP_IPC_RX_ID, ipc_rx_buf, sizeof(ipc_rx_buf));
+
 	// MCP23S17 Reset and Initialization
 	mcp_reset();
 	initMCP23S17();
+	ports = mcp_scanPorts();		// initial port state, the read also clears any pending interrupt
+	debounce_init(SW_PORT_MASK, ports, DEBOUNCE_STABLE_MS);
+	sw_decode(&switches, ports);	// initial switch state, no presses
+	enc_states(ports, enc);
+	for (unsigned char enc_num = 1; enc_num < 4; enc_num++){
+		enc_init(enc_num - 1, enc[enc_num], millis);
+	}
 
 	// MAX7221 Reset and Initialization
-	initMAX7221(MAX_1);
-	initMAX7221(MAX_2);
-	initMAX7221(MAX_3);
+	initAllMAX7221();		// all three MAX7221s, one transfer per command
+	display_init(DISPLAY_FPS_DEFAULT);	// refreshed from the main loop at a fixed frame rate
+	set_alarm_layer();					// drawn once, shown while the Emergency Lights are on
 	usleep(300000);	// delay 300 msec
 
 
-	// set the intensity of the leds (range: 1 to 15)
-	setIntensity(MAX_1, 8); // Intensity ranges from 1 to 15
-	setIntensity(MAX_2, 8); // Intensity ranges from 1 to 15
-	setIntensity(MAX_3, 8); // Intensity ranges from 1 to 15
-	usleep(300000);	// delay 300 msec
-
-
-
-  // Demonstration
-	demo_segs(demoSeg, rfs);  // 7-seg snake demonstration
-	demo_switch_leds(led_sw, demoButtons, led_rpm, led_fuel, led_sp, &led_sw11_color, mx, &info_led); // switch leds demonstration
+	// set the intensity of the leds: fade in from the lowest intensity to register value 8 (range: 0 to 15),
+	// dim when idle. Runs from the main loop.
+	fade_init(0);
+	fade_to(FADE_ALL, FADE_LEVEL_NORMAL, FADE_IN_TIME);
+	fade_setIdle(IDLE_DIM_TIME, FADE_LEVEL_DIM, FADE_LEVEL_NORMAL);
 
-	// define which digits use the internal segments decoder
-	setDecode(MAX_1, 0xF0);
-	setDecode(MAX_2, 0xF0);
-	setDecode(MAX_3, 0xF0);
 
-	// Demonstration
-	demo_dial_leds(demo, led_sw, &led_sw11_color, mx, &info_led); // dial leds demonstration
 
-	stopTimer2();		// Stop Timer 2 interrupts (every 1 msec), needed only for demo_dial_leds()
-
-	// Display initial switch leds and dial leds
-	calc_rpm_leds(&rpm, mode, led_rpm);
-	calc_fuel_leds(&fuel, mode, led_fuel);
-	calc_sp_leds(&sp, mode, led_sp);
-	fill_led_table(led_rpm, led_fuel, led_sp, led_sw, &led_sw11_color, mx);
-	show_leds(mx, &info_led);
+	// Timer 2 (every 1 msec) keeps running, it also moves UART telemetry bytes to the receive buffer
+	// and paces the demonstration animations
 
 
 	// MCP2515 Reset and Initialization
-	resetMCP2515();
-	setBitrateCan();				// Set Configuration
-	setNormalModeCan();			// Set Normal mode (not Sleep/Loopback/Listen-Only/Configuration mode)
-	RegularOperationMode();	// Set Regular mode (not One-Shot mode)
+	resetMCP2515(&can_ipc);
+	setBitrateCan(&can_ipc);			// Set Configuration (33333bps for 20 MHz MCP2515 clock)
+	setReceiveAnyCan(&can_ipc);			// Receive all messages in both receive buffers
+	setNormalModeCan(&can_ipc);			// Set Normal mode (not Sleep/Loopback/Listen-Only/Configuration mode)
+	RegularOperationMode(&can_ipc);	// Set Regular mode (not One-Shot mode)
+
+	// Demonstration: runs from the main loop, inputs and CAN-Bus are served meanwhile.
+	// Switch and dial leds are shown once it is over.
+	anim_start(&demo_anim[DEMO_SEGS], millis);
 
 
 	// Main application loop
@@ -255,213 +348,237 @@ int main() {
 			if (wake == true){                  // flag wake is true every 1 second
 				if (sw25_on == 1){                // switch S25 pressed in previous session
 					sw25_on = 0;
-					led_sw[25] = 0;                 // auto turn off switch led S25
+					LED_CLR(led_sw, 25);                 // auto turn off switch led S25
 				}
 				cnt += 1;                         // Increase 2-second flag counter
 				info_led = 0xF0;                  // Reset all 4 info leds to off state
 				CAN_FRAME frame_wake;             // Send out the GMLAN wake-up message on whichever mailbox is free or queue it for sending when there is an opening. CAN-Bus Wake up message
-				frame_wake.id = 0x632;            // or queue it for sending when there is an opening
-				frame_wake.length = 8;
-				frame_wake.data.low  = 0x00504800;
-				frame_wake.data.high = 0x00000000;
-				sendCANMessage(&frame_wake);
+				gmlan_wakeup(&frame_wake);        // or queue it for sending when there is an opening
+				queueCANMessage(&can_ipc, &frame_wake);
 				wake = false;
 			}
-		}
-
-		// A switch pressed(/released) or a rotary enc rotated, or 4 secs passed (cnt is 4)
-		flg = false;                          // Reset key-pressed flag
 
-		// Query the ports A & B status, for IC1, IC2 & IC3
-		port_1A = mcp_getPort(MAX_1, 'A'); // query the complete port status
-		port_1B = mcp_getPort(MAX_1, 'B'); // query the complete port status
-		port_2A = mcp_getPort(MAX_2, 'A'); // query the complete port status
-		port_2B = mcp_getPort(MAX_2, 'B'); // query the complete port status
-		port_3A = mcp_getPort(MAX_3, 'A'); // query the complete port status
-		port_3B = mcp_getPort(MAX_3, 'B'); // query the (complete) port status [only (3:0)]
-
-		// Calculate switch & rotary enc states
-		sw[1] = port_1A & 0x01;   // IC1 Port A_0
-		sw[2] = port_1A & 0x02;   // IC1 Port A_1
-		sw[3] = port_1A & 0x04;   // IC1 Port A_2
-		sw[4] = port_1A & 0x08;   // IC1 Port A_3
-		sw[5] = port_1A & 0x10;   // IC1 Port A_4
-		sw[6] = port_1A & 0x20;   // IC1 Port A_5
-		sw[7] = port_1A & 0x40;   // IC1 Port A_6
-		sw[8] = port_1A & 0x80;   // IC1 Port A_7
-
-		sw[9] = port_1B & 0x01;  // IC1 Port B_0
-		sw[10] = port_1B & 0x10;  // IC1 Port B_4
-		sw[11] = port_1B & 0x20;  // IC1 Port B_5
-		sw[12] = port_1B & 0x40;  // IC1 Port B_6
-		sw[13] = port_1B & 0x80;  // IC1 Port B_7
-
-		sw[14] = port_2A & 0x01;  // IC2 Port A_0
-		sw[15] = port_2A & 0x02;  // IC2 Port A_1
-		sw[16] = port_2A & 0x04;  // IC2 Port A_2
-		sw[17] = port_2A & 0x40;  // IC2 Port A_6
-		sw[18] = port_2A & 0x80;  // IC2 Port A_7
-
-		sw[19] = port_2B & 0x01;  // IC2 Port B_0
-		sw[20] = port_2B & 0x02;  // IC2 Port B_1
-		sw[21] = port_2B & 0x04;  // IC2 Port B_2
-		sw[22] = port_2B & 0x08;  // IC2 Port B_3
-		sw[23] = port_2B & 0x10;  // IC2 Port B_4
-		sw[24] = port_2B & 0x20;  // IC2 Port B_5
-		sw[25] = port_2B & 0x40;  // IC2 Port B_6
-
-		sw[26] = port_3A & 0x08;  // IC3 Port A_3
-		sw[27] = port_3A & 0x10;  // IC3 Port A_4
-		sw[28] = port_3A & 0x20;  // IC3 Port A_5
-		sw[29] = port_3A & 0x40;  // IC3 Port A_6
-		sw[30] = port_3A & 0x80;  // IC3 Port A_7
-
-		sw[31] = port_3B & 0x01;  // IC3 Port B_0
-		sw[32] = port_3B & 0x02;  // IC3 Port B_1
-		sw[33] = port_3B & 0x04;  // IC3 Port B_2
-		sw[34] = port_3B & 0x08;  // IC3 Port B_3
-
-		sw[35] = port_2B & 0x80;  // IC2 Port B_7
-
-		enc_sw[1] = port_1B & 0x08; // IC1 Port B_3
-		enc_sw[2] = port_2A & 0x20; // IC2 Port A_5
-		enc_sw[3] = port_3A & 0x04; // IC3 Port A_2
-
-		enc[1] = (port_1B & 0x06) >> 1; // IC1 Port B_2,1
-		enc[2] = (port_2A & 0x18) >> 3; // IC2 Port A_4,3
-		enc[3] =  port_3A & 0x03;       // IC3 Port A_1,0
-
-		// Any rotary enc moved
-		if (enc[1] || enc[2] || enc[3] || rotary_move[0]){
-			info_led = info_led & 0xD0;   // clear bit 5 (R.Encoder)
-			if (enc[1] || enc[2] || enc[3]){      // Set rotary_move(1, 2 or 3] if corresponding enc[] is set, but not clear it when corresponding enc[] is clear
-				rotary_move[1] = enc[1];
-				rotary_move[2] = enc[2];
-				rotary_move[3] = enc[3];
+			display_task();                     // send the latest display frame, once per frame period
+			fade_task();                        // intensity fading step, one chain transfer at most
+			// Switch sample period: read GPIO A & B of all ICs, INTF and INTCAP are left to the capture
+			// of the input pass. A GPIO read also ends a pending interrupt, so no sample is taken once
+			// an interrupt has woken the main loop.
+			// The sample is also the fallback for a lost INT edge (edge-sensitive interrupt, one INT line
+			// shared by the 3 ICs): it releases an INT left asserted and finds the change itself.
+			// Worst-case input to decode latency: one sample period (DEBOUNCE_STABLE_MS / DEBOUNCE_SAMPLES)
+			// plus one main loop pass.
+			if (debounce_due() && (flg == false)){
+				ports_old = ports;
+				ports = mcp_scanPorts();
+				if ((ports ^ ports_old) & (SW_PORT_MASK | ENC_PORT_MASK)){   // no interrupt came for this change
+					mcp_edge_lost++;
+					xil_printf("MCP23S17 input change without INT edge, %d so far\r\n", mcp_edge_lost);
+				}
+				if ((ports ^ ports_old) & ENC_PORT_MASK){   // a Rotary Enc moved: step it in an input pass
+					flg = true;
+				}
+				if (debounce_task(ports)){        // a switch press / release held for the stable time
+					flg = true;
+				}
+			}
+			if ((mcp_restored = mcp_checkTask()) != 0){   // background MCP23S17 configuration check, one IC per period
+				xil_printf("MCP23S17 IC %d configuration restored\r\n", mcp_restored);
+				if (mcp_restored <= MAX_CNT){
+					seg7_print(mcp_restored - 1, errMCP);   // " Err" on the 7-seg display of the same number, until its next value
+					display_swap();
+				}
 			}
 
-			// Template CAN-Bus "dials" message
-			CAN_FRAME frame_rotary;
-			frame_rotary.id = 0x255;
-			frame_rotary.length = 8;
-			frame_rotary.data.low  = 0x0100AE04;
-			frame_rotary.data.high = 0x00000000;
-
-			// Rotary Encoders 1,2 & 3 states
-			for (int enc_num=1; enc_num<4; enc_num++){
-				oldState[enc_num] = thisState[enc_num];
-				thisState[enc_num] = enc[enc_num];
-				ind = thisState[enc_num] | (oldState[enc_num] << 2);
-				knobPosition[enc_num] += KNOBDIR[ind];
-				if (knobPosition[enc_num] == 4){    // This rotary encoder completed 4 states (1 click) CW
-					knobPosition[enc_num] = 0;
-					rotary_move[enc_num] = 0; // Clear rotary_move(1, 2 or 3) if corresponding thisState[] = 0 and oldState[] was not 0 . Sequence of 4 states is complete, for this rotary encoder click
-					switch (enc_num){
-					case 1:
-						if (rpm<16){          // Increase RPM leds
-							rpm += 1;
-							calc_rpm_leds(&rpm, mode, led_rpm);
-							show_num_rpm((unsigned int)(rpm) * 500, &info_led);
-							frame_rotary.data.byte[2] = 0x09;
-							frame_rotary.data.byte[4] = rpm_dial[rpm];
-							sendCANMessage(&frame_rotary);
+			// CAN-Bus receive and ISO-TP transfers, once per msec, one frame sent per pass
+			if (millis != can_poll_ms){
+				can_poll_ms = millis;
+				serviceCANQueue(&can_ipc, can_poll_ms);
+				while (receiveCANMessage(&can_ipc, &frame_rx))
+					isotp_onFrame(&ipc_link, &frame_rx, can_poll_ms);
+				isotp_poll(&ipc_link, can_poll_ms);
+				if ((ipc_rx_len = isotp_received(&ipc_link)) > 0)
+					xil_printf("IPC ISO-TP response, %d bytes\r\n", ipc_rx_len);
+
+				// Telemetry dials & indications, one queued message per TELEM_CAN_PERIOD
+				if ((can_poll_ms - telem_can_ms) >= TELEM_CAN_PERIOD){
+					if (send_telemetry_can(dial_want, dial_sent, &lamps_pending, lights_status, &telem_can_slot))
+						telem_can_ms = can_poll_ms;
+				}
+
+				// Demonstration animations, the displays are redrawn only when a track changed
+				if (demo_step < DEMO_CNT){
+					if (anim_update(&demo_anim[demo_step], can_poll_ms)){
+						switch (demo_step){
+						case DEMO_SEGS:
+							demo_segs(demo_seg_track[0].value, demoSeg, demoText, demo_marquee, can_poll_ms);
+							break;
+						case DEMO_SWITCHES:
+							demo_switch_leds(demo_sw_track[0].value, demo_sw_track[1].value, demoButtons, &leds, mx, &info_led);
+							break;
+						default:
+							demo_dial_leds(demo_dial_track[0].value, demo_dial_track[1].value, demo_dial_track[2].value, demo_dial_track[3].value, led_sw, &led_sw11_color, mx, &info_led);
+							break;
 						}
-						break;
-					case 2:
-						if (fuel<8){          // Increase fuel leds
-							fuel += 1;
-							calc_fuel_leds(&fuel, mode, led_fuel);
-							show_num_fuel((unsigned int)(fuel) * 6, &info_led);
-							frame_rotary.data.byte[2] = 0x0A;
-							frame_rotary.data.byte[4] = fuel_dial[fuel];
-							sendCANMessage(&frame_rotary);
+					}
+					if (demo_step == DEMO_SEGS){    // text scrolls in, one digit per demoScrollTime
+						bool scrolled = false;
+						for (unsigned char icNumber=0; icNumber<3; icNumber++){
+							scrolled |= seg7_marqueeStep(&demo_marquee[icNumber], can_poll_ms);
 						}
-						break;
-					default:
-						if (sp<24){          // Increase speed leds
-							sp += 1;
-							calc_sp_leds(&sp, mode, led_sp);
-							show_num_sp((unsigned int)(sp) * 10, &info_led);
-							frame_rotary.data.byte[2] = 0x08;
-							frame_rotary.data.byte[4] = sp_dial[sp];
-							sendCANMessage(&frame_rotary);
+						if (scrolled){
+							display_swap();
 						}
-						break;
 					}
-				}
-
-				if (knobPosition[enc_num] == -4){    // This rotary encoder completed 4 states (1 click) CCW
-					knobPosition[enc_num] = 0;
-					rotary_move[enc_num] = 0;
-					switch (enc_num){
-					case 1:
-						if (rpm>0){          // Decrease RPM leds
-							rpm -= 1;
-							calc_rpm_leds(&rpm, mode, led_rpm);
-							show_num_rpm((unsigned int)(rpm) * 500, &info_led);
-							frame_rotary.data.byte[2] = 0x09;
-							frame_rotary.data.byte[4] = rpm_dial[rpm];
-							sendCANMessage(&frame_rotary);
+					if (demo_anim[demo_step].state == ANIM_DONE){
+						demo_step++;
+						if (demo_step < DEMO_CNT){
+							anim_start(&demo_anim[demo_step], can_poll_ms);
 						}
-						break;
-					case 2:
-						if (fuel>0){          // Decrease fuel leds
-							fuel -= 1;
+						else{                         // Display initial switch leds and dial leds
+							if (isotp_send(&ipc_link, ipc_vin_req, sizeof(ipc_vin_req), can_poll_ms) != XST_SUCCESS){
+								xil_printf("IPC ISO-TP request not sent\r\n");
+							}
+							calc_rpm_leds(&rpm, mode, led_rpm);
 							calc_fuel_leds(&fuel, mode, led_fuel);
-							show_num_fuel((unsigned int)(fuel) * 6, &info_led);
-							frame_rotary.data.byte[2] = 0x0A;
-							frame_rotary.data.byte[4] = fuel_dial[fuel];
-							sendCANMessage(&frame_rotary);
-						}
-						break;
-					default:
-						if (sp>0){          // Decrease speed leds
-							sp -= 1;
 							calc_sp_leds(&sp, mode, led_sp);
+							show_num_rpm((unsigned int)(rpm) * 500, &info_led);
+							show_num_fuel((unsigned int)(fuel) * 6, &info_led);
 							show_num_sp((unsigned int)(sp) * 10, &info_led);
-							frame_rotary.data.byte[2] = 0x08;
-							frame_rotary.data.byte[4] = sp_dial[sp];
-							sendCANMessage(&frame_rotary);
+							if (fill_led_table(&leds, led_sw11_color, mx)){
+								show_leds(mx, &info_led);
+							}
 						}
-						break;
 					}
 				}
-				rotary_move[0] = rotary_move[1] | rotary_move[2] | rotary_move[3];
-			}   // end "Rotary Encoders 1,2 & 3 states"
-		}     // end "Any rotary enc moved"
+			}
+
+			// Telemetry stream: decode everything received so far, then apply only the latest frame
+			while ((rx_cnt = uart_recv(rx_data, sizeof(rx_data))) > 0){
+				for (int i = 0; i < rx_cnt; i++){
+					if (telem_parseByte(&telem_parser, rx_data[i], &telem))
+						telem_new = true;
+				}
+			}
+			if (telem_new){
+				telem_new = false;
+				bool dials_changed = apply_telemetry(&telem, &telem_old, dial_want, &rpm, &fuel, &sp, mode, led_rpm, led_fuel, led_sp, rpm_dial, fuel_dial, sp_dial, &info_led);
+				unsigned char groups_changed = apply_telemetry_flags(&telem, &telem_old, led_sw, led_sw_old, lights, lights_status, &info_led);
+				lamps_pending |= groups_changed;
+				if ((dials_changed || (groups_changed != 0)) && (demo_step == DEMO_CNT)){
+					mcp_setPortMasked(2, 'B', INFO_LED_MASK, info_led);   // sent only if the info leds changed
+					if (fill_led_table(&leds, led_sw11_color, mx)){
+						show_leds(mx, &info_led);
+					}
+				}
+				telem_old = telem;
+			}
+		}
 
-		// Template CAN-Bus "dials" message
+		// A switch pressed(/released) or a rotary enc rotated, or 4 secs passed (cnt is 4)
+		flg = false;                          // Reset key-pressed flag
+
+		// Interrupt events since the previous pass: the first MCP23S17 one is when the INTCAP state was
+		// latched. The later ones have no port state of their own (see evq.h), they are only drained.
+		mcp_int_ms = millis;
+		for (bool first = true; evq_pop(&input_event); ){
+			if ((input_event.source == EVQ_SRC_MCP) && first){
+				mcp_int_ms = input_event.time;
+				first = false;
+			}
+		}
+
+		// Capture the ports A & B of the ICs that fired (INTF): the state latched at the interrupt (INTCAP)
+		// and the live state (GPIO). The other ICs are not read, they keep their previous state.
+		ports_old = ports;
+		mcp_captureAll(ports_old, &ports_cap, &ports);
+		// Switches & Rotary Enc switches from the debounced snapshot, remapped to logical order.
+		// Presses and releases are the debounce events since the previous pass, so a switch pressed
+		// and released again meanwhile still counts.
+		sw_decode(&switches, debounce_state());
+		switches.pressed = sw_gather(debounce_pressed());
+		switches.released = sw_gather(debounce_released());
+		switches.changed = switches.pressed | switches.released;
+
+		// Rotary encs: the state latched at the interrupt (at the interrupt time) first, then the live state
+		// if it moved on since, so a step made before the ports were read is not lost
+		enc_step[0] = ports_cap;
+		enc_step[1] = ports;
+		enc_steps = (ports != ports_cap) ? 2 : 1;
+		for (unsigned char step = 0; step < enc_steps; step++){
+			enc_states(enc_step[step], enc);
+			for (unsigned char enc_num = 1; enc_num < 4; enc_num++){
+				if (enc_edge(enc_num - 1, enc[enc_num], (step == 0) ? mcp_int_ms : millis)){
+					info_led = info_led & 0xD0;   // clear bit 5 (R.Encoder)
+				}
+			}
+		}
+
+		// While a Rotary Enc is between detents (a click not completed) the switch and Rotary Enc switch
+		// presses are held, and taken once the click completes (its last edge wakes the main loop)
+		sw_held |= switches.pressed;
+		if (enc_moving()){
+			info_led = info_led & 0xD0;         // clear bit 5 (R.Encoder)
+			switches.pressed = 0;
+		}
+		else{
+			switches.pressed = sw_held;
+			sw_held = 0;
+		}
+
+		// Dials: the accelerated steps of each Rotary Enc since the previous pass, one CAN-Bus "dials" message per dial
+		CAN_FRAME frame_rotary;
+		if (dial_step(&rpm, enc_delta(0), rpm_max - 1)){          // RPM leds
+			calc_rpm_leds(&rpm, mode, led_rpm);
+			show_num_rpm((unsigned int)(rpm) * 500, &info_led);
+			gmlan_ipcDial(&frame_rotary, GMLAN_DC_CPID_RPM, rpm_dial[rpm]);
+			queueCANMessage(&can_ipc, &frame_rotary);
+		}
+		if (dial_step(&fuel, enc_delta(1), fuel_max - 1)){        // fuel leds
+			calc_fuel_leds(&fuel, mode, led_fuel);
+			show_num_fuel((unsigned int)(fuel) * 6, &info_led);
+			gmlan_ipcDial(&frame_rotary, GMLAN_DC_CPID_FUEL, fuel_dial[fuel]);
+			queueCANMessage(&can_ipc, &frame_rotary);
+		}
+		if (dial_step(&sp, enc_delta(2), sp_max - 1)){            // speed leds
+			calc_sp_leds(&sp, mode, led_sp);
+			show_num_sp((unsigned int)(sp) * 10, &info_led);
+			gmlan_ipcDial(&frame_rotary, GMLAN_DC_CPID_SPEED, sp_dial[sp]);
+			queueCANMessage(&can_ipc, &frame_rotary);
+		}
+
+		// CAN-Bus "indications" message
 		CAN_FRAME frame_switch;
-		frame_switch.id = 0x255;
-		frame_switch.length = 8;
-		frame_switch.data.low  = 0x0000AE04;
-		frame_switch.data.high = 0x00000000;
 
-		// Update switch actions
-		for (int sw_i = 1; sw_i<36; sw_i++){
+		// Update switch actions, only for the pressed switches and the switch leds changed meanwhile
+		// (telemetry), lowest switch first
+		led_diff = (led_sw[LED_W_SW0] ^ led_sw_old[LED_W_SW0]) | ((u64)(led_sw[LED_W_SW1] ^ led_sw_old[LED_W_SW1]) << 32);
+		sw_todo = ((switches.pressed | led_diff) & SW_ALL);
+		while (sw_todo){
+			sw_i = __builtin_ctzll(sw_todo);
+			sw_todo &= sw_todo - 1;             // clear the lowest set bit
 			// Update switch leds
 			if (sw_i == 11){
-				if (sw[11]){              // Switch S11 pressed,
+				if (SW_BIT(switches.pressed, 11)){   // Switch S11 pressed,
 					led_sw11_changed = 1;   // loop through Off -> Yellow -> Red -> Off
-					if (led_sw[11]){
+					if (LED_GET(led_sw, 11)){
 						if (led_sw11_color){
 							led_sw11_color = 0;
-							led_sw[11] = 0;
+							LED_CLR(led_sw, 11);
 						}
 						else{
 							led_sw11_color = 1;
 						}
 					}
 					else{
-						led_sw[11] = 1;
+						LED_SET(led_sw, 11);
 					}
 				}
 			}
 			else {                                    // sw_i not equals 11
-				led_sw[sw_i] = led_sw[sw_i] ^ sw[sw_i]; // change led_sw state
+				LED_PUT(led_sw, sw_i, LED_GET(led_sw, sw_i) ^ SW_BIT(switches.pressed, sw_i)); // change led_sw state
 			}
 
-			if ((led_sw[sw_i] ^ led_sw_old[sw_i]) && (sw_i != 11)) {     // Switch led (other than S11) changed
+			if ((LED_GET(led_sw, sw_i) ^ LED_GET(led_sw_old, sw_i)) && (sw_i != 11)) {     // Switch led (other than S11) changed
 				info_led = info_led & 0xB0;   // clear bit 6 (Switch)
 				cnt = 0;
 
@@ -469,98 +586,69 @@ int main() {
 				switch (sw_i) {
 				case 22: {            // Odometer LCD Test
 					CAN_FRAME frame_odo;
-					frame_odo.id = 0x255;        // OFF to Odometer LCD Test
-					frame_odo.length = 8;
-					frame_odo.data.low  = 0x010DAE04;
-					frame_odo.data.high = 0x00000001;
-
-					if (led_sw[22]){    // ON
-						frame_odo.data.byte[3] = 0x01;
-						frame_odo.data.byte[4] = 0x01;
-					}
-					else{               // OFF
-						frame_odo.data.byte[3] = 0x00;
-						frame_odo.data.byte[4] = 0x00;
-					}
-					sendCANMessage(&frame_odo);
+					gmlan_ipcOdoTest(&frame_odo, LED_GET(led_sw, 22));   // ON / OFF to Odometer LCD Test
+					queueCANMessage(&can_ipc, &frame_odo);
 					break;}
 				case 24:              // Emergency Lights
-					frame_switch.id = 0x260;
-					frame_switch.length = 3;
-					if (led_sw[24]){    // ON
+					if (LED_GET(led_sw, 24)){    // ON
 						clear_switch_leds(led_sw, led_sw_old, lights_status, &info_led);
 						clear_dials(&rpm, &fuel, &sp, mode, led_rpm, led_fuel, led_sp, &info_led);
 						CAN_FRAME frame_odo;
-						frame_odo.id = 0x255;        // turn off "Odometer LCD Test"
-						frame_odo.length = 8;
-						frame_odo.data.low  = 0x000DAE04;
-						frame_odo.data.high = 0x00000000;
-						sendCANMessage(&frame_odo);
-						usleep(30000);
-
-						frame_switch.data.low  = 0x0080327F;
-						frame_switch.data.high = 0x00000000;
+						gmlan_ipcOdoTest(&frame_odo, false);   // turn off "Odometer LCD Test"
+						queueCANMessage(&can_ipc, &frame_odo);
+
+						gmlan_hazard(&frame_switch, true);
+						fade_pulse(FADE_ALL, FADE_LEVEL_DIM, FADE_LEVEL_MAX, ALARM_PULSE);   // alarm: leds pulse
+						display_layerShow(DISPLAY_LAYER_ALARM, DISPLAY_FOREVER, 2*ALARM_PULSE);   // and 7-seg led displays blink
 					}
 					else{               // OFF
-						frame_switch.data.low  = 0x00000000;
-						frame_switch.data.high = 0x00000000;
+						gmlan_hazard(&frame_switch, false);
+						fade_stop(FADE_ALL, FADE_LEVEL_NORMAL, FADE_IDLE_WAKE_MS);
+						display_layerHide(DISPLAY_LAYER_ALARM);
 					}
-					sendCANMessage(&frame_switch);
+					queueCANMessage(&can_ipc, &frame_switch);
 					break;
 				case 25:              // Beep Sound (auto switch led to off)
-					if (led_sw[25]){
-						if (led_sw[22]){
+					if (LED_GET(led_sw, 25)){
+						if (LED_GET(led_sw, 22)){
 							CAN_FRAME frame_odo;
-							frame_odo.id = 0x255;        // turn off "Odometer LCD Test"
-							frame_odo.length = 8;
-							frame_odo.data.low  = 0x000DAE04;
-							frame_odo.data.high = 0x00000000;
-							sendCANMessage(&frame_odo);
-							usleep(30000);
+							gmlan_ipcOdoTest(&frame_odo, false);   // turn off "Odometer LCD Test"
+							queueCANMessage(&can_ipc, &frame_odo);
 						}
 
 						clear_switch_leds(led_sw, led_sw_old, lights_status, &info_led);
 						clear_dials(&rpm, &fuel, &sp, mode, led_rpm, led_fuel, led_sp, &info_led);
 						sw25_on = 1;
 
-						frame_switch.id = 0x281;  // ON to Beep
-						frame_switch.length = 5;
-						frame_switch.data.low  = 0x021E0560;
-						frame_switch.data.high = 0x00000033;
-						sendCANMessage(&frame_switch);
+						gmlan_chimeBeep(&frame_switch);   // ON to Beep
+						queueCANMessage(&can_ipc, &frame_switch);
 					}
 					break;
-				case 35:              // All switch leds ON test (2 seconds)
-					if (led_sw[35]){
+				case 35:              // All switch leds ON test (LAMP_TEST_TIME, lamp test layer)
+					if (LED_GET(led_sw, 35)){
 						for (unsigned char i=1; i<36; i++){
-							led_sw[i] = 1;
+							LED_SET(led_sw, i);
 						}
-						if (led_sw[22]){
+						if (LED_GET(led_sw, 22)){
 							CAN_FRAME frame_odo;
-							frame_odo.id = 0x255;        // turn off "Odometer LCD Test"
-							frame_odo.length = 8;
-							frame_odo.data.low  = 0x000DAE04;
-							frame_odo.data.high = 0x00000000;
-							sendCANMessage(&frame_odo);
-							usleep(30000);
+							gmlan_ipcOdoTest(&frame_odo, false);   // turn off "Odometer LCD Test"
+							queueCANMessage(&can_ipc, &frame_odo);
 						}
 
-						if (led_sw[24]){
-							frame_switch.id = 0x260;    // turn off "Emergency Lights"
-							frame_switch.length = 3;
-							frame_switch.data.low  = 0x00000000;
-							frame_switch.data.high = 0x00000000;
-							sendCANMessage(&frame_switch);
+						if (LED_GET(led_sw, 24)){
+							gmlan_hazard(&frame_switch, false);   // turn off "Emergency Lights"
+							queueCANMessage(&can_ipc, &frame_switch);
+							fade_stop(FADE_ALL, FADE_LEVEL_NORMAL, FADE_IDLE_WAKE_MS);
+							display_layerHide(DISPLAY_LAYER_ALARM);
 						}
 
-						set_led_table(mx);
-						show_leds(mx, &info_led);
+						set_led_table(mx_test);
 						set_num_all(&info_led);
+						show_lamp_test(mx_test, &info_led);   // over the display for LAMP_TEST_TIME, the leds below are cleared meanwhile
 
-						sleep(2);
 						for (unsigned char i=1; i<36; i++){
-							led_sw[i] = 0;
-							led_sw_old[i] = 0;
+							LED_CLR(led_sw, i);
+							LED_CLR(led_sw_old, i);
 						}
 
 						clear_switch_leds(led_sw, led_sw_old, lights_status, &info_led);
@@ -570,10 +658,8 @@ int main() {
 				default:      // Update switch leds status to Instrument Panel Cluster
 					lights_status[lights[sw_i][0]] = lights_status[lights[sw_i][0]] ^ (0x01 << lights[sw_i][1]);
 
-					frame_switch.data.byte[2] = lights[sw_i][0];
-					frame_switch.data.byte[3] = lights_status[lights[sw_i][0]];
-					frame_switch.data.byte[4] = lights_status[lights[sw_i][0]];
-					sendCANMessage(&frame_switch);
+					gmlan_ipcLamps(&frame_switch, lights[sw_i][0], lights_status[lights[sw_i][0]]);
+					queueCANMessage(&can_ipc, &frame_switch);
 					break;
 				}
 
@@ -584,7 +670,7 @@ int main() {
 				led_sw11_changed = 0;
 
 				// Update switch led status for S11 to Instrument Panel Cluster
-				if (led_sw[11]){
+				if (LED_GET(led_sw, 11)){
 					if (led_sw11_color){
 						lights_status[lights[sw_i][0]] = lights_status[lights[sw_i][0]] | 0x10;
 						lights_status[lights[sw_i][0]] = lights_status[lights[sw_i][0]] & 0xF7;
@@ -598,69 +684,61 @@ int main() {
 					lights_status[lights[sw_i][0]] = lights_status[lights[sw_i][0]] & 0xE7;
 				}
 
-				frame_switch.data.byte[2] = lights[sw_i][0];
-				frame_switch.data.byte[3] = lights_status[lights[sw_i][0]];
-				frame_switch.data.byte[4] = lights_status[lights[sw_i][0]];
-				sendCANMessage(&frame_switch);
-			}
-			else if (cnt > 3){                            // no switch led changed and 4 seconds passed:
-				frame_switch.data.byte[2] = lights[1][0];   // switch led status to IPC must be updated every 4 seconds
-				frame_switch.data.byte[3] = lights_status[lights[1][0]];
-				frame_switch.data.byte[4] = lights_status[lights[1][0]];
-				sendCANMessage(&frame_switch);
-				usleep(30000);
-
-				frame_switch.data.byte[2] = lights[2][0];
-				frame_switch.data.byte[3] = lights_status[lights[2][0]];
-				frame_switch.data.byte[4] = lights_status[lights[2][0]];
-				sendCANMessage(&frame_switch);
-				usleep(30000);
-
-				frame_switch.data.byte[2] = lights[3][0];
-				frame_switch.data.byte[3] = lights_status[lights[3][0]];
-				frame_switch.data.byte[4] = lights_status[lights[3][0]];
-				sendCANMessage(&frame_switch);
-				usleep(30000);
-
-				frame_switch.data.byte[2] = lights[4][0];
-				frame_switch.data.byte[3] = lights_status[lights[4][0]];
-				frame_switch.data.byte[4] = lights_status[lights[4][0]];
-				sendCANMessage(&frame_switch);
-				usleep(30000);
-
-				frame_switch.data.byte[2] = lights[5][0];
-				frame_switch.data.byte[3] = lights_status[lights[5][0]];
-				frame_switch.data.byte[4] = lights_status[lights[5][0]];
-				sendCANMessage(&frame_switch);
-
-				cnt = 0;
+				gmlan_ipcLamps(&frame_switch, lights[sw_i][0], lights_status[lights[sw_i][0]]);
+				queueCANMessage(&can_ipc, &frame_switch);
 			}
 
-			led_sw_old[sw_i] = led_sw[sw_i];
+			LED_PUT(led_sw_old, sw_i, LED_GET(led_sw, sw_i));
 		}   // end "Update switch actions"
 
+		if (cnt > 3){                                 // no switch led changed and 4 seconds passed:
+			gmlan_ipcLamps(&frame_switch, lights[1][0], lights_status[lights[1][0]]);   // switch led status to IPC must be updated every 4 seconds
+			queueCANMessage(&can_ipc, &frame_switch);
+
+			gmlan_ipcLamps(&frame_switch, lights[2][0], lights_status[lights[2][0]]);
+			queueCANMessage(&can_ipc, &frame_switch);
+
+			gmlan_ipcLamps(&frame_switch, lights[3][0], lights_status[lights[3][0]]);
+			queueCANMessage(&can_ipc, &frame_switch);
+
+			gmlan_ipcLamps(&frame_switch, lights[4][0], lights_status[lights[4][0]]);
+			queueCANMessage(&can_ipc, &frame_switch);
+
+			gmlan_ipcLamps(&frame_switch, lights[5][0], lights_status[lights[5][0]]);
+			queueCANMessage(&can_ipc, &frame_switch);
+
+			cnt = 0;
+		}
+
 		// Any rotary enc switch pressed
-		if (enc_sw[1] || enc_sw[2] || enc_sw[3]){
-			if (enc_sw[1]){
+		if (SW_BIT(switches.pressed, SW_ENC_SW(1)) || SW_BIT(switches.pressed, SW_ENC_SW(2)) || SW_BIT(switches.pressed, SW_ENC_SW(3))){
+			if (SW_BIT(switches.pressed, SW_ENC_SW(1))){
 				mode[1] = !mode[1];
 				calc_rpm_leds(&rpm, mode, led_rpm);
+				show_mode_popup(MAX_1, mode[1]);
 			}
-			if (enc_sw[2]){
+			if (SW_BIT(switches.pressed, SW_ENC_SW(2))){
 				mode[2] = !mode[2];
 				calc_fuel_leds(&fuel, mode, led_fuel);
+				show_mode_popup(MAX_2, mode[2]);
 			}
-			if (enc_sw[3]){
+			if (SW_BIT(switches.pressed, SW_ENC_SW(3))){
 				mode[3] = !mode[3];
 				calc_sp_leds(&sp, mode, led_sp);
+				show_mode_popup(MAX_3, mode[3]);
 			}
 		}   // end "Any rotary enc switch pressed"
 
 
-		mcp_setPort(2, 'B', info_led);
+		mcp_setPortMasked(2, 'B', INFO_LED_MASK, info_led);   // sent only if the info leds changed
 
-		// Update switch leds and dial leds
-		fill_led_table(led_rpm, led_fuel, led_sp, led_sw, &led_sw11_color, mx);
-		show_leds(mx, &info_led);
+		// Update switch leds and dial leds (after the demonstration)
+		if (demo_step == DEMO_CNT){
+			if (fill_led_table(&leds, led_sw11_color, mx)){
+				show_leds(mx, &info_led);
+			}
+		}
+		display_task();
 
 	}    // end while(1){
 
@@ -694,6 +772,11 @@ void TimerHandler(void *CallBackRef, u8 TmrCtrNumber) {
 		XTmrCtr_Stop(InstancePtr, 1); // Acknowledge Timer 2 interrupt
 		XTmrCtr_Start(InstancePtr, 1);
 		millis++;
+		uart_poll();		// move received UART bytes to the software buffer before the FIFO fills
+		display_tick();		// mark a display refresh as due, sent by display_task()
+		fade_tick();		// pace the intensity fading, sent by fade_task()
+		debounce_tick();	// pace the switch sampling, done by debounce_due() / debounce_task()
+		mcp_checkTick();	// pace the MCP23S17 configuration check, done by mcp_checkTask()
 	}
 }
 
@@ -702,6 +785,8 @@ void TimerHandler(void *CallBackRef, u8 TmrCtrNumber) {
 // Interrupt Service Routine for MCP23S17 port status change. ISR is called when INT goes high
 void MCPisCalling() {
 	flg = true;
+	evq_push(EVQ_SRC_MCP, millis);	// a full queue only drops the time, flg still wakes the main loop
+	fade_activity();	// user input, no idle dimming
 }
 
 
@@ -712,41 +797,73 @@ void WakeUp() {
 
 
 
+/**
+ * @brief Extracts the A/B states of the 3 Rotary Encs from a port snapshot.
+ *
+ * @param ports 48-bit MCP23S17 port snapshot (mcp_scanPorts, mcp_captureAll).
+ * @param enc An array of unsigned characters where the 2-bit states
+ *            will be updated, index 0 not used, (enc_1,enc_2,enc_3)=(1,2,3).
+ */
+
+void enc_states(u64 ports, unsigned char enc[]){
+	enc[1] = (MCP_SNAP_PORT(ports, 0, 'B') & 0x06) >> 1; // IC1 Port B_2,1
+	enc[2] = (MCP_SNAP_PORT(ports, 1, 'A') & 0x18) >> 3; // IC2 Port A_4,3
+	enc[3] =  MCP_SNAP_PORT(ports, 2, 'A') & 0x03;       // IC3 Port A_1,0
+}
+
+
+
+/**
+ * @brief Moves a dial value by the steps of its Rotary Enc, within 0 to max.
+ *
+ * @param value Dial value (dial leds lit), will be updated.
+ * @param delta Steps from enc_delta(), positive increases.
+ * @param max Highest dial value.
+ *
+ * @return true if the value changed.
+ */
+
+bool dial_step(unsigned char *value, s16 delta, unsigned char max){
+	s16 next = (s16)(*value) + delta;
+
+	if (next < 0){
+		next = 0;
+	}
+	else if (next > max){
+		next = max;
+	}
+	if (next == *value){
+		return false;
+	}
+	*value = (unsigned char)next;
+	return true;
+}
+
+
+
 /**
  * @brief Calculates MAX7221 led controller register values,
  *        that are connected to switch leds and dial leds,
- *        from their bit values.
+ *        from their bit values (wiring of leds.c), only if a led changed.
  *
- * @param led_rpm RPM dial leds 0 to 16 boolean values.
- * @param led_fuel Fuel dial leds 0 to 8 boolean values.
- * @param led_sp Speed dial leds 0 to 24 boolean values.
- * @param led_sw Switch leds 1 to 35 boolean values. Switch 11 is bi-color
+ * @param leds Packed switch leds 1 to 35 and RPM/fuel/speed dial leds.
+ *             Switch 11 is bi-color
  * @param led_sw11_color Switch 11 red/yellow led boolean value. True is red.
  * @param mx A 2D array of unsigned characters where the MAX7221
  *           led controller register values will be updated.
  *           The dimensions of the array are 3 x 8.
  *
+ * @return true if a register value changed, the leds need show_leds().
+ *
  * @note For all led boolean values: true is led on, false is led off.
  */
 
-void fill_led_table(bool led_rpm[], bool led_fuel[], bool led_sp[], bool led_sw[], bool *led_sw11_color, unsigned char mx[][8]){
-	bool led_sw11_R, led_sw11_Y;  // Switch 11 red & yellow on/off status
-	led_sw11_R = led_sw[11] & (*led_sw11_color);
-	led_sw11_Y = led_sw[11] & (!(*led_sw11_color));
-
-	mx[0][0] =   led_sw[1] | (  led_sw[2] << 1) | (  led_sw[3] << 2) | (  led_sw[4] << 3) | (  led_sw[5] << 4) | (  led_sw[6] << 5) | (  led_sw[7] << 6) | (  led_sw[8] << 7);  // mx[0][0]
-	mx[0][1] =   led_sw[9] | ( led_sw[10] << 1) | ( led_sw11_R << 2) | ( led_sw11_Y << 3) | ( led_sw[12] << 4) | ( led_sw[13] << 5) | ( led_sw[14] << 6) | ( led_rpm[0] << 7);  // mx[0][1]
-	mx[0][2] =  led_rpm[1] | ( led_rpm[2] << 1) | ( led_rpm[3] << 2) | ( led_rpm[4] << 3) | ( led_rpm[5] << 4) | ( led_rpm[6] << 5) | ( led_rpm[7] << 6) | ( led_rpm[8] << 7);  // mx[0][2]
-	mx[0][3] =  led_rpm[9] | (led_rpm[10] << 1) | (led_rpm[11] << 2) | (led_rpm[12] << 3) | (led_rpm[13] << 4) | (led_rpm[14] << 5) | (led_rpm[15] << 6) | (led_rpm[16] << 7);  // mx[0][3]
-
-	mx[1][1] =  led_sw[23] | ( led_sw[22] << 1) | ( led_sw[21] << 2) | ( led_sw[20] << 3) | ( led_sw[24] << 4) | ( led_sw[25] << 5) | ( led_sw[35] << 6) | (  led_sp[0] << 7);  // mx[1][1]
-	mx[1][2] =  led_sw[15] | ( led_sw[16] << 1) | ( led_sw[17] << 2) | ( led_sw[18] << 3) | ( led_sw[19] << 4) | ( led_sw[26] << 5)                      | (led_fuel[0] << 7);  // mx[1][2] , bit 6 is not used
-	mx[1][3] = led_fuel[1] | (led_fuel[2] << 1) | (led_fuel[3] << 2) | (led_fuel[4] << 3) | (led_fuel[5] << 4) | (led_fuel[6] << 5) | (led_fuel[7] << 6) | (led_fuel[8] << 7);  // mx[1][3]
-
-	mx[2][0] =  led_sw[27] | ( led_sw[28] << 1) | ( led_sw[29] << 2) | ( led_sw[30] << 3) | ( led_sw[31] << 4) | ( led_sw[32] << 5) | ( led_sw[33] << 6) | ( led_sw[34] << 7);  // mx[2][0]
-	mx[2][1] =   led_sp[1] | (  led_sp[2] << 1) | (  led_sp[3] << 2) | (  led_sp[4] << 3) | (  led_sp[5] << 4) | (  led_sp[6] << 5) | (  led_sp[7] << 6) | (  led_sp[8] << 7);  // mx[2][1]
-	mx[2][2] =   led_sp[9] | ( led_sp[10] << 1) | ( led_sp[11] << 2) | ( led_sp[12] << 3) | ( led_sp[13] << 4) | ( led_sp[14] << 5) | ( led_sp[15] << 6) | ( led_sp[16] << 7);  // mx[2][2]
-	mx[2][3] =  led_sp[17] | ( led_sp[18] << 1) | ( led_sp[19] << 2) | ( led_sp[20] << 3) | ( led_sp[21] << 4) | ( led_sp[22] << 5) | ( led_sp[23] << 6) | ( led_sp[24] << 7);  // mx[2][3]
+bool fill_led_table(LED_STATE *leds, bool led_sw11_color, unsigned char mx[][8]){
+	if (led_gather(leds, led_sw11_color) == 0){   // no led changed since the last gather
+		return false;
+	}
+	led_toTable(leds, mx);
+	return true;
 }
 
 
@@ -792,19 +909,13 @@ void set_led_table(unsigned char mx[][8]){
  *            always on when its mode = 0.
  * @param mode Array of bolean values for RPM/fuel/sp dial leds selected mode
  *             of appearance.
- * @param led_rpm A boolean array where the RPM dial leds will be updated.
+ * @param led_rpm Packed RPM dial leds (bit n = led n), will be updated.
  *
  * @note For all led boolean values: true is led on, false is led off.
  */
 
-void calc_rpm_leds(unsigned char *rpm, bool mode[], bool led_rpm[]){
-	for (unsigned char i=0; i<(*rpm); i++){
-		led_rpm[i] = !mode[1];
-	}
-	led_rpm[(*rpm)] = 1;
-	for (unsigned char i=(*rpm) + 1; i<rpm_max; i++){
-		led_rpm[i] = 0;
-	}
+void calc_rpm_leds(unsigned char *rpm, bool mode[], u32 *led_rpm){
+	*led_rpm = led_dialMask(*rpm, mode[1]);   // lookup table, no per-led loop
 }
 
 
@@ -821,19 +932,13 @@ void calc_rpm_leds(unsigned char *rpm, bool mode[], bool led_rpm[]){
  *             always on when its mode = 0.
  * @param mode Array of bolean values for RPM/fuel/sp dial leds selected mode
  *             of appearance.
- * @param led_fuel A boolean array where the fuel dial leds will be updated.
+ * @param led_fuel Packed fuel dial leds (bit n = led n), will be updated.
  *
  * @note For all led boolean values: true is led on, false is led off.
  */
 
-void calc_fuel_leds(unsigned char *fuel, bool mode[], bool led_fuel[]){
-	for (unsigned char i=0; i<(*fuel); i++){
-		led_fuel[i] = !mode[2];
-	}
-	led_fuel[(*fuel)] = 1;
-	for (unsigned char i=(*fuel) + 1; i<fuel_max; i++){
-		led_fuel[i] = 0;
-	}
+void calc_fuel_leds(unsigned char *fuel, bool mode[], u32 *led_fuel){
+	*led_fuel = led_dialMask(*fuel, mode[2]);   // lookup table, no per-led loop
 }
 
 
@@ -850,19 +955,13 @@ void calc_fuel_leds(unsigned char *fuel, bool mode[], bool led_fuel[]){
  *            always on when its mode = 0.
  * @param mode Array of bolean values for RPM/fuel/sp dial leds selected mode
  *             of appearance.
- * @param led_sp A boolean array where where the speed dial leds will be updated.
+ * @param led_sp Packed speed dial leds (bit n = led n), will be updated.
  *
  * @note For all led boolean values: true is led on, false is led off.
  */
 
-void calc_sp_leds(unsigned char *sp, bool mode[], bool led_sp[]){
-	for (unsigned char i=0; i<(*sp); i++){
-		led_sp[i] = !mode[3];
-	}
-	led_sp[(*sp)] = 1;
-	for (unsigned char i=(*sp) + 1; i<sp_max; i++){
-		led_sp[i] = 0;
-	}
+void calc_sp_leds(unsigned char *sp, bool mode[], u32 *led_sp){
+	*led_sp = led_dialMask(*sp, mode[3]);   // lookup table, no per-led loop
 }
 
 
@@ -885,33 +984,35 @@ void calc_sp_leds(unsigned char *sp, bool mode[], bool led_sp[]){
  */
 
 void show_leds(unsigned char mx[][8], unsigned char *info_led){
-	setRow(MAX_1,0,mx[0][0]);  //icNumber=0 & row=0 receives mx[0][0]
-	setRow(MAX_1,1,mx[0][1]);  //icNumber=0 & row=1 receives mx[0][1]
-	setRow(MAX_1,2,mx[0][2]);  //icNumber=0 & row=2 receives mx[0][2]
-	setRow(MAX_1,3,mx[0][3]);  //icNumber=0 & row=3 receives mx[0][3]
+	display_setRow(MAX_1,0,mx[0][0]);  //icNumber=0 & row=0 receives mx[0][0]
+	display_setRow(MAX_1,1,mx[0][1]);  //icNumber=0 & row=1 receives mx[0][1]
+	display_setRow(MAX_1,2,mx[0][2]);  //icNumber=0 & row=2 receives mx[0][2]
+	display_setRow(MAX_1,3,mx[0][3]);  //icNumber=0 & row=3 receives mx[0][3]
 	// rows 4, 5, 6, 7 are 7-seg displays
 
 	// row 0 is now used.
-	setRow(MAX_2,1,mx[1][1]);  //icNumber=1 & row=1 receives mx[1][1]
-	setRow(MAX_2,2,mx[1][2]);  //icNumber=1 & row=2 receives mx[1][2]
-	setRow(MAX_2,3,mx[1][3]);  //icNumber=1 & row=3 receives mx[1][3]
+	display_setRow(MAX_2,1,mx[1][1]);  //icNumber=1 & row=1 receives mx[1][1]
+	display_setRow(MAX_2,2,mx[1][2]);  //icNumber=1 & row=2 receives mx[1][2]
+	display_setRow(MAX_2,3,mx[1][3]);  //icNumber=1 & row=3 receives mx[1][3]
 	// rows 4, 5, 6, 7 are 7-seg displays
 
-	setRow(MAX_3,0,mx[2][0]);  //icNumber=2 & row=0 receives mx[2][0]
-	setRow(MAX_3,1,mx[2][1]);  //icNumber=2 & row=1 receives mx[2][1]
-	setRow(MAX_3,2,mx[2][2]);  //icNumber=2 & row=2 receives mx[2][2]
-	setRow(MAX_3,3,mx[2][3]);  //icNumber=2 & row=3 receives mx[2][3]
+	display_setRow(MAX_3,0,mx[2][0]);  //icNumber=2 & row=0 receives mx[2][0]
+	display_setRow(MAX_3,1,mx[2][1]);  //icNumber=2 & row=1 receives mx[2][1]
+	display_setRow(MAX_3,2,mx[2][2]);  //icNumber=2 & row=2 receives mx[2][2]
+	display_setRow(MAX_3,3,mx[2][3]);  //icNumber=2 & row=3 receives mx[2][3]
 	// rows 4, 5, 6, 7 are 7-seg displays
 
+	display_swap();                   // sent by display_task() at the next frame
+
 	*info_led = (*info_led) & 0x70;   // clear bit 7 to turn on "Led"
 }
 
 
 
 /**
- * @brief Calculates thousands, hundrends, tens & units from the RPM value
- *        rpm_value and sends it to MAX7221 led controller, via SPI, to be
- *        displayed on RPM 7-seg led display, in format XXXX .
+ * @brief Formats the RPM value rpm_value (seg7_printNum, no divisions)
+ *        and draws it for the MAX7221 led controller, to be displayed
+ *        on RPM 7-seg led display, in format XXXX , leading zeros off.
  *
  * @param rpm_value An unsigned int value, which stores the RPM decimal
  *                  number that is dial indicated on the Instrument Panel
@@ -924,27 +1025,16 @@ void show_leds(unsigned char mx[][8], unsigned char *info_led){
  * @note For all 7-seg led display boolean values: true is led on, false
  *       is led off.
  *       The info leds are active low: true is led off, false is led on.
- *       Code B decode must be turned on for digits 7-4,
- *       that are connected to the 7-seg led displays.
+ *       Digits 7-4, that are connected to the 7-seg led displays,
+ *       get segment glyphs (no decode mode), see seg7.c.
  *       Variable bit order  :  7 6 5 4 3 2 1 0  (msb to lsb)
  *       Led display segment : DP A B C D E F G
  */
 
 void show_num_rpm(unsigned int rpm_value, unsigned char *info_led){
-	unsigned char rpm_th, rpm_hun, rpm_ten, rpm_un;
-
-	rpm_th = rpm_value /1000;
-	rpm_value = rpm_value - (rpm_th * 1000);
-	rpm_hun = rpm_value /100;
-	rpm_value = rpm_value - (rpm_hun * 100);
-	rpm_ten = rpm_value /10;
-	rpm_value = rpm_value - (rpm_ten * 10);
-	rpm_un = rpm_value % 10;
+	seg7_printNum(MAX_1, rpm_value, 4, SEG7_DP_NONE, SEG7_BLANK_ZEROS);
 
-	setNum(MAX_1, 0x07, rpm_th);
-	setNum(MAX_1, 0x06, rpm_hun);
-	setNum(MAX_1, 0x05, rpm_ten);
-	setNum(MAX_1, 0x04, rpm_un);
+	display_swap();                   // sent by display_task() at the next frame
 
 	*info_led = (*info_led) & 0xE0;   // clear bit 4 to turn on "Seg.Display"
 }
@@ -952,9 +1042,9 @@ void show_num_rpm(unsigned int rpm_value, unsigned char *info_led){
 
 
 /**
- * @brief Calculates tens & units from the fuel value
- *        fuel_value and sends it to MAX7221 led controller, via SPI, to be
- *        displayed on fuel 7-seg led display, in format XX.00 .
+ * @brief Formats the fuel value fuel_value (seg7_printNum, no divisions)
+ *        and draws it for the MAX7221 led controller, to be displayed
+ *        on fuel 7-seg led display, in format XX.00 , leading zero off.
  *
  * @param fuel_value An unsigned int value, which stores the fuel decimal
  *                   number (& 2 dummy float digits) that is dial indicated
@@ -967,24 +1057,16 @@ void show_num_rpm(unsigned int rpm_value, unsigned char *info_led){
  * @note For all 7-seg led display boolean values: true is led on, false
  *       is led off.
  *       The info leds are active low: true is led off, false is led on.
- *       Code B decode must be turned on for digits 7-4,
- *       that are connected to the 7-seg led displays.
+ *       Digits 7-4, that are connected to the 7-seg led displays,
+ *       get segment glyphs (no decode mode), see seg7.c.
  *       Variable bit order  :  7 6 5 4 3 2 1 0  (msb to lsb)
  *       Led display segment : DP A B C D E F G
  */
 
 void show_num_fuel(unsigned int fuel_value, unsigned char *info_led){
-	unsigned char fuel_ten, fuel_un, fuel_dec1, fuel_dec2;
+	seg7_printNum(MAX_2, fuel_value * 100, 4, 2, SEG7_BLANK_ZEROS);  // 2 dummy float digits, decimal point on the units
 
-	fuel_ten = fuel_value / 10;
-	fuel_un = 128 + (fuel_value % 10); // 128 is for Decimal Point
-	fuel_dec1 = 0;
-	fuel_dec2 = 0;
-
-	setNum(MAX_2, 0x07, fuel_ten);
-	setNum(MAX_2, 0x06, fuel_un);
-	setNum(MAX_2, 0x05, fuel_dec1);
-	setNum(MAX_2, 0x04, fuel_dec2);
+	display_swap();                   // sent by display_task() at the next frame
 
 	*info_led = (*info_led) & 0xE0;   // clear bit 4 to turn on "Seg.Display"
 }
@@ -992,9 +1074,9 @@ void show_num_fuel(unsigned int fuel_value, unsigned char *info_led){
 
 
 /**
- * @brief Calculates thousands, hundrends, tens & units from the speed value
- *        sp_value and sends it to MAX7221 led controller, via SPI, to be
- *        displayed on speed 7-seg led display, in format XXXX .
+ * @brief Formats the speed value sp_value (seg7_printNum, no divisions)
+ *        and draws it for the MAX7221 led controller, to be displayed
+ *        on speed 7-seg led display, in format XXXX , leading zeros off.
  *
  * @param sp_value An unsigned int value, which stores the speed
  *                 decimal number that is dial indicated on the Instrument
@@ -1007,27 +1089,16 @@ void show_num_fuel(unsigned int fuel_value, unsigned char *info_led){
  * @note For all 7-seg led display boolean values: true is led on, false
  *       is led off.
  *       The info leds are active low: true is led off, false is led on.
- *       Code B decode must be turned on for digits 7-4,
- *       that are connected to the 7-seg led displays.
+ *       Digits 7-4, that are connected to the 7-seg led displays,
+ *       get segment glyphs (no decode mode), see seg7.c.
  *       Variable bit order  :  7 6 5 4 3 2 1 0  (msb to lsb)
  *       Led display segment : DP A B C D E F G
  */
 
 void show_num_sp(unsigned int sp_value, unsigned char *info_led){
-	unsigned char sp_th, sp_hun, sp_ten, sp_un;
-
-	sp_th = sp_value /1000;
-	sp_value = sp_value - (sp_th * 1000);
-	sp_hun = sp_value /100;
-	sp_value = sp_value - (sp_hun * 100);
-	sp_ten = sp_value /10;
-	sp_value = sp_value - (sp_ten * 10);
-	sp_un = sp_value % 10;
+	seg7_printNum(MAX_3, sp_value, 4, SEG7_DP_NONE, SEG7_BLANK_ZEROS);
 
-	setNum(MAX_3, 0x07, sp_th);
-	setNum(MAX_3, 0x06, sp_hun);
-	setNum(MAX_3, 0x05, sp_ten);
-	setNum(MAX_3, 0x04, sp_un);
+	display_swap();                   // sent by display_task() at the next frame
 
 	*info_led = (*info_led) & 0xE0;   // clear bit 4 to turn on "Seg.Display"
 }
@@ -1035,8 +1106,8 @@ void show_num_sp(unsigned int sp_value, unsigned char *info_led){
 
 
 /**
- * @brief Sends to MAX7221 led controller, via SPI, the register values,
- *        to turn on all the segments on the connected 7-seg led displays.
+ * @brief Draws into the lamp test layer the register values, to turn on
+ *        all the segments on the connected 7-seg led displays.
  *
  * @param info_led An unsigned char value, of which the upper nibble stores
  *                 information about the 4 status active-low leds.
@@ -1046,17 +1117,20 @@ void show_num_sp(unsigned int sp_value, unsigned char *info_led){
  * @note For all 7-seg led display boolean values: true is led on, false
  *       is led off.
  *       The info leds are active low: true is led off, false is led on.
- *       Code B decode must be turned on for digits 7-4,
- *       that are connected to the 7-seg led displays.
+ *       Digits 7-4, that are connected to the 7-seg led displays,
+ *       get segment glyphs (no decode mode), see seg7.c.
  *       Variable bit order  :  7 6 5 4 3 2 1 0  (msb to lsb)
  *       Led display segment : DP A B C D E F G
  */
 
 void set_num_all(unsigned char *info_led){
+	unsigned char glyph[SEG7_WIDTH];
+
+	// Display "8." on all digits
+	seg7_render(glyph, SEG7_WIDTH, "8.8.8.8.");
 	for (unsigned char icNumber=0; icNumber<3; icNumber++){
-		for (unsigned char digit=7; digit>3; digit--){
-			// Display "8" & Decimal Point (value 128). 128 + 8 = 136
-			setNum(icNumber, digit, 136);
+		for (unsigned char i=0; i<SEG7_WIDTH; i++){
+			display_layerSetRow(DISPLAY_LAYER_TEST, icNumber, SEG7_FIRST_DIGIT - i, glyph[i], 0xFF);
 		}
 	}
 	*info_led = (*info_led) & 0xE0;   // clear bit 4 to turn on "Seg.Display"
@@ -1064,17 +1138,82 @@ void set_num_all(unsigned char *info_led){
 
 
 
+/**
+ * @brief Draws into the lamp test layer the switch leds and dial leds
+ *        register values (from set_led_table), and shows the layer over
+ *        the display for LAMP_TEST_TIME. Nothing waits for the test to end.
+ *
+ * @param mx A 2D array of unsigned characters and dimensions of 3 x 8 .
+ *           Rows 0 to 3 store the lamp test switch leds and dial leds.
+ * @param info_led An unsigned char value, of which the upper nibble stores
+ *                 information about the 4 status active-low leds.
+ *                 Its bit 7 is connected to the "Led" led.
+ *
+ * @note The 7-seg led display digits of the layer are drawn by set_num_all().
+ */
+
+void show_lamp_test(unsigned char mx[][8], unsigned char *info_led){
+	for (unsigned char icNumber=0; icNumber<3; icNumber++){
+		for (unsigned char row=0; row<4; row++){    // rows 4, 5, 6, 7 are 7-seg displays
+			display_layerSetRow(DISPLAY_LAYER_TEST, icNumber, row, mx[icNumber][row], 0xFF);
+		}
+	}
+	display_layerShow(DISPLAY_LAYER_TEST, LAMP_TEST_TIME, 0);
+
+	*info_led = (*info_led) & 0x70;   // clear bit 7 to turn on "Led"
+}
+
+
+
+/**
+ * @brief Draws the alarm layer: a dash on every 7-seg led display digit.
+ *        Shown blinking while the Emergency Lights (S24) are on, the
+ *        switch leds and dial leds are not covered.
+ */
+
+void set_alarm_layer(){
+	for (unsigned char icNumber=0; icNumber<3; icNumber++){
+		for (unsigned char i=0; i<SEG7_WIDTH; i++){
+			display_layerSetRow(DISPLAY_LAYER_ALARM, icNumber, SEG7_FIRST_DIGIT - i, seg7_glyph('-'), 0xFF);
+		}
+	}
+}
+
+
+
+/**
+ * @brief Shows the dial leds mode, "dot" or "bAr", on the 7-seg led
+ *        display of the dial for POPUP_TIME, over the dial value.
+ *
+ * @param icNumber MAX7221 of the dial (MAX_1 RPM, MAX_2 fuel, MAX_3 speed).
+ * @param dot_mode true for dot led mode, false for led bar mode.
+ */
+
+void show_mode_popup(unsigned char icNumber, bool dot_mode){
+	unsigned char glyph[SEG7_WIDTH];
+
+	if (!display_layerActive(DISPLAY_LAYER_POPUP)){
+		display_layerClear(DISPLAY_LAYER_POPUP);    // drop the displays of an expired pop-up
+	}
+	seg7_render(glyph, SEG7_WIDTH, dot_mode ? "dot" : "bAr");
+	for (unsigned char i=0; i<SEG7_WIDTH; i++){
+		display_layerSetRow(DISPLAY_LAYER_POPUP, icNumber, SEG7_FIRST_DIGIT - i, glyph[i], 0xFF);
+	}
+	display_layerShow(DISPLAY_LAYER_POPUP, POPUP_TIME, 0);
+}
+
+
+
 /**
  * @brief Updates the values which store the state of the switch leds
  *        S20, S21 & S23, to switched off. Also it sends to the Instrument
  *        Panel Cluster, via CAN_Bus, the register values, to turn off
  *        S20, S21 & S23 indications.
  *
- * @param led_sw An array of boolean values where the switch led states will
- *               be updated. The dimension of the array is 36.
- * @param led_sw_old Pointer to the first element of an array of boolean values
- *                   where the previous state of the switch leds, will be updated.
- *                   The dimension of the array is 36.
+ * @param led_sw Packed switch leds (bit n = switch n, LED_GET / LED_PUT),
+ *               will be updated.
+ * @param led_sw_old Packed previous state of the switch leds (LED_SW_WORDS
+ *                   words), will be updated.
  * @param lights_status An array of unsigned characters that keeps track of
  *                      the state of the switch leds, grouped (per index) in
  *                      line with the CAN-Bus message byte 3
@@ -1086,34 +1225,25 @@ void set_num_all(unsigned char *info_led){
  * @note For all led boolean values: true is led on, false is led off.
  */
 
-void clear_leds_on_lcd(bool led_sw[], bool led_sw_old[], unsigned char lights_status[], unsigned char *info_led){
+void clear_leds_on_lcd(u32 led_sw[], u32 led_sw_old[], unsigned char lights_status[], unsigned char *info_led){
 	// Turn off switch leds S20, S21 & S23
-	led_sw[20] = 0;
-	led_sw[21] = 0;
-	led_sw[23] = 0;
-	led_sw_old[20] = 0;
-	led_sw_old[21] = 0;
-	led_sw_old[23] = 0;
-
-	// Template CAN-Bus "indications" message
+	LED_CLR(led_sw, 20);
+	LED_CLR(led_sw, 21);
+	LED_CLR(led_sw, 23);
+	LED_CLR(led_sw_old, 20);
+	LED_CLR(led_sw_old, 21);
+	LED_CLR(led_sw_old, 23);
+
+	// CAN-Bus "indications" message
 	CAN_FRAME frame_switch;
-	frame_switch.id = 0x255;
-	frame_switch.length = 8;
-	frame_switch.data.low  = 0x0000AE04;
-	frame_switch.data.high = 0x00000000;
 
 	// Turn off S21 & S20 indications
-	frame_switch.data.byte[2] = 0x02;
-	frame_switch.data.byte[3] = lights_status[0x02] & 0xF9;
-	frame_switch.data.byte[4] = lights_status[0x02] & 0xF9;
-	sendCANMessage(&frame_switch);
+	gmlan_ipcLamps(&frame_switch, 0x02, lights_status[0x02] & 0xF9);
+	queueCANMessage(&can_ipc, &frame_switch);
 
 	// Turn off S23 indication
-	frame_switch.data.byte[2] = 0x04;
-	frame_switch.data.byte[3] = lights_status[0x02] & 0xDF;
-	frame_switch.data.byte[4] = lights_status[0x02] & 0xDF;
-	sendCANMessage(&frame_switch);
-	usleep(30000);
+	gmlan_ipcLamps(&frame_switch, 0x04, lights_status[0x02] & 0xDF);
+	queueCANMessage(&can_ipc, &frame_switch);
 
 	*info_led = (*info_led) & 0x70;   // clear bit 7 to turn on "Led"
 }
@@ -1126,11 +1256,10 @@ void clear_leds_on_lcd(bool led_sw[], bool led_sw_old[], unsigned char lights_st
  *        Panel Cluster, via CAN_Bus, the register values, to turn off
  *        all indications, except S24, S25 & S35.
  *
- * @param led_sw An array of boolean values where the switch led states will
- *               be updated. The dimension of the array is 36.
- * @param led_sw_old Pointer to the first element of an array of boolean values
- *                   where the previous state of the switch leds, will be updated.
- *                   The dimension of the array is 36.
+ * @param led_sw Packed switch leds (bit n = switch n, LED_GET / LED_PUT),
+ *               will be updated.
+ * @param led_sw_old Packed previous state of the switch leds (LED_SW_WORDS
+ *                   words), will be updated.
  * @param lights_status An array of unsigned characters that keeps track of
  *                      the state of the switch leds, grouped (per index) in
  *                      line with the CAN-Bus message byte 3
@@ -1143,30 +1272,25 @@ void clear_leds_on_lcd(bool led_sw[], bool led_sw_old[], unsigned char lights_st
  *       The info leds are active low: true is led off, false is led on.
  */
 
-void clear_switch_leds(bool led_sw[], bool led_sw_old[], unsigned char lights_status[], unsigned char *info_led){
+void clear_switch_leds(u32 led_sw[], u32 led_sw_old[], unsigned char lights_status[], unsigned char *info_led){
 	// Turn off all switch leds, except S24, S25 and S35
 	for (unsigned char i=1; i<24; i++){
-		led_sw[i] = 0;
-		led_sw_old[i] = 0;
+		LED_CLR(led_sw, i);
+		LED_CLR(led_sw_old, i);
 	}
 	for (unsigned char i=26; i<35; i++){
-		led_sw[i] = 0;
-		led_sw_old[i] = 0;
+		LED_CLR(led_sw, i);
+		LED_CLR(led_sw_old, i);
 	}
 
-	// Template CAN-Bus "indications" message
+	// CAN-Bus "indications" message
 	CAN_FRAME frame_switch;
-	frame_switch.id = 0x255;
-	frame_switch.length = 8;
-	frame_switch.data.low  = 0x0000AE04;
-	frame_switch.data.high = 0x00000000;
 
 	// Clear the indication register file and turn off all indications
 	for (unsigned char i=1; i<6; i++){
 		lights_status[i] = 0x00;
-		frame_switch.data.byte[2] = i;
-		sendCANMessage(&frame_switch);
-		usleep(30000);
+		gmlan_ipcLamps(&frame_switch, i, 0x00);
+		queueCANMessage(&can_ipc, &frame_switch);
 	}
 
 	*info_led = (*info_led) & 0x70;   // clear bit 7 to turn on "Led"
@@ -1199,9 +1323,9 @@ void clear_switch_leds(bool led_sw[], bool led_sw_old[], unsigned char lights_st
  *           always on when its mode = 0.
  * @param mode Array of bolean values for RPM/fuel/sp dial leds selected mode
  *             of appearance.
- * @param led_rpm A boolean array where the RPM dial leds will be updated.
- * @param led_fuel A boolean array where the fuel dial leds will be updated.
- * @param led_sp A boolean array where where the speed dial leds will be updated.
+ * @param led_rpm Packed RPM dial leds (bit n = led n), will be updated.
+ * @param led_fuel Packed fuel dial leds (bit n = led n), will be updated.
+ * @param led_sp Packed speed dial leds (bit n = led n), will be updated.
  * @param info_led An unsigned char value, of which the upper nibble stores
  *                 information about the 4 status active-low leds.
  *                 Its bit 7 is connected to the "Led" led.
@@ -1211,40 +1335,30 @@ void clear_switch_leds(bool led_sw[], bool led_sw_old[], unsigned char lights_st
  *       The info leds are active low: true is led off, false is led on.
  */
 
-void clear_dials(unsigned char *rpm, unsigned char *fuel, unsigned char *sp, bool mode[], bool led_rpm[], bool led_fuel[], bool led_sp[], unsigned char *info_led){
-	// Template CAN-Bus "dials" message
+void clear_dials(unsigned char *rpm, unsigned char *fuel, unsigned char *sp, bool mode[], u32 *led_rpm, u32 *led_fuel, u32 *led_sp, unsigned char *info_led){
+	// CAN-Bus "dials" message
 	CAN_FRAME frame_rotary;
-	frame_rotary.id = 0x255;
-	frame_rotary.length = 8;
-	frame_rotary.data.low  = 0x0100AE04;
-	frame_rotary.data.high = 0x00000000;
 
 	*rpm = 0;
 	calc_rpm_leds(rpm, mode, led_rpm);
 	show_num_rpm((unsigned int)(*rpm) * 500, info_led);
 	// Reset RPM dial indicator to zero position
-	frame_rotary.data.byte[2] = 0x09;
-	frame_rotary.data.byte[4] = 0x00;
-	sendCANMessage(&frame_rotary);
-	usleep(30000);
+	gmlan_ipcDial(&frame_rotary, GMLAN_DC_CPID_RPM, 0x00);
+	queueCANMessage(&can_ipc, &frame_rotary);
 
 	*fuel = 0;
 	calc_fuel_leds(fuel, mode, led_fuel);
 	show_num_fuel((unsigned int)(*fuel) * 6, info_led);
 	// Reset Fuel Tank Level dial indicator to zero position
-	frame_rotary.data.byte[2] = 0x0A;
-	frame_rotary.data.byte[4] = 0x00;
-	sendCANMessage(&frame_rotary);
-	usleep(30000);
+	gmlan_ipcDial(&frame_rotary, GMLAN_DC_CPID_FUEL, 0x00);
+	queueCANMessage(&can_ipc, &frame_rotary);
 
 	*sp = 0;
 	calc_sp_leds(sp, mode, led_sp);
 	show_num_sp((unsigned int)(*sp) * 10, info_led);
 	// Reset Speed dial indicator to zero position
-	frame_rotary.data.byte[2] = 0x08;
-	frame_rotary.data.byte[4] = 0x00;
-	sendCANMessage(&frame_rotary);
-	usleep(30000);
+	gmlan_ipcDial(&frame_rotary, GMLAN_DC_CPID_SPEED, 0x00);
+	queueCANMessage(&can_ipc, &frame_rotary);
 
 	*info_led = (*info_led) & 0x60; // clear bit 4 to turn on "Seg.Display"
 									// and clear bit 7 to turn on "Led"
@@ -1253,87 +1367,71 @@ void clear_dials(unsigned char *rpm, unsigned char *fuel, unsigned char *sp, boo
 
 
 /**
- * @brief Demonstration of all the 7-seg led displays (RPM/fuel/speed)
- *        based on a preset of values, one go with dot point switched on,
- *        and another go with dot point switched off.
+ * @brief Draws one frame of the 7-seg led displays (RPM/fuel/speed)
+ *        demonstration: a moving snake, one go with dot point switched
+ *        off, and another go with dot point switched on.
  *        Follows up all segments on, then all segments off.
- *        Finnaly, tries to display " rP", "FuEL" and "SPEE" on the
- *        7-seg led displays, meaning "RPM", "FUEL" and "SPEED"
+ *        Finnaly, scrolls "rPM", "FUEL" and "SPEEd" in on the
+ *        7-seg led displays.
  *
+ * @param frame Frame number from the demonstration animation: 0 to 15 snake,
+ *              DEMO_SEG_ALL_ON, DEMO_SEG_ALL_OFF or DEMO_SEG_TEXT.
  * @param demoSeg An array of unsigned characters which stores a
  *                preset of values, to display a moving snake on
  *                the 7-seg led displays.
- * @param rfs An array of unsigned characters which stores a preset
- *            of values, to display " rP", "FuEL" and "SPEE" on the
- *            7-seg led displays, meaning "RPM", "FUEL" and "SPEED"
+ * @param demoText The RPM, fuel and speed display texts.
+ * @param marquee The RPM, fuel and speed display marquees, started on the
+ *                DEMO_SEG_TEXT frame and stepped from the main loop.
+ * @param now Current time in msec (millis).
  *
  * @note For all 7-seg led display boolean values: true is led on, false
  *       is led off.
  *       The info leds are not affected during demonstration.
- *       Code B decode must be turned off for digits 7-4, that are
- *       connected to the 7-seg led displays, during demonstartion
+ *       Digits 7-4, that are connected to the 7-seg led displays,
+ *       get segment glyphs (no decode mode), see seg7.c.
  *       Variable bit order  :  7 6 5 4 3 2 1 0  (msb to lsb)
  *       Led display segment : DP A B C D E F G
  */
 
-void demo_segs(unsigned char demoSeg[], unsigned char rfs[]){
-	for (unsigned char dot_point_switch=0; dot_point_switch<2; dot_point_switch++){
-		for (unsigned char i=0; i<8; i++){
-			for (unsigned char icNumber=0; icNumber<3; icNumber++){
-				for (unsigned char segment=7; segment>3; segment--){
-					setRow(icNumber, segment, demoSeg[i] + dot_point_switch*128);
-				}
-			}
-			usleep(demoDelayTime1 * 1000);
-		}
-	}
+void demo_segs(unsigned char frame, unsigned char demoSeg[], const char *demoText[], SEG7_MARQUEE marquee[], unsigned int now){
 	for (unsigned char icNumber=0; icNumber<3; icNumber++){
-		for (unsigned char segment=7; segment>3; segment--){
-			setRow(icNumber, segment, 0xFF);
+		if (frame == DEMO_SEG_TEXT){
+			seg7_marqueeStart(&marquee[icNumber], icNumber, demoText[icNumber], demoScrollTime, false, now);
+			continue;                       // drawn by seg7_marqueeStep()
 		}
-	}
-	usleep(demoDelayTime2 * 1000);
-	for (unsigned char icNumber=0; icNumber<3; icNumber++){
 		for (unsigned char segment=7; segment>3; segment--){
-			setRow(icNumber, segment, 0x00);
+			if (frame < DEMO_SEG_ALL_ON){
+				display_setRow(icNumber, segment, demoSeg[frame & 0x07] | ((frame >> 3) ? SEG7_DP : 0));
+			}
+			else if (frame == DEMO_SEG_ALL_ON){
+				display_setRow(icNumber, segment, 0xFF);
+			}
+			else{
+				display_setRow(icNumber, segment, SEG7_BLANK);
+			}
 		}
 	}
-	usleep(demoDelayTime2 * 1000);
-	unsigned char i=0;
-	for (unsigned char icNumber=0; icNumber<3; icNumber++){
-		for (unsigned char segment=7; segment>3; segment--){
-			setRow(icNumber, segment, rfs[i++]);
-		}
+	if (frame != DEMO_SEG_TEXT){
+		display_swap();
 	}
-	usleep(demoDelayTime2 * 1000);
 }
 
 
 
 /**
- * @brief Demonstration of all the switch leds.
+ * @brief Draws one frame of the switch leds demonstration.
  *        The leds are switched on, one after another and they stay on,
  *        in order, based on a preset order. Switch S11 is bi-color, so
  *        it switches between yellow and red.
  *        Finally, it switches off all switch leds.
+ *        The dial leds are drawn from their current state.
  *
- * @param led_sw An array of boolean values where the switch led states will
- *               be updated. The dimension of the array is 36.
+ * @param count Number of leds from demoButtons that are on, from the
+ *              demonstration animation.
+ * @param sw11_red Switch 11 red/yellow led boolean value. True is red.
  * @param demoButtons An array of unsigned char values which stores a
  *                    preset of led lighting order, for demonstration
- * @param led_rpm A boolean array where the RPM dial leds will be updated.
- * @param led_fuel A boolean array where the fuel dial leds will be updated.
- * @param led_sp A boolean array where where the speed dial leds will be updated.
- * @param led_sw11_color Switch 11 red/yellow led boolean value. True is red.
-
- * @param led_sw Pointer to the first element of an array of boolean values         // delete
- *           where the switch led states will be updated.
- *           The dimension of the array is 36.
- * @param led_rpm[] RPM dial leds 0 to 16 boolean values.
- * @param led_fuel[] Fuel dial leds 0 to 8 boolean values.
- * @param led_sp[] Speed dial leds 0 to 24 boolean values.
- * @param led_sw[] Switch leds 1 to 35 boolean values. Switch 11 is bi-color.
- * @param led_sw11_color Switch 11 red/yellow led boolean value. True is red.
+ * @param leds Packed leds of the application, the dial leds are drawn from it.
  * @param mx A 2D array of unsigned characters and dimensions of 3 x 8 .
  *           A part of this array stores information about the on/off state
  *           of the connected switch leds and dial leds.
@@ -1344,40 +1442,36 @@ void demo_segs(unsigned char demoSeg[], unsigned char rfs[]){
  *
  * @note For all led boolean values: true is led on, false is led off.
  *       The info leds are active low: true is led off, false is led on.
+ *       The switch led states of the application are not changed.
  */
 
-void demo_switch_leds(bool led_sw[], unsigned char demoButtons[], bool led_rpm[], bool led_fuel[], bool led_sp[], bool *led_sw11_color, unsigned char mx[][8], unsigned char *info_led){
-	for (unsigned char i=0; i<36; i++){
-		led_sw[demoButtons[i]] = 1;
-		fill_led_table(led_rpm, led_fuel, led_sp, led_sw, led_sw11_color, mx);
-		show_leds(mx, info_led);
-		usleep(demoDelayTime3 * 1000);
-
-		if (demoButtons[i] == 11){
-			// demoButtons[5] is 11, and switch S11 led is bi-color
-			usleep(2 * demoDelayTime3 * 1000);
-			*led_sw11_color = 1;
-			fill_led_table(led_rpm, led_fuel, led_sp, led_sw, led_sw11_color, mx);
-			show_leds(mx, info_led);
-			usleep(demoDelayTime3 * 1000);
-		}
+void demo_switch_leds(unsigned char count, bool sw11_red, unsigned char demoButtons[], LED_STATE *leds, unsigned char mx[][8], unsigned char *info_led){
+	static LED_STATE leds_demo;         // Temporary switch leds, dial leds of the application
+	static bool init = false;
+	if (!init){
+		led_init(&leds_demo);
+		init = true;
 	}
-	usleep(demoDelayTime4 * 1000);
-	for (unsigned char i=0; i<36; i++){
-		led_sw[demoButtons[i]] = 0;
+	leds_demo.word[LED_W_SW0] = 0;
+	leds_demo.word[LED_W_SW1] = 0;
+	for (unsigned char i=0; (i<count) && (i<35); i++){
+		LED_SET(leds_demo.word, demoButtons[i]);
+	}
+	leds_demo.word[LED_W_RPM] = leds->word[LED_W_RPM];
+	leds_demo.word[LED_W_FUEL] = leds->word[LED_W_FUEL];
+	leds_demo.word[LED_W_SP] = leds->word[LED_W_SP];
+	if (fill_led_table(&leds_demo, sw11_red, mx)){
+		show_leds(mx, info_led);
 	}
-	*led_sw11_color = 0;
-	fill_led_table(led_rpm, led_fuel, led_sp, led_sw, led_sw11_color, mx);
-	show_leds(mx, info_led);
 }
 
 
 
 /**
- * @brief Demonstration of all the dial leds.
+ * @brief Draws one frame of the dial leds demonstration.
  *        The RPM/fuel/speed dial leds are switched on, in the same angular
  *        speed, so that they reach their minimum / maximum value at the
- *        same time. A preset table of values helps in this procedure.
+ *        same time. The demonstration animation interpolates the values.
  *        The demonstration runs two times, one in dot mode of appearance,
  *        and another one in led bar mode of appearance.
  *        mode = 0 : the leds from 0 to RPM/fuel/speed value are on, rest are off.
@@ -1386,11 +1480,12 @@ void demo_switch_leds(bool led_sw[], unsigned char demoButtons[], bool led_rpm[]
  *        values and sends them to MAX7221 led controller, via SPI, to be
  *        displayed on speed 7-seg led display, in format XXXX and XX.00 .
  *
- * @param demo A struct of type DemoData that stores preset values, that indicates
- *             at which time of running the demonstration, the RPM/fuel/speed
- *             values change, and their dial leds value at that time.
- * @param led_sw An array of boolean values where the switch led states will
- *               be updated. The dimension of the array is 36.
+ * @param rpm Number of RPM dial leds that are on.
+ * @param fuel Number of fuel dial leds that are on.
+ * @param sp Number of speed dial leds that are on.
+ * @param dot_mode Dial leds mode of appearance, true is dot mode.
+ * @param led_sw Packed switch leds (bit n = switch n, LED_GET / LED_PUT),
+ *               will be updated.
  * @param led_sw11_color Switch 11 red/yellow led boolean value. True is red.
  * @param mx A 2D array of unsigned characters and dimensions of 3 x 8 .
  *           A part of this array stores information about the on/off state
@@ -1404,94 +1499,229 @@ void demo_switch_leds(bool led_sw[], unsigned char demoButtons[], bool led_rpm[]
  *       The info leds are active low: true is led off, false is led on.
  */
 
-void demo_dial_leds(DemoData demo[], bool led_sw[], bool *led_sw11_color, unsigned char mx[][8], unsigned char *info_led){
-	// Temporary RPM/fuel/speed dial leds bool arrays
-	bool led_rpm_demo[rpm_max] = {0};
-	bool led_fuel_demo[fuel_max] = {0};
-	bool led_sp_demo[sp_max] = {0};
-	bool mode_demo[4] = {0};
-
-	bool change = false;
-	unsigned char rpm = 0, fuel = 0, sp = 0;
-	unsigned char rpm_old = 255, fuel_old = 255, sp_old = 255;
-	unsigned long t, t_now, t_start;
-
-	for (bool demo_mode = true; ; demo_mode = !demo_mode) {
-		mode_demo[1] = demo_mode;
-		mode_demo[2] = demo_mode;
-		mode_demo[3] = demo_mode;
-		// Forward
-		t_start = millis;
-		for (unsigned char i=0; i<33; i++){
-			t = (unsigned long)(demo[i].time);
-			rpm  = demo[i].rpm;
-			fuel = demo[i].fuel;
-			sp   = demo[i].sp;
-			do {
-				t_now = millis;
-			} while ((t_now - t_start) < t);
-			if (rpm != rpm_old){
-				calc_rpm_leds(&rpm, mode_demo, led_rpm_demo);
-				show_num_rpm((unsigned int)(rpm) * 500, info_led);
-				rpm_old = rpm;
-				change = true;
-			}
-			if (fuel != fuel_old){
-				calc_fuel_leds(&fuel, mode_demo, led_fuel_demo);
-				show_num_fuel((unsigned int)(fuel) * 6, info_led);
-				fuel_old = fuel;
-				change = true;
-			}
-			if (sp != sp_old){
-				calc_sp_leds(&sp, mode_demo, led_sp_demo);
-				show_num_sp((unsigned int)(sp) * 10, info_led);
-				sp_old = sp;
-				change = true;
-			}
-			if (change){
-				fill_led_table(led_rpm_demo, led_fuel_demo, led_sp_demo, led_sw, led_sw11_color, mx);
-				show_leds(mx, info_led);
-				change = false;
-			}
+void demo_dial_leds(unsigned char rpm, unsigned char fuel, unsigned char sp, bool dot_mode, u32 led_sw[], bool *led_sw11_color, unsigned char mx[][8], unsigned char *info_led){
+	// Temporary RPM/fuel/speed dial leds, kept between frames
+	static LED_STATE leds_demo;
+	static bool init = false;
+	if (!init){
+		led_init(&leds_demo);
+		init = true;
+	}
+	u32 *led_rpm_demo = &leds_demo.word[LED_W_RPM];
+	u32 *led_fuel_demo = &leds_demo.word[LED_W_FUEL];
+	u32 *led_sp_demo = &leds_demo.word[LED_W_SP];
+	static unsigned char rpm_old = 255, fuel_old = 255, sp_old = 255;
+	static bool mode_old = false;
+	bool mode_demo[4] = {0, dot_mode, dot_mode, dot_mode};
+
+	if ((rpm != rpm_old) || (dot_mode != mode_old)){
+		calc_rpm_leds(&rpm, mode_demo, led_rpm_demo);
+		if (rpm != rpm_old){
+			show_num_rpm((unsigned int)(rpm) * 500, info_led);
 		}
-		usleep(demoDelayTime5 * 1000);
-		// Backward
-		t_start = millis;
-		for (unsigned char i=0; i<33; i++){
-			t = (unsigned long)(demo[i].time);
-			rpm  = demo[32-i].rpm;
-			fuel = demo[32-i].fuel;
-			sp   = demo[32-i].sp;
-			do {
-				t_now = millis;
-			} while ((t_now - t_start) < t);
-			if (rpm != rpm_old){
-				calc_rpm_leds(&rpm, mode_demo, led_rpm_demo);
-				show_num_rpm((unsigned int)(rpm) * 500, info_led);
-				rpm_old = rpm;
-				change = true;
-			}
-			if (fuel != fuel_old){
-				calc_fuel_leds(&fuel, mode_demo, led_fuel_demo);
-				show_num_fuel((unsigned int)(fuel) * 6, info_led);
-				fuel_old = fuel;
-				change = true;
-			}
-			if (sp != sp_old){
-				calc_sp_leds(&sp, mode_demo, led_sp_demo);
-				show_num_sp((unsigned int)(sp) * 10, info_led);
-				sp_old = sp;
-				change = true;
-			}
-			if (change == 1){
-				fill_led_table(led_rpm_demo, led_fuel_demo, led_sp_demo, led_sw, led_sw11_color, mx);
-				show_leds(mx, info_led);
-				change = false;
-			}
+		rpm_old = rpm;
+	}
+	if ((fuel != fuel_old) || (dot_mode != mode_old)){
+		calc_fuel_leds(&fuel, mode_demo, led_fuel_demo);
+		if (fuel != fuel_old){
+			show_num_fuel((unsigned int)(fuel) * 6, info_led);
+		}
+		fuel_old = fuel;
+	}
+	if ((sp != sp_old) || (dot_mode != mode_old)){
+		calc_sp_leds(&sp, mode_demo, led_sp_demo);
+		if (sp != sp_old){
+			show_num_sp((unsigned int)(sp) * 10, info_led);
+		}
+		sp_old = sp;
+	}
+	mode_old = dot_mode;
+
+	leds_demo.word[LED_W_SW0] = led_sw[LED_W_SW0];
+	leds_demo.word[LED_W_SW1] = led_sw[LED_W_SW1];
+	if (fill_led_table(&leds_demo, *led_sw11_color, mx)){
+		show_leds(mx, info_led);
+	}
+}
+
+
+
+/**
+ * @brief Applies a decoded telemetry frame to the RPM/fuel/speed dials.
+ *        The values are mapped through the calibrated dial tables, with
+ *        linear interpolation between the calibrated points, so the dials
+ *        follow the stream with finer resolution than the rotary encoders.
+ *        No CAN-Bus message is sent here: the calibrated values are stored
+ *        in dial_want, send_telemetry_can() sends the ones that changed.
+ *        The 7-seg led displays / dial leds are updated only for values
+ *        that changed.
+ *
+ * @param telem The decoded telemetry frame to apply.
+ * @param telem_old The previously applied telemetry frame.
+ * @param dial_want An array of 3 unsigned characters, which receives the
+ *                  RPM/fuel/speed dial values to send over CAN-Bus.
+ * @param rpm Number of RPM dial leds that are on, updated from the stream.
+ * @param fuel Number of fuel dial leds that are on, updated from the stream.
+ * @param sp Number of speed dial leds that are on, updated from the stream.
+ * @param mode Array of bolean values for RPM/fuel/sp dial leds selected mode
+ *             of appearance.
+ * @param led_rpm Packed RPM dial leds (bit n = led n), will be updated.
+ * @param led_fuel Packed fuel dial leds (bit n = led n), will be updated.
+ * @param led_sp Packed speed dial leds (bit n = led n), will be updated.
+ * @param rpm_dial RPM calibrated dial values.
+ * @param fuel_dial Fuel calibrated dial values.
+ * @param sp_dial Speed calibrated dial values.
+ * @param info_led An unsigned char value, of which the upper nibble stores
+ *                 information about the 4 status active-low leds.
+ *
+ * @return true if any dial led changed and the led table must be refreshed.
+ */
+
+bool apply_telemetry(TELEM_DATA *telem, TELEM_DATA *telem_old, unsigned char dial_want[], unsigned char *rpm, unsigned char *fuel, unsigned char *sp, bool mode[], u32 *led_rpm, u32 *led_fuel, u32 *led_sp, const unsigned char rpm_dial[], const unsigned char fuel_dial[], const unsigned char sp_dial[], unsigned char *info_led){
+	bool changed = false;
+	unsigned char led;
+
+	// RPM
+	dial_want[0] = telem_mapDial(telem->rpm, TELEM_RPM_STEP, rpm_dial, rpm_max);
+	if (telem->rpm != telem_old->rpm){
+		show_num_rpm(telem->rpm, info_led);
+		led = telem_ledIndex(telem->rpm, TELEM_RPM_STEP, rpm_max);
+		if (led != *rpm){
+			*rpm = led;
+			calc_rpm_leds(rpm, mode, led_rpm);
+			changed = true;
+		}
+	}
+
+	// Fuel
+	dial_want[1] = telem_mapDial(telem->fuel, TELEM_FUEL_STEP, fuel_dial, fuel_max);
+	if (telem->fuel != telem_old->fuel){
+		show_num_fuel(telem->fuel, info_led);
+		led = telem_ledIndex(telem->fuel, TELEM_FUEL_STEP, fuel_max);
+		if (led != *fuel){
+			*fuel = led;
+			calc_fuel_leds(fuel, mode, led_fuel);
+			changed = true;
+		}
+	}
+
+	// Speed
+	dial_want[2] = telem_mapDial(telem->sp, TELEM_SP_STEP, sp_dial, sp_max);
+	if (telem->sp != telem_old->sp){
+		show_num_sp(telem->sp, info_led);
+		led = telem_ledIndex(telem->sp, TELEM_SP_STEP, sp_max);
+		if (led != *sp){
+			*sp = led;
+			calc_sp_leds(sp, mode, led_sp);
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+
+
+/**
+ * @brief Applies the indicator bits of a decoded telemetry frame to the
+ *        switch leds listed in telem_flagSw, and to their indications on
+ *        the Instrument Panel Cluster. No CAN-Bus message is sent here: the
+ *        indication groups that contain a changed bit are returned, and
+ *        send_telemetry_can() sends them.
+ *
+ * @param telem The decoded telemetry frame to apply.
+ * @param telem_old The previously applied telemetry frame.
+ * @param led_sw Packed switch leds (bit n = switch n, LED_GET / LED_PUT),
+ *               will be updated.
+ * @param led_sw_old Packed previous state of the switch leds, will be updated, so that the switch
+ *                   handling does not send the change again.
+ * @param lights CAN-Bus byte 3 and bit position of each switch indication.
+ * @param lights_status An array of unsigned characters that keeps track of
+ *                      the state of the switch leds, grouped (per index) in
+ *                      line with the CAN-Bus message byte 3
+ * @param info_led An unsigned char value, of which the upper nibble stores
+ *                 information about the 4 status active-low leds.
+ *                 Its bit 6 is connected to the "Switch" led.
+ *
+ * @return Bit mask of the CAN-Bus indication groups that changed (bit n =
+ *         group n), 0 if no switch led changed. Any other value means the
+ *         led table must be refreshed.
+ */
+
+unsigned char apply_telemetry_flags(TELEM_DATA *telem, TELEM_DATA *telem_old, u32 led_sw[], u32 led_sw_old[], unsigned char lights[][2], unsigned char lights_status[], unsigned char *info_led){
+	unsigned char changed = telem->flags ^ telem_old->flags;
+	unsigned char groups = 0;     // bit n set: CAN-Bus indication group n must be sent
+
+	if (changed == 0)
+		return 0;
+
+	for (unsigned char bit = 0; bit < TELEM_FLAG_CNT; bit++){
+		if (changed & (0x01 << bit)){
+			unsigned char sw_i = telem_flagSw[bit];
+			bool on = (telem->flags >> bit) & 0x01;
+			LED_PUT(led_sw, sw_i, on);
+			LED_PUT(led_sw_old, sw_i, on);
+			if (on)
+				lights_status[lights[sw_i][0]] |= (0x01 << lights[sw_i][1]);
+			else
+				lights_status[lights[sw_i][0]] &= ~(0x01 << lights[sw_i][1]);
+			groups |= 0x01 << lights[sw_i][0];
+		}
+	}
+
+	*info_led = (*info_led) & 0xB0;   // clear bit 6 (Switch)
+	return groups;
+}
+
+
+
+/**
+ * @brief Queues the next CAN-Bus message that the telemetry stream needs:
+ *        a dial whose value differs from the last one sent, or a changed
+ *        indication group. The dials and the indication groups are checked
+ *        in turn, starting after the last one sent, so a fast changing dial
+ *        does not hold back the others. The message carries the latest value,
+ *        the changes in between are not sent. Called once per
+ *        TELEM_CAN_PERIOD, so the stream rate does not set the bus load.
+ *
+ * @param dial_want The RPM/fuel/speed dial values of the stream.
+ * @param dial_sent The last RPM/fuel/speed dial values sent, will be updated.
+ * @param lamps_pending Bit mask of the indication groups to send (bit n =
+ *                      group n), will be updated.
+ * @param lights_status An array of unsigned characters that keeps track of
+ *                      the state of the switch leds, grouped (per index) in
+ *                      line with the CAN-Bus message byte 3
+ * @param slot Next message to check: 0-2 dials, 3-7 indication groups 1-5,
+ *             will be updated.
+ *
+ * @return true if a message was queued.
+ */
+
+bool send_telemetry_can(unsigned char dial_want[], unsigned char dial_sent[], unsigned char *lamps_pending, unsigned char lights_status[], unsigned char *slot){
+	const unsigned char dial_cpid[3] = {GMLAN_DC_CPID_RPM, GMLAN_DC_CPID_FUEL, GMLAN_DC_CPID_SPEED};
+	CAN_FRAME frame;
+
+	for (unsigned char i = 0; i < TELEM_CAN_SLOTS; i++){
+		unsigned char n = (*slot + i) % TELEM_CAN_SLOTS;
+		if (n < 3){                                         // CAN-Bus "dials" message
+			if (dial_want[n] == dial_sent[n])
+				continue;
+			gmlan_ipcDial(&frame, dial_cpid[n], dial_want[n]);
+			if (!queueCANMessage(&can_ipc, &frame))
+				return false;                               // queue full, retry next period
+			dial_sent[n] = dial_want[n];
 		}
-		usleep(demoDelayTime5 * 1000);
-		if (!demo_mode) {
-			break;
+		else{                                               // CAN-Bus "indications" message
+			unsigned char group = n - 2;
+			if (((*lamps_pending) & (0x01 << group)) == 0)
+				continue;
+			gmlan_ipcLamps(&frame, group, lights_status[group]);
+			if (!queueCANMessage(&can_ipc, &frame))
+				return false;
+			*lamps_pending &= ~(0x01 << group);
 		}
+		*slot = (n + 1) % TELEM_CAN_SLOTS;
+		return true;
 	}
+	return false;
 }
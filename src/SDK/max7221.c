@@ -8,6 +8,21 @@
 
 #include "max7221.h"
 
+// Shadow framebuffer of the digit registers.
+// max_shadow holds what each MAX7221 already displays, max_frame what the application wants.
+// A bit in max_dirty is set for every digit where the two differ, flushMAX7221() sends only those.
+static u8 max_shadow[MAX_CNT][8];
+static u8 max_frame[MAX_CNT][8];
+static u8 max_dirty[MAX_CNT];
+static u16 max_requested;		// deferred writes since the last flush
+static MAX7221_STATS max_stats;
+
+// Chain frame, 2 bytes per MAX7221, the last chip of the chain (MAX_CNT - 1) is shifted out first.
+// Every slot not in use holds a NO-OP (opcode and data 0x00). A command is written into its slot
+// and the slot is put back to NO-OP after the transfer, so no frame is cleared before a write.
+static u8 max_chain[MAX_CNT * 2];
+#define MAX_SLOT(icNumber)   ((MAX_CNT - 1 - (icNumber)) * 2)
+
 
 void initMAX7221(u8 icNumber) {
 	XSpi_SetSlaveSelect(&SpiInstance, 0x02);					    // Select CS for MAX7221s
@@ -16,8 +31,12 @@ void initMAX7221(u8 icNumber) {
 
 
 	// Turn off all LEDs
-	for (u8 digit = 0; digit < 8; digit++)
+	for (u8 digit = 0; digit < 8; digit++) {
 		sendSPICommand(icNumber, MAX7221_DIGIT0_REG + digit, 0x00);
+		max_shadow[icNumber][digit] = 0x00;
+		max_frame[icNumber][digit] = 0x00;
+	}
+	max_dirty[icNumber] = 0x00;
 
 	sendSPICommand(icNumber, MAX7221_DECODE_MODE_REG, MAX7221_DECODE_NONE); // Disable digit decoding
 	sendSPICommand(icNumber, MAX7221_INTENSITY_REG, MAX7221_INTENSITY_LEVEL); // Set intensity level
@@ -26,25 +45,95 @@ void initMAX7221(u8 icNumber) {
 	sendSPICommand(icNumber, MAX7221_SHUTDOWN_REG, MAX7221_SHUTDOWN_NORMAL); // Bring MAX7221 out of shutdown mode
 }
 
+void initAllMAX7221() {
+	// Same as initMAX7221() for every MAX7221, each command reaches all chips in one transfer
+	XSpi_SetSlaveSelect(&SpiInstance, 0x02);					    // Select CS for MAX7221s
+	sendSPICommandAll(MAX7221_SHUTDOWN_REG, MAX7221_SHUTDOWN_MODE); // Put MAX7221s into shutdown mode
+	usleep(10000);	// delay 10 msec
+
+	// Turn off all LEDs
+	for (u8 digit = 0; digit < 8; digit++)
+		sendSPICommandAll(MAX7221_DIGIT0_REG + digit, 0x00);
+	for (u8 icNumber = 0; icNumber < MAX_CNT; icNumber++) {
+		for (u8 digit = 0; digit < 8; digit++) {
+			max_shadow[icNumber][digit] = 0x00;
+			max_frame[icNumber][digit] = 0x00;
+		}
+		max_dirty[icNumber] = 0x00;
+	}
+
+	sendSPICommandAll(MAX7221_DECODE_MODE_REG, MAX7221_DECODE_NONE); // Disable digit decoding
+	sendSPICommandAll(MAX7221_INTENSITY_REG, MAX7221_INTENSITY_LEVEL); // Set intensity level
+	sendSPICommandAll(MAX7221_SCAN_LIMIT_REG, MAX7221_SCAN_LIMIT_ALL); // Set scan limit to all digits
+	sendSPICommandAll(MAX7221_DISPLAY_TEST_REG, MAX7221_DISPLAY_TEST_NORMAL); // Disable display test
+	sendSPICommandAll(MAX7221_SHUTDOWN_REG, MAX7221_SHUTDOWN_NORMAL); // Bring MAX7221s out of shutdown mode
+}
+
 void setIntensity(u8 icNumber, u8 intensity) {
 	XSpi_SetSlaveSelect(&SpiInstance, 0x02);					    // Select CS for MAX7221s
 	sendSPICommand(icNumber, MAX7221_INTENSITY_REG, intensity); // Set intensity
 }
 
+void setIntensityAll(u8 intensity) {
+	XSpi_SetSlaveSelect(&SpiInstance, 0x02);					    // Select CS for MAX7221s
+	sendSPICommandAll(MAX7221_INTENSITY_REG, intensity); // Set intensity of all MAX7221s
+}
+
 void setRow(u8 icNumber, u8 digit, u8 value) {
 	XSpi_SetSlaveSelect(&SpiInstance, 0x02);					    // Select CS for MAX7221s
 	sendSPICommand(icNumber, MAX7221_DIGIT0_REG + digit, value);
+
+	// Immediate write, keep the shadow framebuffer in step
+	max_shadow[icNumber][digit] = value;
+	max_frame[icNumber][digit] = value;
+	max_dirty[icNumber] &= ~(1 << digit);
+}
+
+void setRowAll(u8 digit, const u8 value[]) {
+	// Write digit of every MAX7221 in one transfer, value[icNumber] per chip
+	u8 opcode[MAX_CNT];
+	XSpi_SetSlaveSelect(&SpiInstance, 0x02);					    // Select CS for MAX7221s
+	for (u8 icNumber = 0; icNumber < MAX_CNT; icNumber++) {
+		opcode[icNumber] = MAX7221_DIGIT0_REG + digit;
+		max_shadow[icNumber][digit] = value[icNumber];
+		max_frame[icNumber][digit] = value[icNumber];
+		max_dirty[icNumber] &= ~(1 << digit);
+	}
+	sendSPIChain(opcode, value);
 }
 
 void sendSPICommand(u8 icNumber, u8 opcode, u8 data) {
-	u8 buffer_size;
-	buffer_size = MAX_CNT * 2;	// 16 bits (2 bytes) per MAX7221
-	u8 WriteBuffer[buffer_size];
-	for (u8 i = 0; i < buffer_size; i++)
-		WriteBuffer[i] = 0;
+	// Command to one MAX7221, the other chips of the chain get a NO-OP
+	u8 *slot = &max_chain[MAX_SLOT(icNumber)];
+	slot[0] = opcode;
+	slot[1] = data;
 
-	WriteBuffer[4 - (icNumber * 2)] = opcode;			// = ((3 - icNumber) * 2) - 2
-	WriteBuffer[5 - (icNumber * 2)] = data;			// = ((3 - icNumber) * 2) - 1
+	send_spi_data(max_chain, sizeof(max_chain));
+
+	slot[0] = MAX7221_NO_OP_REG;
+	slot[1] = 0x00;
+}
+
+void sendSPIChain(const u8 opcode[], const u8 data[]) {
+	// One command per MAX7221 in a single transfer: opcode[icNumber] / data[icNumber].
+	// The last chip of the chain (MAX_CNT - 1) is shifted out first.
+	// Use MAX7221_NO_OP_REG for a chip that must not change.
+	u8 WriteBuffer[MAX_CNT * 2];
+	for (u8 icNumber = 0; icNumber < MAX_CNT; icNumber++) {
+		WriteBuffer[MAX_SLOT(icNumber)] = opcode[icNumber];
+		WriteBuffer[MAX_SLOT(icNumber) + 1] = data[icNumber];
+	}
+
+	send_spi_data(WriteBuffer, sizeof(WriteBuffer));
+}
+
+void sendSPICommandAll(u8 opcode, u8 data) {
+	// Same command to every MAX7221 in one transfer
+	u8 WriteBuffer[MAX_CNT * 2];
+	for (u8 i = 0; i < MAX_CNT * 2; i += 2) {
+		WriteBuffer[i] = opcode;
+		WriteBuffer[i + 1] = data;
+	}
 
 	send_spi_data(WriteBuffer, sizeof(WriteBuffer));
 }
@@ -60,17 +149,91 @@ void setDecode(u8 icNumber, u8 value) {
 	sendSPICommand(icNumber, MAX7221_DECODE_MODE_REG, value);
 }
 
-void setNum(u8 icNumber, u8 digit, u8 value) {
+void setDecodeAll(u8 value) {
 	XSpi_SetSlaveSelect(&SpiInstance, 0x02);					    // Select CS for MAX7221s
+	sendSPICommandAll(MAX7221_DECODE_MODE_REG, value);	// Set the decode mode register of all MAX7221s
+}
+
+void setNum(u8 icNumber, u8 digit, u8 value) {
 	// Display number in one segment (decode mode must be enabled on this segment)
-	sendSPICommand(icNumber, MAX7221_DIGIT0_REG + digit, value);
+	setRow(icNumber, digit, value);
+}
+
+void setRowDeferred(u8 icNumber, u8 digit, u8 value) {
+	// Write the digit into the framebuffer only, it is sent by the next flushMAX7221()
+	max_frame[icNumber][digit] = value;
+	if (value != max_shadow[icNumber][digit])
+		max_dirty[icNumber] |= (1 << digit);
+	else
+		max_dirty[icNumber] &= ~(1 << digit);
+	max_requested++;
+}
+
+void setNumDeferred(u8 icNumber, u8 digit, u8 value) {
+	// Deferred number in one segment (decode mode must be enabled on this segment)
+	setRowDeferred(icNumber, digit, value);
+}
+
+u16 flushMAX7221() {
+	// Send the digit registers that differ from what the MAX7221s hold, returns the number sent.
+	// A dirty digit is sent to all chips in one chain transfer, clean chips keep their NO-OP slot.
+	// Digits no chip needs are skipped, a transfer costs 2 bytes per chip.
+	u16 written = 0;
+	u8 transfers = 0;
+
+	XSpi_SetSlaveSelect(&SpiInstance, 0x02);					    // Select CS for MAX7221s
+	for (u8 digit = 0; digit < 8; digit++) {
+		u8 mask = 1 << digit;
+		u16 cnt = 0;
+		u32 filled = 0;						// chips whose slot holds a command
+		for (u8 icNumber = 0; icNumber < MAX_CNT; icNumber++) {
+			if (max_dirty[icNumber] & mask) {
+				max_chain[MAX_SLOT(icNumber)] = MAX7221_DIGIT0_REG + digit;
+				max_chain[MAX_SLOT(icNumber) + 1] = max_frame[icNumber][digit];
+				max_shadow[icNumber][digit] = max_frame[icNumber][digit];
+				max_dirty[icNumber] &= ~mask;
+				filled |= (u32)1 << icNumber;
+				cnt++;
+			}
+		}
+		if (cnt == 0)
+			continue;
+		send_spi_data(max_chain, sizeof(max_chain));
+		transfers++;
+		written += cnt;
+
+		while (filled != 0) {				// only the filled slots back to NO-OP, as sendSPICommand()
+			u8 *slot = &max_chain[MAX_SLOT(__builtin_ctz(filled))];
+			slot[0] = MAX7221_NO_OP_REG;
+			slot[1] = 0x00;
+			filled &= filled - 1;			// clear the lowest set bit
+		}
+	}
+
+	max_stats.frames++;
+	max_stats.requested += max_requested;
+	max_stats.written += written;
+	max_stats.transfers += transfers;
+	max_stats.last_saved = (max_requested > written) ? (max_requested - written) : 0;
+	max_requested = 0;
+	return written;
+}
+
+void invalidateMAX7221() {
+	// Contents of the MAX7221s unknown (e.g. after a power glitch): the next flush rewrites every digit
+	for (u8 icNumber = 0; icNumber < MAX_CNT; icNumber++)
+		max_dirty[icNumber] = 0xFF;
+}
+
+const MAX7221_STATS *statsMAX7221() {
+	return &max_stats;
 }
 
 
 void testMax7221() {
 	XSpi_SetSlaveSelect(&SpiInstance, 0x02);					    // Select CS for MAX7221s
 	u8 value = 0;
-	for (u8 k = 0; k < 3; k++) { // Iterate over each MAX7221
+	for (u8 k = 0; k < MAX_CNT; k++) { // Iterate over each MAX7221
 		for (u8 i = 0; i < 8; i++) { // Iterate over each digit
 			for (u8 j = 0; j < 8; j++) { // Iterate over each segment
 				value = 1 << j;
@@ -82,55 +245,45 @@ void testMax7221() {
 		}
 	}
 
-	for (u8 k = 0; k < 3; k++) { // Iterate over each MAX7221
-		for (u8 i = 0; i < 8; i++) { // Iterate over each digit
-			setRow(MAX_1 + k, i, 0xFF); // Turn on all segments of digit i
-	  }
+	u8 all_on[MAX_CNT];
+	u8 all_off[MAX_CNT];
+	for (u8 k = 0; k < MAX_CNT; k++) {
+		all_on[k] = 0xFF;
+		all_off[k] = 0x00;
 	}
+
+	for (u8 i = 0; i < 8; i++) // Iterate over each digit, all MAX7221s at once
+		setRowAll(i, all_on); // Turn on all segments of digit i
 	sleep(1);	// delay 1 sec
 
-	for (u8 k = 0; k < 3; k++) { // Iterate over each MAX7221
-		for (u8 i = 0; i < 8; i++) { // Iterate over each digit
-			setRow(MAX_1 + k, i, 0x00); // Turn off all segments of digit i
-		}
-	}
+	for (u8 i = 0; i < 8; i++) // Iterate over each digit, all MAX7221s at once
+		setRowAll(i, all_off); // Turn off all segments of digit i
 	sleep(1);	// delay 1 sec
 
-	for (u8 k = 0; k < 3; k++) { // Iterate over each MAX7221
-		for (u8 i = 0; i < 8; i++) { // Iterate over each digit
-			setRow(MAX_1 + k, i, 0xFF); // Turn on all segments of digit i
-		}
-	}
+	for (u8 i = 0; i < 8; i++) // Iterate over each digit, all MAX7221s at once
+		setRowAll(i, all_on); // Turn on all segments of digit i
 	//for (u32 delay_time = 0; delay_time < 8000000; delay_time++) {}	// 120us per 1000 iterations => 960ms
 	sleep(1);	// delay 1 sec
 
-	for (u8 k = 0; k < 3; k++) { // Iterate over each MAX7221
-		for (u8 i = 0; i < 8; i++) { // Iterate over each digit
-			setRow(MAX_1 + k, i, 0x00); // Turn off all segments of digit i
-		}
-	}
+	for (u8 i = 0; i < 8; i++) // Iterate over each digit, all MAX7221s at once
+		setRowAll(i, all_off); // Turn off all segments of digit i
 	sleep(1);	// delay 1 sec
 }
 
 void fastTestMax7221() {
 	XSpi_SetSlaveSelect(&SpiInstance, 0x02);					    // Select CS for MAX7221s
-	for (u8 j = 0; j < 3; j++) { // Set which MAX7221 will be On, others Off
-		for (u8 k = 0; k < 3; k++) { // Iterate over each MAX7221
-			for (u8 i = 0; i < 8; i++) { // Iterate over each digit
-				if (k == j){
-					setRow(MAX_1 + k, i, 0xFF); // Turn on all segments of digit i
-				}else{
-					setRow(MAX_1 + k, i, 0x00); // Turn off all segments of digit i
-				}
-			}
-		}
+	u8 value[MAX_CNT];
+	for (u8 j = 0; j < MAX_CNT; j++) { // Set which MAX7221 will be On, others Off
+		for (u8 k = 0; k < MAX_CNT; k++) // Iterate over each MAX7221
+			value[k] = (k == j) ? 0xFF : 0x00; // all segments on / off
+		for (u8 i = 0; i < 8; i++) // Iterate over each digit, all MAX7221s at once
+			setRowAll(i, value);
 		usleep(250000);	// delay 250 msec
 	}
 
-	for (u8 k = 0; k < 3; k++) { // Iterate over each MAX7221
-		for (u8 i = 0; i < 8; i++) { // Iterate over each digit
-			setRow(MAX_1 + k, i, 0x00); // Turn off all segments of digit i
-		}
-	}
+	for (u8 k = 0; k < MAX_CNT; k++) // Iterate over each MAX7221
+		value[k] = 0x00;
+	for (u8 i = 0; i < 8; i++) // Iterate over each digit, all MAX7221s at once
+		setRowAll(i, value); // Turn off all segments of digit i
  	usleep(250000);	// delay 250 msec
 }
@@ -15,13 +15,19 @@
 #include "xspi.h"
 #include "xstatus.h"
 #include "sleep.h"
+#include "stdbool.h"
 #include "spi_api.h"	// include before ICs header files
 
 // MAX7221 constants
 #define MAX_1				 0x00
 #define MAX_2				 0x01
 #define MAX_3				 0x02
-#define MAX_CNT			 0x03		// number of MAX7221 ICs
+#ifndef MAX_CNT
+#define MAX_CNT			 0x03		// number of MAX7221 ICs on the chain, override at build time (-DMAX_CNT=n)
+#endif
+#if (MAX_CNT < 1) || (MAX_CNT > 32)
+#error "MAX_CNT: 1 to 32 MAX7221s on the chain"
+#endif
 
 #define MAX7221_INTENSITY_REG  0x0A
 #define MAX7221_NO_OP_REG    0x00
@@ -46,13 +52,33 @@
 #define MAX7221_SHUTDOWN_MODE 0x00
 #define MAX7221_DISPLAY_TEST_NORMAL 0x00
 
+// Shadow framebuffer statistics, see flushMAX7221()
+typedef struct {
+	u32 frames;			// flushes
+	u32 requested;		// digit register writes requested with setRowDeferred()/setNumDeferred()
+	u32 written;		// digit register writes sent over SPI
+	u32 transfers;		// SPI transfers used for them (one per digit, all chips at once)
+	u16 last_saved;		// writes saved by the last flush
+} MAX7221_STATS;
+
 
 void initMAX7221(u8 icNumber);
+void initAllMAX7221();
 void setIntensity(u8 icNumber, u8 intensity);
+void setIntensityAll(u8 intensity);
 void setRow(u8 icNumber, u8 digit, u8 value);
+void setRowAll(u8 digit, const u8 value[]);
 void sendSPICommand(u8 icNumber, u8 opcode, u8 data);
+void sendSPIChain(const u8 opcode[], const u8 data[]);
+void sendSPICommandAll(u8 opcode, u8 data);
 void setDecode(u8 icNumber, u8 value);
+void setDecodeAll(u8 value);
 void setNum(u8 icNumber, u8 digit, u8 value);
+void setRowDeferred(u8 icNumber, u8 digit, u8 value);
+void setNumDeferred(u8 icNumber, u8 digit, u8 value);
+u16 flushMAX7221();
+void invalidateMAX7221();
+const MAX7221_STATS *statsMAX7221();
 void testMax7221();
 void fastTestMax7221();
 
@@ -9,6 +9,36 @@
 
 const u8 MCP[3] = {MCP_addr_1, MCP_addr_2, MCP_addr_3};
 
+// Configuration of each IC, IODIRA to GPPUB, written in one burst by initMCP23S17().
+// IOCON is mirrored at 0x0B with BANK = 0, so it appears twice.
+static const u8 mcp_config[MCP_CNT][MCP_CONFIG_LEN] = {
+	//IODIR A, B  IOPOL A, B  GPINTEN A, B  DEFVAL A, B  INTCON A, B  IOCON (x2)                                  GPPU A, B
+	{0xFF, 0xFF,  0x00, 0x00, 0xFF, 0xFF,   0x00, 0x00,  0x00, 0x00,  MCP23S17_IOCON_VALUE, MCP23S17_IOCON_VALUE, 0x00, 0x00},	// IC 1: all inputs
+	{0xFF, 0xFF,  0x00, 0x00, 0xFF, 0xFF,   0x00, 0x00,  0x00, 0x00,  MCP23S17_IOCON_VALUE, MCP23S17_IOCON_VALUE, 0x00, 0x00},	// IC 2: all inputs
+	{0xFF, 0x0F,  0x00, 0x00, 0xFF, 0x0F,   0x00, 0x00,  0x00, 0x00,  MCP23S17_IOCON_VALUE, MCP23S17_IOCON_VALUE, 0x00, 0x00}	// IC 3: port B bits 7-4 are outputs (info leds)
+};
+
+// Write-through cache of the output latches, [IC][port A / B]. A port is read (OLAT) before its first
+// masked update, so the bits outside the mask are kept.
+static u8 mcp_olat[MCP_CNT][2];
+static u8 mcp_olatValid[MCP_CNT];		// bit 0 port A, bit 1 port B
+static u32 mcp_cacheHits = 0;			// writes suppressed, the latch already held the value
+static u32 mcp_cacheMisses = 0;			// writes sent
+
+// Background configuration check, one IC per MCP_CHECK_PERIOD_MS (mcp_checkTick / mcp_checkTask)
+static u16 mcp_configSum[MCP_CNT];		// checksum of each mcp_config[] row
+static volatile u16 mcp_check_ms = 0;	// msec counted by mcp_checkTick() since the last check
+static u8 mcp_check_ic = 0;				// IC of the next check
+static u32 mcp_checks = 0;
+static u32 mcp_corrupt[MCP_CNT];		// checks that found a configuration register changed
+
+// Register names for dumpRegMCP23S17(), BANK = 0 addresses
+static const char *mcp_regName[MCP_BURST_MAX] = {
+	"IODIRA", "IODIRB", "IOPOLA", "IOPOLB", "GPINTENA", "GPINTENB", "DEFVALA", "DEFVALB",
+	"INTCONA", "INTCONB", "IOCON", "IOCON", "GPPUA", "GPPUB", "INTFA", "INTFB",
+	"INTCAPA", "INTCAPB", "GPIOA", "GPIOB", "OLATA", "OLATB"
+};
+
 
 void mcp_reset() {
 	XGpio_DiscreteWrite(&Gpio, GPIO_CHANNEL, 0x00000000);		// GPIO bit 0 connects to MCP23S17 reset active-low
@@ -42,19 +72,48 @@ u8 mcp_readData(u8 addrWR, u8 opcode) {
 	return ReadBuffer[buffer_size - 1];
 }
 
-// Function to write to GPIO Port A or Port B
+// Function to write to GPIO Port A or Port B. Through the output latch cache: a value the latch
+// already holds is not sent again
 void mcp_setPort(u8 icNumber, u8 port, u8 value) {
+	u8 p = (port == 'B') ? 1 : 0;
+
+	if ((mcp_olatValid[icNumber] & (1 << p)) && (mcp_olat[icNumber][p] == value)) {
+		mcp_cacheHits++;
+		return;
+	}
+
 	XSpi_SetSlaveSelect(&SpiInstance, 0x01);					    // Select CS for MCP23S17s
 
 	u8 MCPaddrW = MCP[icNumber] << 1 | 0x40;
-	u8 opcode;
-	if (port == 'A') {
-		opcode = MCP23S17_GPIOA; // Write to GPIOA
-	} else if (port == 'B') {
-		opcode = MCP23S17_GPIOB; // Write to GPIOB
+	mcp_writeData(MCPaddrW, p ? MCP23S17_GPIOB : MCP23S17_GPIOA, value);
+	mcp_olat[icNumber][p] = value;
+	mcp_olatValid[icNumber] |= 1 << p;
+	mcp_cacheMisses++;
+}
+
+// Function to write only the bits of mask of GPIO Port A or Port B (e.g. the output nibble),
+// the other latch bits keep their value
+void mcp_setPortMasked(u8 icNumber, u8 port, u8 mask, u8 value) {
+	u8 p = (port == 'B') ? 1 : 0;
+
+	if (!(mcp_olatValid[icNumber] & (1 << p))) {
+		XSpi_SetSlaveSelect(&SpiInstance, 0x01);					// Select CS for MCP23S17s
+		mcp_olat[icNumber][p] = mcp_readData(MCP[icNumber] << 1 | 0x41, p ? MCP23S17_OLATB : MCP23S17_OLATA);
+		mcp_olatValid[icNumber] |= 1 << p;
 	}
+	mcp_setPort(icNumber, port, (mcp_olat[icNumber][p] & ~mask) | (value & mask));
+}
 
-	mcp_writeData(MCPaddrW, opcode, value);
+// Function to forget the cached output latches, the next write of each port is sent
+void mcp_cacheInvalidate() {
+	for (u8 ic = 0; ic < MCP_CNT; ic++)
+		mcp_olatValid[ic] = 0;
+}
+
+// Function to read the output latch cache counters
+void mcp_cacheStats(u32 *hits, u32 *misses) {
+	*hits = mcp_cacheHits;
+	*misses = mcp_cacheMisses;
 }
 
 // Function to read GPIO Port A or Port B
@@ -74,214 +133,231 @@ u8 mcp_getPort(u8 icNumber, u8 port) {
     return value;
 }
 
+// Write count consecutive registers starting at opcode in one transaction (sequential mode, IOCON.SEQOP clear)
+void mcp_writeBurst(u8 addrWR, u8 opcode, const u8 *data, u8 count) {
+	u8 WriteBuffer[MCP_BURST_MAX + 2];
+
+	if (count > MCP_BURST_MAX)
+		count = MCP_BURST_MAX;
+	WriteBuffer[0] = addrWR;
+	WriteBuffer[1] = opcode;
+	for (u8 i = 0; i < count; i++)
+		WriteBuffer[i + 2] = data[i];
+
+	send_spi_data(WriteBuffer, count + 2);
+}
+
+// Read count consecutive registers starting at opcode in one transaction (sequential mode, IOCON.SEQOP clear)
+void mcp_readBurst(u8 addrRD, u8 opcode, u8 *data, u8 count) {
+	u8 WriteBuffer[MCP_BURST_MAX + 2] = {0};
+	u8 ReadBuffer[MCP_BURST_MAX + 2];
+
+	if (count > MCP_BURST_MAX)
+		count = MCP_BURST_MAX;
+	WriteBuffer[0] = addrRD;
+	WriteBuffer[1] = opcode;
+
+	send_spi_data_read(WriteBuffer, ReadBuffer, count + 2);
+	for (u8 i = 0; i < count; i++)
+		data[i] = ReadBuffer[i + 2];
+}
+
+// Function to read GPIO Port A and Port B in one 4-byte transaction, port A in the low byte
+u16 mcp_getPorts(u8 icNumber) {
+	XSpi_SetSlaveSelect(&SpiInstance, 0x01);					    // Select CS for MCP23S17s
+
+	u8 value[2];
+	mcp_readBurst(MCP[icNumber] << 1 | 0x41, MCP23S17_GPIOA, value, 2);
+	return value[0] | (value[1] << 8);
+}
+
+// Function to read the ports of all MCP23S17s, one transaction per IC.
+// Returns a 48-bit snapshot, IC n in bits 16n+15..16n (see MCP_SNAP_PORT)
+u64 mcp_scanPorts() {
+	u64 snap = 0;
+
+	for (u8 ic = 0; ic < MCP_CNT; ic++)
+		snap |= (u64)mcp_getPorts(ic) << (16 * ic);
+	return snap;
+}
+
+// Function to capture the inputs of one MCP23S17 after an interrupt.
+// INTF is read first (4-byte transaction), only an IC that fired is read further: INTCAP and GPIO
+// in one 6-byte transaction. Reading INTCAP clears the interrupt, GPIO then returns the live state.
+// Returns false if the IC did not fire.
+bool mcp_capture(u8 icNumber, MCP_CAPTURE *cap) {
+	XSpi_SetSlaveSelect(&SpiInstance, 0x01);					    // Select CS for MCP23S17s
+
+	u8 addr = MCP[icNumber] << 1 | 0x41;
+	u8 value[4];
+
+	mcp_readBurst(addr, MCP23S17_INTFA, value, 2);
+	cap->intf = value[0] | (value[1] << 8);
+	if (cap->intf == 0)
+		return false;
+
+	mcp_readBurst(addr, MCP23S17_INTCAPA, value, 4);			// INTCAPA, INTCAPB, GPIOA, GPIOB
+	cap->intcap = value[0] | (value[1] << 8);
+	cap->gpio = value[2] | (value[3] << 8);
+	return true;
+}
+
+// Function to capture the inputs of all MCP23S17s after an interrupt.
+// prev is the last known 48-bit snapshot: snap_cap gets the state latched at the interrupt,
+// snap_now the live state, ICs that did not fire keep their prev bits.
+// Returns a bit mask of the ICs that fired.
+u8 mcp_captureAll(u64 prev, u64 *snap_cap, u64 *snap_now) {
+	MCP_CAPTURE cap;
+	u8 fired = 0;
+
+	*snap_cap = prev;
+	*snap_now = prev;
+	for (u8 ic = 0; ic < MCP_CNT; ic++) {
+		if (!mcp_capture(ic, &cap))
+			continue;
+		u64 mask = (u64)0xFFFF << (16 * ic);
+		*snap_cap = (*snap_cap & ~mask) | ((u64)cap.intcap << (16 * ic));
+		*snap_now = (*snap_now & ~mask) | ((u64)cap.gpio << (16 * ic));
+		fired |= 1 << ic;
+	}
+	return fired;
+}
+
+// CRC-16/CCITT of a configuration block (a modulo 255 sum would not tell 0x00 from 0xFF)
+static u16 mcp_checksum(const u8 *data, u8 count) {
+	u16 crc = 0xFFFF;
+
+	for (u8 i = 0; i < count; i++) {
+		crc ^= (u16)data[i] << 8;
+		for (u8 bit = 0; bit < 8; bit++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
 // Function to initialize MCP23S17
 void initMCP23S17() {
 	XSpi_SetSlaveSelect(&SpiInstance, 0x01);					    // Select CS for MCP23S17s
 
-	// Initialize MCP23S17 devices
-	// Device 0x20 (Address for the 1st MCP23S17)
-	u8 addr_1 = MCP[0] << 1 | 0x40;
-	mcp_writeData(addr_1, MCP23S17_IODIRA, 0xFF);   // Set IODIRA (Port A direction) to 0xFF (all inputs)
-	mcp_writeData(addr_1, MCP23S17_IODIRB, 0xFF);   // Set IODIRB (Port B direction) to 0xFF (all inputs)
-	mcp_writeData(addr_1, MCP23S17_IOPOLA, 0x00);   // Set IOPOLA (Port A polarity) to 0x00 (no inversion)
-	mcp_writeData(addr_1, MCP23S17_IOPOLB, 0x00);   // Set IOPOLB (Port B polarity) to 0x00 (no inversion)
-	mcp_writeData(addr_1, MCP23S17_GPINTENA, 0xFF); // Enable interrupts on all Port A pins
-	mcp_writeData(addr_1, MCP23S17_GPINTENB, 0xFF); // Enable interrupts on all Port B pins
-	mcp_writeData(addr_1, MCP23S17_DEFVALA, 0x00);  // Default value for comparison on interrupts for Port A pins
-	mcp_writeData(addr_1, MCP23S17_DEFVALB, 0x00);  // Default value for comparison on interrupts for Port B pins
-	mcp_writeData(addr_1, MCP23S17_INTCONA, 0x00);  // Set interrupt-on-change control for Port A pins (compared against the previous pin value)
-	mcp_writeData(addr_1, MCP23S17_INTCONB, 0x00);  // Set interrupt-on-change control for Port B pins (compared against the previous pin value)
-	mcp_writeData(addr_1, MCP23S17_IOCON, 0x6A);    // Configure IOCON (I/O expander configuration) register
-	mcp_writeData(addr_1, MCP23S17_GPPUA, 0x00);    // Disable internal pull-up resistors for Port A pins
-	mcp_writeData(addr_1, MCP23S17_GPPUB, 0x00);    // Disable internal pull-up resistors for Port B pins
-
-	// Device 0x21 (Address for the 2nd MCP23S17)
-	u8 addr_2 = MCP[1] << 1 | 0x40;
-	mcp_writeData(addr_2, MCP23S17_IODIRA, 0xFF);   // Set IODIRA (Port A direction) to 0xFF (all inputs)
-	mcp_writeData(addr_2, MCP23S17_IODIRB, 0xFF);   // Set IODIRB (Port B direction) to 0xFF (all inputs)
-	mcp_writeData(addr_2, MCP23S17_IOPOLA, 0x00);   // Set IOPOLA (Port A polarity) to 0x00 (no inversion)
-	mcp_writeData(addr_2, MCP23S17_IOPOLB, 0x00);   // Set IOPOLB (Port B polarity) to 0x00 (no inversion)
-	mcp_writeData(addr_2, MCP23S17_GPINTENA, 0xFF); // Enable interrupts on all Port A pins
-	mcp_writeData(addr_2, MCP23S17_GPINTENB, 0xFF); // Enable interrupts on all Port B pins
-	mcp_writeData(addr_2, MCP23S17_DEFVALA, 0x00);  // Default value for comparison on interrupts for Port A pins
-	mcp_writeData(addr_2, MCP23S17_DEFVALB, 0x00);  // Default value for comparison on interrupts for Port B pins
-	mcp_writeData(addr_2, MCP23S17_INTCONA, 0x00);  // Set interrupt-on-change control for Port A pins (compared against the previous pin value)
-	mcp_writeData(addr_2, MCP23S17_INTCONB, 0x00);  // Set interrupt-on-change control for Port B pins (compared against the previous pin value)
-	mcp_writeData(addr_2, MCP23S17_IOCON, 0x6A);    // Configure IOCON (I/O expander configuration) register
-	mcp_writeData(addr_2, MCP23S17_GPPUA, 0x00);    // Disable internal pull-up resistors for Port A pins
-	mcp_writeData(addr_2, MCP23S17_GPPUB, 0x00);    // Disable internal pull-up resistors for Port B pins
-
-	// Device 0x22 (Address for the 3rd MCP23S17)
-	u8 addr_3 = MCP[2] << 1 | 0x40;
-	mcp_writeData(addr_3, MCP23S17_IODIRA, 0xFF);   // Set IODIRA (Port A direction) to 0xFF (all inputs)
-	mcp_writeData(addr_3, MCP23S17_IODIRB, 0x0F);   // Set IODIRB (Port B direction) to 0x0F (all inputs, except upper half nibble (bits 4-7) as outputs)
-	mcp_writeData(addr_3, MCP23S17_IOPOLA, 0x00);   // Set IOPOLA (Port A polarity) to 0x00 (no inversion)
-	mcp_writeData(addr_3, MCP23S17_IOPOLB, 0x00);   // Set IOPOLB (Port B polarity) to 0x00 (no inversion)
-	mcp_writeData(addr_3, MCP23S17_GPINTENA, 0xFF); // Enable interrupts on all Port A pins
-	mcp_writeData(addr_3, MCP23S17_GPINTENB, 0x0F); // Enable interrupts on all Port B (input) pins
-	mcp_writeData(addr_3, MCP23S17_DEFVALA, 0x00);  // Default value for comparison on interrupts for Port A pins
-	mcp_writeData(addr_3, MCP23S17_DEFVALB, 0x00);  // Default value for comparison on interrupts for Port B pins
-	mcp_writeData(addr_3, MCP23S17_INTCONA, 0x00);  // Set interrupt-on-change control for Port A pins (compared against the previous pin value)
-	mcp_writeData(addr_3, MCP23S17_INTCONB, 0x00);  // Set interrupt-on-change control for Port B pins (compared against the previous pin value)
-	mcp_writeData(addr_3, MCP23S17_IOCON, 0x6A);    // Configure IOCON (I/O expander configuration) register
-	mcp_writeData(addr_3, MCP23S17_GPPUA, 0x00);    // Disable internal pull-up resistors for Port A pins
-	mcp_writeData(addr_3, MCP23S17_GPPUB, 0x00);    // Disable internal pull-up resistors for Port B pins
+	// IOCON first: after reset HAEN is clear and every IC ignores its address pins,
+	// so write it to all ICs before the per IC bursts
+	for (u8 ic = 0; ic < MCP_CNT; ic++)
+		mcp_writeData(MCP[ic] << 1 | 0x40, MCP23S17_IOCON, MCP23S17_IOCON_VALUE);
+
+	// Then the whole configuration, IODIRA to GPPUB, one sequential burst per IC
+	for (u8 ic = 0; ic < MCP_CNT; ic++)
+		mcp_writeBurst(MCP[ic] << 1 | 0x40, MCP23S17_IODIRA, mcp_config[ic], MCP_CONFIG_LEN);
+
+	mcp_cacheInvalidate();
+	for (u8 ic = 0; ic < MCP_CNT; ic++)
+		mcp_configSum[ic] = mcp_checksum(mcp_config[ic], MCP_CONFIG_LEN);
 }
 
 // Function to read MCP23S17 interrupt captured registers
 void mcp_intFrame(u8 *intFrame) {
 	XSpi_SetSlaveSelect(&SpiInstance, 0x01);					    // Select CS for MCP23S17s
 
-	// Device 0x20 (Address for the 1st MCP23S17)
-	u8 addr_1 = MCP[0] << 1 | 0x41;
-	* intFrame    = mcp_readData(addr_1, MCP23S17_INTCAPA);   // Read INTCAPA (Port A interrupt captured register)
-	*(intFrame+1) = mcp_readData(addr_1, MCP23S17_INTCAPB);   // Read INTCAPB (Port B interrupt captured register)
+	// Read INTCAPA & INTCAPB (Port A & B interrupt captured registers) of each IC in one transaction
+	for (u8 ic = 0; ic < MCP_CNT; ic++)
+		mcp_readBurst(MCP[ic] << 1 | 0x41, MCP23S17_INTCAPA, intFrame + 2 * ic, 2);
+}
 
-	// Device 0x21 (Address for the 2nd MCP23S17)
-	u8 addr_2 = MCP[1] << 1 | 0x41;
-	*(intFrame+2) = mcp_readData(addr_2, MCP23S17_INTCAPA);   // Read INTCAPA (Port A interrupt captured register)
-	*(intFrame+3) = mcp_readData(addr_2, MCP23S17_INTCAPB);   // Read INTCAPB (Port B interrupt captured register)
+// Function to read the register file of one MCP23S17 (MCP_BURST_MAX registers, IODIRA to OLATB) in one burst
+void mcp_readBank(u8 icNumber, u8 *bank) {
+	XSpi_SetSlaveSelect(&SpiInstance, 0x01);					    // Select CS for MCP23S17s
 
-	// Device 0x22 (Address for the 3rd MCP23S17)
-	u8 addr_3 = MCP[2] << 1 | 0x41;
-	*(intFrame+4) = mcp_readData(addr_3, MCP23S17_INTCAPA);   // Read INTCAPA (Port A interrupt captured register)
-	*(intFrame+5) = mcp_readData(addr_3, MCP23S17_INTCAPB);   // Read INTCAPB (Port B interrupt captured register)
+	mcp_readBurst(MCP[icNumber] << 1 | 0x41, MCP23S17_IODIRA, bank, MCP_BURST_MAX);
 }
 
-// Function to dump MCP23S17 register file
-void dumpRegMCP23S17() {
-	XSpi_SetSlaveSelect(&SpiInstance, 0x01);					    // Select CS for MCP23S17s
+// Function to compare a register file read by mcp_readBank() with the configuration table.
+// Returns a bit mask of the configuration registers that differ (bit n = register n), 0 if none
+u16 mcp_verify(u8 icNumber, const u8 *bank) {
+	u16 diff = 0;
 
-	u8 value;
-	// Device 0x20 (Address for the 1st MCP23S17)
-	u8 addr_1 = MCP[0] << 1 | 0x41;
-	value = mcp_readData(addr_1, MCP23S17_IODIRA);   // Read IODIRA (Port A direction)
-	xil_printf("IC 1, IODIRA : %02X \n", value);
-	value = mcp_readData(addr_1, MCP23S17_IODIRB);   // Read IODIRB (Port B direction)
-	xil_printf("IC 1, IODIRB : %02X \n", value);
-	value = mcp_readData(addr_1, MCP23S17_IOPOLA);   // Read IOPOLA (Port A polarity)
-	xil_printf("IC 1, IOPOLA : %02X \n", value);
-	value = mcp_readData(addr_1, MCP23S17_IOPOLB);   // Read IOPOLB (Port B polarity)
-	xil_printf("IC 1, IOPOLB : %02X \n", value);
-	value = mcp_readData(addr_1, MCP23S17_GPINTENA); // Read interrupt-enable for Port A
-	xil_printf("IC 1, GPINTENA : %02X \n", value);
-	value = mcp_readData(addr_1, MCP23S17_GPINTENB); // Read interrupt-enable for Port B
-	xil_printf("IC 1, GPINTENB : %02X \n", value);
-	value = mcp_readData(addr_1, MCP23S17_DEFVALA);  // Read default value for comparison on interrupts for Port A pins
-	xil_printf("IC 1, DEFVALA : %02X \n", value);
-	value = mcp_readData(addr_1, MCP23S17_DEFVALB);  // Read default value for comparison on interrupts for Port B pins
-	xil_printf("IC 1, DEFVALB : %02X \n", value);
-	value = mcp_readData(addr_1, MCP23S17_INTCONA);  // Read interrupt-on-change control for Port A pins
-	xil_printf("IC 1, INTCONA : %02X \n", value);
-	value = mcp_readData(addr_1, MCP23S17_INTCONB);  // Read interrupt-on-change control for Port B pins
-	xil_printf("IC 1, INTCONB : %02X \n", value);
-	value = mcp_readData(addr_1, MCP23S17_IOCON);    // Read IOCON (I/O expander configuration) register
-	xil_printf("IC 1, IOCON : %02X \n", value);
-	value = mcp_readData(addr_1, MCP23S17_GPPUA);    // Read internal pull-up state for Port A pins
-	xil_printf("IC 1, GPPUA : %02X \n", value);
-	value = mcp_readData(addr_1, MCP23S17_GPPUB);    // Read internal pull-up state for Port B pins
-	xil_printf("IC 1, GPPUB : %02X \n", value);
-	xil_printf("-------------------- \n", value);
-
-	// Device 0x21 (Address for the 2nd MCP23S17)
-	u8 addr_2 = MCP[1] << 1 | 0x41;
-	value = mcp_readData(addr_2, MCP23S17_IODIRA);   //	Read IODIRA (Port A direction)
-	xil_printf("IC 2, IODIRA : %02X \n", value);
-	value = mcp_readData(addr_2, MCP23S17_IODIRB);   // Read IODIRB (Port B direction)
-	xil_printf("IC 2, IODIRB : %02X \n", value);
-	value = mcp_readData(addr_2, MCP23S17_IOPOLA);   // Read IOPOLA (Port A polarity)
-	xil_printf("IC 2, IOPOLA : %02X \n", value);
-	value = mcp_readData(addr_2, MCP23S17_IOPOLB);   // Read IOPOLB (Port B polarity)
-	xil_printf("IC 2, IOPOLB : %02X \n", value);
-	value = mcp_readData(addr_2, MCP23S17_GPINTENA); // Read interrupt-enable for Port A
-	xil_printf("IC 2, GPINTENA : %02X \n", value);
-	value = mcp_readData(addr_2, MCP23S17_GPINTENB); // Read interrupt-enable for Port B
-	xil_printf("IC 2, GPINTENB : %02X \n", value);
-	value = mcp_readData(addr_2, MCP23S17_DEFVALA);  // Read default value for comparison on interrupts for Port A pins
-	xil_printf("IC 2, DEFVALA : %02X \n", value);
-	value = mcp_readData(addr_2, MCP23S17_DEFVALB);  // Read default value for comparison on interrupts for Port B pins
-	xil_printf("IC 2, DEFVALB : %02X \n", value);
-	value = mcp_readData(addr_2, MCP23S17_INTCONA);  // Read interrupt-on-change control for Port A pins
-	xil_printf("IC 2, INTCONA : %02X \n", value);
-	value = mcp_readData(addr_2, MCP23S17_INTCONB);  // Read interrupt-on-change control for Port B pins
-	xil_printf("IC 2, INTCONB : %02X \n", value);
-	value = mcp_readData(addr_2, MCP23S17_IOCON);    // Read IOCON (I/O expander configuration) register
-	xil_printf("IC 2, IOCON : %02X \n", value);
-	value = mcp_readData(addr_2, MCP23S17_GPPUA);    // Read internal pull-up state for Port A pins
-	xil_printf("IC 2, GPPUA : %02X \n", value);
-	value = mcp_readData(addr_2, MCP23S17_GPPUB);    // Read internal pull-up state for Port B pins
-	xil_printf("IC 2, GPPUB : %02X \n", value);
-	xil_printf("-------------------- \n", value);
-
-	// Device 0x22 (Address for the 3rd MCP23S17)
-	u8 addr_3 = MCP[2] << 1 | 0x41;
-	value = mcp_readData(addr_3, MCP23S17_IODIRA);   // Read IODIRA (Port A direction)
-	xil_printf("IC 3, IODIRA : %02X \n", value);
-	value = mcp_readData(addr_3, MCP23S17_IODIRB);   // Read IODIRB (Port B direction)
-	xil_printf("IC 3, IODIRB : %02X \n", value);
-	value = mcp_readData(addr_3, MCP23S17_IOPOLA);   // Read IOPOLA (Port A polarity)
-	xil_printf("IC 3, IOPOLA : %02X \n", value);
-	value = mcp_readData(addr_3, MCP23S17_IOPOLB);   // Read IOPOLA (Port B polarity)
-	xil_printf("IC 3, IOPOLB : %02X \n", value);
-	value = mcp_readData(addr_3, MCP23S17_GPINTENA); // Read interrupt-enable for Port A
-	xil_printf("IC 3, GPINTENA : %02X \n", value);
-	value = mcp_readData(addr_3, MCP23S17_GPINTENB); // Read interrupt-enable for Port B
-	xil_printf("IC 3, GPINTENB : %02X \n", value);
-	value = mcp_readData(addr_3, MCP23S17_DEFVALA);  // Read default value for comparison on interrupts for Port A pins
-	xil_printf("IC 3, DEFVALA : %02X \n", value);
-	value = mcp_readData(addr_3, MCP23S17_DEFVALB);  // Read default value for comparison on interrupts for Port B pins
-	xil_printf("IC 3, DEFVALB : %02X \n", value);
-	value = mcp_readData(addr_3, MCP23S17_INTCONA);  // Read interrupt-on-change control for Port A pins
-	xil_printf("IC 3, INTCONA : %02X \n", value);
-	value = mcp_readData(addr_3, MCP23S17_INTCONB);  // Read interrupt-on-change control for Port B pins
-	xil_printf("IC 3, INTCONB : %02X \n", value);
-	value = mcp_readData(addr_3, MCP23S17_IOCON);    // Read IOCON (I/O expander configuration) register
-	xil_printf("IC 3, IOCON : %02X \n", value);
-	value = mcp_readData(addr_3, MCP23S17_GPPUA);    // Read internal pull-up state for Port A pins
-	xil_printf("IC 3, GPPUA : %02X \n", value);
-	value = mcp_readData(addr_3, MCP23S17_GPPUB);    // Read internal pull-up state for Port A pins
-	xil_printf("IC 3, GPPUB : %02X \n", value);
-	xil_printf("-------------------- \n", value);
+	for (u8 reg = 0; reg < MCP_CONFIG_LEN; reg++)
+		if (bank[reg] != mcp_config[icNumber][reg])
+			diff |= 1 << reg;
+	return diff;
+}
+
+// Function to dump MCP23S17 register file, registers that differ from the configuration are marked with *
+void dumpRegMCP23S17() {
+	u8 bank[MCP_BURST_MAX];
+
+	for (u8 ic = 0; ic < MCP_CNT; ic++) {
+		mcp_readBank(ic, bank);
+		u16 diff = mcp_verify(ic, bank);
+		for (u8 reg = 0; reg < MCP_BURST_MAX; reg++)
+			xil_printf("IC %d, %s : %02X %s\n", ic + 1, mcp_regName[reg], bank[reg], ((diff >> reg) & 1) ? "*" : "");
+		xil_printf("-------------------- \n");
+	}
 }
 
 // Function to dump MCP23S17 interrupt frame
 void dumpIntFrameMCP23S17() {
 	XSpi_SetSlaveSelect(&SpiInstance, 0x01);					    // Select CS for MCP23S17s
 
-	u8 value;
-	// Device 0x20 (Address for the 1st MCP23S17)
-	u8 addr_1 = MCP[0] << 1 | 0x41;
-	value = mcp_readData(addr_1, MCP23S17_INTFA);   // Read INTFA register from the 1st MCP23S17
-	xil_printf("IC 1, INTFA : %02X \n", value);
-	value = mcp_readData(addr_1, MCP23S17_INTFB);   // Read INTFB register from the 1st MCP23S17
-	xil_printf("IC 1, INTFB : %02X \n", value);
-	value = mcp_readData(addr_1, MCP23S17_INTCAPA);	// Read INTCAPA register from the 1st MCP23S17
-	xil_printf("IC 1, INTCAPA : %02X \n", value);
-	value = mcp_readData(addr_1, MCP23S17_INTCAPB);	// Read INTCAPB register from the 1st MCP23S17
-	xil_printf("IC 1, INTCAPB : %02X \n", value);
-	xil_printf("-------------------- \n", value);
-
-	// Device 0x21 (Address for the 2nd MCP23S17)
-	u8 addr_2 = MCP[1] << 1 | 0x41;
-	value = mcp_readData(addr_2, MCP23S17_INTFA);   // Read INTFA register from the 2nd MCP23S17
-	xil_printf("IC 2, INTFA : %02X \n", value);
-	value = mcp_readData(addr_2, MCP23S17_INTFB);   // Read INTFB register from the 2nd MCP23S17
-	xil_printf("IC 2, INTFB : %02X \n", value);
-	value = mcp_readData(addr_2, MCP23S17_INTCAPA);	// Read INTCAPA register from the 2nd MCP23S17
-	xil_printf("IC 2, INTCAPA : %02X \n", value);
-	value = mcp_readData(addr_2, MCP23S17_INTCAPB);	// Read INTCAPB register from the 2nd MCP23S17
-	xil_printf("IC 2, INTCAPB : %02X \n", value);
-	xil_printf("-------------------- \n", value);
-
-	// Device 0x22 (Address for the 3rd MCP23S17)
-	u8 addr_3 = MCP[2] << 1 | 0x41;
-	value = mcp_readData(addr_3, MCP23S17_INTFA);   // Read INTFA register from the 3rd MCP23S17
-	xil_printf("IC 3, INTFA : %02X \n", value);
-	value = mcp_readData(addr_3, MCP23S17_INTFB);   // Read INTFB register from the 3rd MCP23S17
-	xil_printf("IC 3, INTFB : %02X \n", value);
-	value = mcp_readData(addr_3, MCP23S17_INTCAPA);	// Read INTCAPA register from the 3rd MCP23S17
-	xil_printf("IC 3, INTCAPA : %02X \n", value);
-	value = mcp_readData(addr_3, MCP23S17_INTCAPB);	// Read INTCAPB register from the 3rd MCP23S17
-	xil_printf("IC 3, INTCAPB : %02X \n", value);
-	xil_printf("-------------------- \n", value);
+	u8 value[4];
+	for (u8 ic = 0; ic < MCP_CNT; ic++) {
+		mcp_readBurst(MCP[ic] << 1 | 0x41, MCP23S17_INTFA, value, 4);	// INTFA, INTFB, INTCAPA, INTCAPB
+		xil_printf("IC %d, INTFA : %02X \n", ic + 1, value[0]);
+		xil_printf("IC %d, INTFB : %02X \n", ic + 1, value[1]);
+		xil_printf("IC %d, INTCAPA : %02X \n", ic + 1, value[2]);
+		xil_printf("IC %d, INTCAPB : %02X \n", ic + 1, value[3]);
+		xil_printf("-------------------- \n");
+	}
+}
+
+
+// Timer ISR (1 msec): paces the configuration check, done by mcp_checkTask()
+void mcp_checkTick() {
+	if (mcp_check_ms < 0xFFFF)
+		mcp_check_ms++;
+}
+
+// Main loop: once per MCP_CHECK_PERIOD_MS reads the configuration block (IODIRA to GPPUB) of the
+// next IC in one burst and compares its checksum with the expected one. Registers that differ
+// (brown-out or reset of the IC) are written again, runs of them in one burst each.
+// Returns the IC number + 1 if its configuration was restored, 0 otherwise.
+// Bus time: one 16-byte transaction per period, well below 1 % at the SPI clock of the board.
+u8 mcp_checkTask() {
+	u8 block[MCP_CONFIG_LEN];
+
+	if (mcp_check_ms < MCP_CHECK_PERIOD_MS)
+		return 0;
+	mcp_check_ms = 0;
+
+	u8 ic = mcp_check_ic;
+	mcp_check_ic = (ic + 1 < MCP_CNT) ? ic + 1 : 0;
+	mcp_checks++;
+
+	XSpi_SetSlaveSelect(&SpiInstance, 0x01);					    // Select CS for MCP23S17s
+	mcp_readBurst(MCP[ic] << 1 | 0x41, MCP23S17_IODIRA, block, MCP_CONFIG_LEN);
+	if (mcp_checksum(block, MCP_CONFIG_LEN) == mcp_configSum[ic])
+		return 0;
+
+	u16 diff = mcp_verify(ic, block);			// the registers to write again
+	mcp_corrupt[ic]++;
+
+	// A reset IC lost HAEN and ignores its address pins: IOCON first, to every IC as initMCP23S17() does
+	if (diff & ((1 << MCP23S17_IOCON) | (1 << (MCP23S17_IOCON + 1)))) {
+		for (u8 i = 0; i < MCP_CNT; i++)
+			mcp_writeData(MCP[i] << 1 | 0x40, MCP23S17_IOCON, MCP23S17_IOCON_VALUE);
+		diff &= ~((1 << MCP23S17_IOCON) | (1 << (MCP23S17_IOCON + 1)));
+	}
+	while (diff != 0) {
+		u8 first = __builtin_ctz(diff);
+		u8 len = __builtin_ctz(~(diff >> first));					// run of differing registers
+		mcp_writeBurst(MCP[ic] << 1 | 0x40, first, &mcp_config[ic][first], len);
+		diff &= ~(((1 << len) - 1) << first);
+	}
+	mcp_olatValid[ic] = 0;			// the output latches were reset too
+	return ic + 1;
+}
+
+// Function to read the configuration check counters: checks done, corruptions found per IC
+void mcp_checkStats(u32 *checks, u32 *corruptions) {
+	*checks = mcp_checks;
+	for (u8 ic = 0; ic < MCP_CNT; ic++)
+		corruptions[ic] = mcp_corrupt[ic];
 }
@@ -15,6 +15,7 @@
 #include "xspi.h"
 #include "xstatus.h"
 #include "xil_printf.h"
+#include "stdbool.h"
 #include "sleep.h"
 #include "spi_api.h"	// include before ICs header files
 #include "gpio_api.h"	// include before ICs header files
@@ -36,6 +37,8 @@
 #define MCP23S17_GPPUB 0x0D
 #define MCP23S17_GPIOA 0x12
 #define MCP23S17_GPIOB 0x13
+#define MCP23S17_OLATA 0x14
+#define MCP23S17_OLATB 0x15
 
 #define MCP23S17_INTFA 0x0E
 #define MCP23S17_INTFB 0x0F
@@ -45,17 +48,50 @@
 #define MCP_addr_1	   0x20
 #define MCP_addr_2	   0x21
 #define MCP_addr_3	   0x22
+#define MCP_CNT		   3
+
+// IOCON: MIRROR (INTA/INTB joined), HAEN (hardware address) and INTPOL (active-high INT),
+// with SEQOP clear, so the address pointer increments and a register pair is read in one transaction
+#define MCP23S17_IOCON_VALUE 0x4A
+
+#define MCP_BURST_MAX  0x16		// longest burst: the whole register file, IODIRA to OLATB
+#define MCP_CONFIG_LEN 0x0E		// configuration registers, IODIRA to GPPUB
+#define MCP_CHECK_PERIOD_MS 100	// background configuration check of one IC per period
+
+// 48-bit port snapshot from mcp_scanPorts(): 16 bits per IC, port A in the low byte, port B in the high byte
+#define MCP_SNAP_PORT(snap, ic, port)  ((u8)((snap) >> ((16 * (ic)) + (((port) == 'B') ? 8 : 0))))
+
+// Input capture of one IC after an interrupt, port A in the low byte
+typedef struct {
+	u16 intf;		// pins that caused the interrupt (INTFA/B)
+	u16 intcap;		// port state latched at the interrupt (INTCAPA/B)
+	u16 gpio;		// port state read right after, holds the changes since the interrupt
+} MCP_CAPTURE;
 
 
 void mcp_reset();
 void mcp_writeData(u8 addrWR, u8 opcode, u8 data);
 u8 mcp_readData(u8 addrWR, u8 opcode);
 void mcp_setPort(u8 icNumber, u8 port, u8 value);
+void mcp_setPortMasked(u8 icNumber, u8 port, u8 mask, u8 value);
+void mcp_cacheInvalidate();
+void mcp_cacheStats(u32 *hits, u32 *misses);
 u8 mcp_getPort(u8 icNumber, u8 port);
+void mcp_writeBurst(u8 addrWR, u8 opcode, const u8 *data, u8 count);
+void mcp_readBurst(u8 addrRD, u8 opcode, u8 *data, u8 count);
+u16 mcp_getPorts(u8 icNumber);
+u64 mcp_scanPorts();
+bool mcp_capture(u8 icNumber, MCP_CAPTURE *cap);
+u8 mcp_captureAll(u64 prev, u64 *snap_cap, u64 *snap_now);
 void initMCP23S17();
 void mcp_intFrame(u8 *intFrame);
+void mcp_readBank(u8 icNumber, u8 *bank);
+u16 mcp_verify(u8 icNumber, const u8 *bank);
 void dumpRegMCP23S17();
 void dumpIntFrameMCP23S17();
+void mcp_checkTick();
+u8 mcp_checkTask();
+void mcp_checkStats(u32 *checks, u32 *corruptions);
 
 
 #endif /* SRC_MCP23S17_H_ */
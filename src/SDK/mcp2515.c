@@ -7,46 +7,76 @@
 
 #include "mcp2515.h"
 
-void resetMCP2515() {
-	XSpi_SetSlaveSelect(&SpiInstance, 0x04);		// Select CS for MCP2515
+void initMCP2515(MCP2515 *can, XSpi *spi, u8 cs, u32 osc_hz, u32 bitrate) {
+	// Bind the controller to its SPI bus and chip select, no SPI traffic
+	can->spi = spi;
+	can->cs = cs;
+	can->osc_hz = osc_hz;
+	can->bitrate = bitrate;
+	can->txq_head = 0;
+	can->txq_tail = 0;
+	can->tx_gap = 0;
+	can->tx_time = 0;
+	can->tx_frames = 0;
+	can->rx_frames = 0;
+	can->txq_overflow = 0;
+}
+
+void resetMCP2515(MCP2515 *can) {
+	XSpi_SetSlaveSelect(can->spi, can->cs);		// Select CS for MCP2515
 
 	u8 WriteBuffer[1] = {MCP2515_RESET};
 	send_spi_data(WriteBuffer, sizeof(WriteBuffer));
 	usleep(200000);	// delay 200 msec to allow the MCP2515 to reset
 }
 
-void setBitrateCan() {
-	// Configure MCP2515 for 20 MHz oscillator and 33333 bps CAN Bus speed
-	// Configuration registers CNF1, CNF2, CNF3 need to be set
-
-	// CNF1: SJW=0, BRP=11
-	writeRegisterCan(MCP2515_CNF1, 0x0B);  // 33.333 kbps @ 20 MHz
-	// writeRegisterCan(MCP2515_CNF1, 0x4E);  // 33.333 kbps @ 16 MHz
-
-	// CNF2: BTLMODE=1, SAM=1, PHSEG1=7, PRSEG=7
-	writeRegisterCan(MCP2515_CNF2, 0xFF);  // 33.333 kbps @ 20 MHz
-	// writeRegisterCan(MCP2515_CNF2, 0xF1);  // 33.333 kbps @ 16 MHz
-
-	// CNF3: SOF=1, WAKFIL=0, PHSEG2=7
-	writeRegisterCan(MCP2515_CNF3, 0x87);  // 33.333 kbps @ 20 MHz
-	// writeRegisterCan(MCP2515_CNF3, 0x85);  // 33.333 kbps @ 16 MHz
+bool setBitrateCan(MCP2515 *can) {
+	// Configuration registers CNF1, CNF2, CNF3 need to be set.
+	// Bit time = 2 * (BRP + 1) / Fosc per time quantum (TQ), 8 to 25 TQ per bit:
+	// SyncSeg (1 TQ) + PropSeg + PhaseSeg1 + PhaseSeg2, split in thirds, SJW = 1 TQ, 3 samples.
+	// The most TQ per bit is preferred, 20 MHz / 33333 bps gives BRP=11 and 25 TQ:
+	// CNF1 = 0x0B, CNF2 = 0xFF, CNF3 = 0x87
+	for (u8 ntq = 25; ntq >= 8; ntq--) {
+		u32 div = 2 * ntq * can->bitrate;
+		u32 brp = (can->osc_hz + div / 2) / div;		// BRP + 1, rounded
+		if ((brp == 0) || (brp > 64))
+			continue;
+		u32 actual = can->osc_hz / (2 * ntq * brp);
+		u32 error = (actual > can->bitrate) ? (actual - can->bitrate) : (can->bitrate - actual);
+		if (error * 200 > can->bitrate)				// more than 0.5 % off
+			continue;
+
+		u8 ps2 = ntq / 3;
+		u8 ps1 = ps2;
+		u8 prop = ntq - 1 - ps1 - ps2;
+		if (prop > 8) {
+			ps1 += prop - 8;
+			prop = 8;
+		}
+
+		writeRegisterCan(can, MCP2515_CNF1, (brp - 1) & MCP2515_BRP_MASK);		// SJW=1
+		writeRegisterCan(can, MCP2515_CNF2, MCP2515_BTLMODE | MCP2515_SAM | ((ps1 - 1) << 3) | (prop - 1));
+		writeRegisterCan(can, MCP2515_CNF3, MCP2515_SOF | (ps2 - 1));
+		return true;
+	}
+	return false;		// bitrate not reachable with this oscillator
 }
 
-void setNormalModeCan() {
+void setNormalModeCan(MCP2515 *can) {
 	// Set Normal mode
-	modifyRegisterCan(MCP2515_CANCTRL, MCP2515_REQOP_MASK, MCP2515_MODE_NORMAL);
+	modifyRegisterCan(can, MCP2515_CANCTRL, MCP2515_REQOP_MASK, MCP2515_MODE_NORMAL);
 }
 
-void writeRegisterCan(u8 address, u8 value) {
-	XSpi_SetSlaveSelect(&SpiInstance, 0x04);		// Select CS for MCP2515
+void writeRegisterCan(MCP2515 *can, u8 address, u8 value) {
+	XSpi_SetSlaveSelect(can->spi, can->cs);		// Select CS for MCP2515
 
 	u8 WriteBuffer[3] = {MCP2515_WRITE, address, value};
 	send_spi_data(WriteBuffer, sizeof(WriteBuffer));
 	usleep(1000);	// delay 1 msec
 }
 
-u8 readRegisterCan(u8 address) {
-	XSpi_SetSlaveSelect(&SpiInstance, 0x04);		// Select CS for MCP2515
+u8 readRegisterCan(MCP2515 *can, u8 address) {
+	XSpi_SetSlaveSelect(can->spi, can->cs);		// Select CS for MCP2515
 
 	u8 WriteBuffer[3] = {MCP2515_READ, address, 0x00};
 	u8 ReadBuffer[3];
@@ -54,16 +84,16 @@ u8 readRegisterCan(u8 address) {
 	return ReadBuffer[2];
 }
 
-void modifyRegisterCan(u8 address, u8 mask, u8 value) {
-	XSpi_SetSlaveSelect(&SpiInstance, 0x04);		// Select CS for MCP2515
+void modifyRegisterCan(MCP2515 *can, u8 address, u8 mask, u8 value) {
+	XSpi_SetSlaveSelect(can->spi, can->cs);		// Select CS for MCP2515
 
 	u8 WriteBuffer[4] = {MCP2515_BIT_MODIFY, address, mask, value};
 	send_spi_data(WriteBuffer, sizeof(WriteBuffer));
 	usleep(1000);	// delay 1 msec
 }
 
-void writeSequentialMemoryCan(u8 address, u8 *data, u8 length) {
-	XSpi_SetSlaveSelect(&SpiInstance, 0x04);		// Select CS for MCP2515
+void writeSequentialMemoryCan(MCP2515 *can, u8 address, u8 *data, u8 length) {
+	XSpi_SetSlaveSelect(can->spi, can->cs);		// Select CS for MCP2515
 
 	u8 WriteBuffer[length + 2];
 	WriteBuffer[0] = MCP2515_WRITE;
@@ -76,54 +106,139 @@ void writeSequentialMemoryCan(u8 address, u8 *data, u8 length) {
 	usleep(1000);	// delay 1 msec
 }
 
-bool isMCP2515NormalMode() {
-	u8 value = readRegisterCan(MCP2515_CANCTRL);
+bool isMCP2515NormalMode(MCP2515 *can) {
+	u8 value = readRegisterCan(can, MCP2515_CANCTRL);
 
 	return ((value & MCP2515_MODE_MASK) == MCP2515_MODE_NORMAL);
 }
 
-void writeCommandCan(u8 address) {
-	XSpi_SetSlaveSelect(&SpiInstance, 0x04);		// Select CS for MCP2515
+void writeCommandCan(MCP2515 *can, u8 address) {
+	XSpi_SetSlaveSelect(can->spi, can->cs);		// Select CS for MCP2515
 
 	u8 WriteBuffer[1] = {address};
 	send_spi_data(WriteBuffer, sizeof(WriteBuffer));
 	usleep(1000);	// delay 1 msec
 }
 
-void sendCANMessage(CAN_FRAME *can_message) {
+int sendCANMessage(MCP2515 *can, CAN_FRAME *can_message) {
+	// TXB0 still holds a frame waiting for the bus, writing it would replace that frame
+	if (checkTXREQBitCan(can))
+		return XST_DEVICE_BUSY;
+
 	// Write message identifier
-	writeRegisterCan(MCP2515_TXB0SIDH, ((can_message->id) >> 3) & 0xFF); // Bits 10-3
-	writeRegisterCan(MCP2515_TXB0SIDL, ((can_message->id) << 5) & 0xE0); // Bits 2-0
+	writeRegisterCan(can, MCP2515_TXB0SIDH, ((can_message->id) >> 3) & 0xFF); // Bits 10-3
+	writeRegisterCan(can, MCP2515_TXB0SIDL, ((can_message->id) << 5) & 0xE0); // Bits 2-0
 
 	// Write message data length
-	writeRegisterCan(MCP2515_TXB0DLC, ((can_message->length) & 0x0F));
+	writeRegisterCan(can, MCP2515_TXB0DLC, ((can_message->length) & 0x0F));
 
 	// Write message data
-	writeSequentialMemoryCan(MCP2515_TXB0D0, can_message->data.byte, can_message->length);
+	writeSequentialMemoryCan(can, MCP2515_TXB0D0, can_message->data.byte, can_message->length);
 
 	// Set TXREQ bit to request transmission
-	writeCommandCan(MCP2515_RTS_TX0);
+	writeCommandCan(can, MCP2515_RTS_TX0);
+	can->tx_frames++;
+	return XST_SUCCESS;
 }
 
-void setOneShotModeCan() {
+void setOneShotModeCan(MCP2515 *can) {
 	// Set MCP2515 to One-Shot mode
-	modifyRegisterCan(MCP2515_CANCTRL, MCP2515_REQOP_MASK, MCP2515_MODE_CONFIG); // Set Configuration mode
+	modifyRegisterCan(can, MCP2515_CANCTRL, MCP2515_REQOP_MASK, MCP2515_MODE_CONFIG); // Set Configuration mode
 	// Set One-Shot mode
-	modifyRegisterCan(MCP2515_CANCTRL, MCP2515_OSM, MCP2515_OSM); // Set OSM bit
-	modifyRegisterCan(MCP2515_CANCTRL, MCP2515_REQOP_MASK, MCP2515_MODE_NORMAL); // Set Normal mode
+	modifyRegisterCan(can, MCP2515_CANCTRL, MCP2515_OSM, MCP2515_OSM); // Set OSM bit
+	modifyRegisterCan(can, MCP2515_CANCTRL, MCP2515_REQOP_MASK, MCP2515_MODE_NORMAL); // Set Normal mode
 }
 
-void RegularOperationMode() {
+void RegularOperationMode(MCP2515 *can) {
 	// Deactivate MCP2515 One-Shot mode
-	modifyRegisterCan(MCP2515_CANCTRL, MCP2515_REQOP_MASK, MCP2515_MODE_CONFIG); // Set Configuration mode
+	modifyRegisterCan(can, MCP2515_CANCTRL, MCP2515_REQOP_MASK, MCP2515_MODE_CONFIG); // Set Configuration mode
 	// Clear One-Shot Mode Bit
-	modifyRegisterCan(MCP2515_CANCTRL, MCP2515_OSM, 0x00); // Clear OSM bit
-	modifyRegisterCan(MCP2515_CANCTRL, MCP2515_REQOP_MASK, MCP2515_MODE_NORMAL); // Set Normal mode
+	modifyRegisterCan(can, MCP2515_CANCTRL, MCP2515_OSM, 0x00); // Clear OSM bit
+	modifyRegisterCan(can, MCP2515_CANCTRL, MCP2515_REQOP_MASK, MCP2515_MODE_NORMAL); // Set Normal mode
 }
 
-bool checkTXREQBitCan() {
-	u8 TXB0CTRL_value = readRegisterCan(MCP2515_TXB0CTRL);
+bool checkTXREQBitCan(MCP2515 *can) {
+	u8 TXB0CTRL_value = readRegisterCan(can, MCP2515_TXB0CTRL);
 	u8 mask = 0x01 << MCP2515_TXREQ_BIT;
 	return ((TXB0CTRL_value & mask) != 0);
 }
 
+void setReceiveAnyCan(MCP2515 *can) {
+	// Receive all standard and extended messages in both receive buffers, RXB0 rolls over to RXB1
+	writeRegisterCan(can, MCP2515_RXB0CTRL, MCP2515_RXM_ANY | MCP2515_BUKT);
+	writeRegisterCan(can, MCP2515_RXB1CTRL, MCP2515_RXM_ANY);
+}
+
+bool receiveCANMessage(MCP2515 *can, CAN_FRAME *can_message) {
+	XSpi_SetSlaveSelect(can->spi, can->cs);		// Select CS for MCP2515
+
+	// Read status: which receive buffer holds a message
+	u8 StatusW[2] = {MCP2515_READ_STATUS, 0x00};
+	u8 StatusR[2];
+	send_spi_data_read(StatusW, StatusR, sizeof(StatusW));
+
+	u8 instruction;
+	if (StatusR[1] & MCP2515_STAT_RX0IF) {
+		instruction = MCP2515_READ_RX0;
+	} else if (StatusR[1] & MCP2515_STAT_RX1IF) {
+		instruction = MCP2515_READ_RX1;
+	} else {
+		return false;		// no message received
+	}
+
+	// READ RX BUFFER: SIDH, SIDL, EID8, EID0, DLC, D0-D7. The RXnIF flag is cleared when CS is released
+	u8 WriteBuffer[14] = {instruction};
+	u8 ReadBuffer[14];
+	send_spi_data_read(WriteBuffer, ReadBuffer, sizeof(WriteBuffer));
+
+	u8 sidh = ReadBuffer[1];
+	u8 sidl = ReadBuffer[2];
+	if (sidl & 0x08) {		// IDE: extended identifier
+		can_message->id = ((u32)sidh << 21) | ((u32)(sidl & 0xE0) << 13) | ((u32)(sidl & 0x03) << 16)
+		                | ((u32)ReadBuffer[3] << 8) | ReadBuffer[4];
+	} else {
+		can_message->id = ((u32)sidh << 3) | (sidl >> 5);		// Bits 10-3, Bits 2-0
+	}
+
+	can_message->length = ReadBuffer[5] & 0x0F;
+	if (can_message->length > 8)
+		can_message->length = 8;
+	can_message->data.value = 0;
+	for (u8 i = 0; i < can_message->length; i++)
+		can_message->data.byte[i] = ReadBuffer[6 + i];
+
+	can->rx_frames++;
+	return true;
+}
+
+bool queueCANMessage(MCP2515 *can, CAN_FRAME *can_message) {
+	// Add a frame to the transmit queue of this controller, sent later by serviceCANQueue()
+	u8 next = (can->txq_head + 1) & (MCP2515_TXQ_SIZE - 1);
+	if (next == can->txq_tail) {
+		can->txq_overflow++;
+		return false;		// queue full, frame dropped
+	}
+	can->txq[can->txq_head] = *can_message;
+	can->txq_head = next;
+	return true;
+}
+
+void setTxGapCan(MCP2515 *can, u16 gap_ms) {
+	// Minimum time between two queued frames, for receivers that need time between messages
+	can->tx_gap = gap_ms;
+}
+
+bool serviceCANQueue(MCP2515 *can, u32 now) {
+	// Send the oldest queued frame if TXB0 is free and the gap since the previous queued
+	// frame has passed (now in msec). Returns true if a frame was sent
+	if (can->txq_tail == can->txq_head)
+		return false;
+	if ((now - can->tx_time) < can->tx_gap)
+		return false;
+	if (sendCANMessage(can, &can->txq[can->txq_tail]) != XST_SUCCESS)
+		return false;		// previous frame still pending
+
+	can->txq_tail = (can->txq_tail + 1) & (MCP2515_TXQ_SIZE - 1);
+	can->tx_time = now;
+	return true;
+}
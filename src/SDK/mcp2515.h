@@ -24,6 +24,9 @@
 #define MCP2515_WRITE           0x02
 #define MCP2515_READ            0x03
 #define MCP2515_BIT_MODIFY      0x05
+#define MCP2515_READ_STATUS     0xA0
+#define MCP2515_READ_RX0        0x90		// READ RX BUFFER, starting at RXB0SIDH
+#define MCP2515_READ_RX1        0x94		// READ RX BUFFER, starting at RXB1SIDH
 
 // MCP2515 control register addresses
 #define MCP2515_TXB0CTRL        0x30
@@ -39,6 +42,8 @@
 #define MCP2515_TXB0DLC         0x35
 #define MCP2515_TXB0D0          0x36
 #define MCP2515_TXREQ_BIT          3
+#define MCP2515_RXB0CTRL        0x60
+#define MCP2515_RXB1CTRL        0x70
 
 // MCP2515 control register values
 #define MCP2515_MODE_NORMAL     0x00
@@ -50,10 +55,21 @@
 #define MCP2515_CLKPRE_MASK     0x03
 #define MCP2515_SJW_MASK        0xC0
 #define MCP2515_BRP_MASK        0x3F
+#define MCP2515_BTLMODE         0x80		// CNF2: PHSEG2 set by CNF3
+#define MCP2515_SAM             0x40		// CNF2: bus sampled three times
+#define MCP2515_SOF             0x80		// CNF3: CLKOUT pin is SOF signal
 
 // CANCTRL register values
 #define MCP2515_MODE_MASK       0xE0
 
+// RXBnCTRL register values
+#define MCP2515_RXM_ANY         0x60		// receive any message, filters off
+#define MCP2515_BUKT            0x04		// RXB0 rolls over to RXB1 when full
+
+// READ STATUS instruction bits
+#define MCP2515_STAT_RX0IF      0x01
+#define MCP2515_STAT_RX1IF      0x02
+
 
 typedef union {
 	u64 value;		// LSB (8-bit) of value is the 1st transmitted data
@@ -78,19 +94,54 @@ typedef struct {
 } CAN_FRAME;
 
 
-void resetMCP2515();
-void setBitrateCan();		// Set to 33333bps for 20 MHz MCP2515 clock
-void setNormalModeCan();
-void writeRegisterCan(u8 address, u8 value);
-u8 readRegisterCan(u8 address);
-void modifyRegisterCan(u8 address, u8 mask, u8 value);
-void writeSequentialMemoryCan(u8 address, u8 *data, u8 length);
-bool isMCP2515NormalMode();
-void writeCommandCan(u8 address);
-void sendCANMessage(CAN_FRAME *can_message);
-void setOneShotModeCan();
-void RegularOperationMode();
-bool checkTXREQBitCan();
+// Board wiring and bus parameters
+#define MCP2515_CS_IPC          0x04		// SPI slave select of the Instrument Panel Cluster MCP2515
+#define MCP2515_OSC_20MHZ       20000000
+#define MCP2515_OSC_16MHZ       16000000
+#define MCP2515_BITRATE_SWCAN   33333		// GMLAN single wire CAN
+
+#define MCP2515_TXQ_SIZE        32			// frames per transmit queue, power of 2
+
+// One MCP2515 controller. Every driver function takes the controller it works on,
+// so one firmware image can drive several controllers (one chip select each),
+// each with its own bus parameters, transmit queue and statistics.
+typedef struct {
+	XSpi *spi;					// SPI controller the MCP2515 is connected to
+	u8 cs;						// slave select mask of the MCP2515
+	u32 osc_hz;					// MCP2515 oscillator frequency
+	u32 bitrate;				// CAN-Bus bitrate
+
+	CAN_FRAME txq[MCP2515_TXQ_SIZE];	// frames waiting for TXB0
+	u8 txq_head;
+	u8 txq_tail;
+	u16 tx_gap;					// msec between two queued frames (setTxGapCan)
+	u32 tx_time;				// time the last queued frame was sent
+
+	u32 tx_frames;				// frames written to TXB0
+	u32 rx_frames;				// frames read from RXB0/RXB1
+	u32 txq_overflow;			// frames dropped, transmit queue full
+} MCP2515;
+
+
+void initMCP2515(MCP2515 *can, XSpi *spi, u8 cs, u32 osc_hz, u32 bitrate);
+void resetMCP2515(MCP2515 *can);
+bool setBitrateCan(MCP2515 *can);		// Set can->bitrate for can->osc_hz (configuration mode only)
+void setNormalModeCan(MCP2515 *can);
+void writeRegisterCan(MCP2515 *can, u8 address, u8 value);
+u8 readRegisterCan(MCP2515 *can, u8 address);
+void modifyRegisterCan(MCP2515 *can, u8 address, u8 mask, u8 value);
+void writeSequentialMemoryCan(MCP2515 *can, u8 address, u8 *data, u8 length);
+bool isMCP2515NormalMode(MCP2515 *can);
+void writeCommandCan(MCP2515 *can, u8 address);
+int sendCANMessage(MCP2515 *can, CAN_FRAME *can_message);		// XST_DEVICE_BUSY while TXB0 is pending
+void setOneShotModeCan(MCP2515 *can);
+void RegularOperationMode(MCP2515 *can);
+bool checkTXREQBitCan(MCP2515 *can);
+void setReceiveAnyCan(MCP2515 *can);
+bool receiveCANMessage(MCP2515 *can, CAN_FRAME *can_message);
+bool queueCANMessage(MCP2515 *can, CAN_FRAME *can_message);
+void setTxGapCan(MCP2515 *can, u16 gap_ms);
+bool serviceCANQueue(MCP2515 *can, u32 now);
 
 
 #endif /* SRC_MCP2515_H_ */
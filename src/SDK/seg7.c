@@ -0,0 +1,154 @@
+/*
+ * seg7.c
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#include "seg7.h"
+
+// ASCII 0x20 to 0x7F to segments (DP A B C D E F G)
+static const u8 seg7_ascii[96] = {
+	0x00, 0xB0, 0x22, 0x00, 0x00, 0x00, 0x00, 0x02,		// sp ! " # $ % & '
+	0x4E, 0x78, 0x00, 0x00, 0x80, 0x01, 0x80, 0x25,		// ( ) * + , - . /
+	0x7E, 0x30, 0x6D, 0x79, 0x33, 0x5B, 0x5F, 0x70,		// 0 1 2 3 4 5 6 7
+	0x7F, 0x7B, 0x00, 0x00, 0x00, 0x09, 0x00, 0x65,		// 8 9 : ; < = > ?
+	0x7D, 0x77, 0x1F, 0x4E, 0x3D, 0x4F, 0x47, 0x5E,		// @ A B C D E F G
+	0x37, 0x06, 0x3C, 0x57, 0x0E, 0x54, 0x76, 0x7E,		// H I J K L M N O
+	0x67, 0x73, 0x05, 0x5B, 0x0F, 0x3E, 0x3E, 0x2A,		// P Q R S T U V W
+	0x37, 0x3B, 0x6D, 0x4E, 0x13, 0x78, 0x62, 0x08,		// X Y Z [ bksl ] ^ _
+	0x20, 0x77, 0x1F, 0x0D, 0x3D, 0x4F, 0x47, 0x5E,		// ` a b c d e f g
+	0x17, 0x10, 0x3C, 0x57, 0x06, 0x54, 0x15, 0x1D,		// h i j k l m n o
+	0x67, 0x73, 0x05, 0x5B, 0x0F, 0x1C, 0x1C, 0x2A,		// p q r s t u v w
+	0x37, 0x3B, 0x6D, 0x4E, 0x06, 0x78, 0x40, 0x00,		// x y z { | } ~ del
+};
+
+
+u8 seg7_glyph(char c) {
+	if ((c < 0x20) || (c > 0x7F))
+		return SEG7_BLANK;
+	return seg7_ascii[c - 0x20];
+}
+
+// Glyph of a decimal digit 0 to 9
+u8 seg7_digit(u8 value) {
+	return seg7_ascii['0' - 0x20 + value];
+}
+
+// Renders text into width glyphs, blank padded. A '.' sets the decimal point of the previous
+// glyph (or takes a digit of its own at the start or after another '.').
+// Returns the number of glyphs the text needs, which may be more than width.
+u8 seg7_render(u8 out[], u8 width, const char *text) {
+	u8 n = 0;
+	bool dp_free = false;		// previous glyph can take a decimal point
+
+	for (; *text != 0; text++) {
+		if ((*text == '.') && dp_free) {
+			if (n <= width)
+				out[n - 1] |= SEG7_DP;
+			dp_free = false;
+			continue;
+		}
+		if (n < width)
+			out[n] = seg7_glyph(*text);
+		dp_free = (*text != '.');
+		n++;
+	}
+	for (u8 i = n; i < width; i++)
+		out[i] = SEG7_BLANK;
+	return n;
+}
+
+// Renders text, left aligned, into the 4 digits of a 7-seg led display (display back buffer)
+void seg7_print(u8 icNumber, const char *text) {
+	u8 glyph[SEG7_WIDTH];
+
+	seg7_render(glyph, SEG7_WIDTH, text);
+	for (u8 i = 0; i < SEG7_WIDTH; i++)
+		display_setRow(icNumber, SEG7_FIRST_DIGIT - i, glyph[i]);
+}
+
+// Largest value per number of digits, larger values are shown as all nines
+static const u32 seg7_limit[SEG7_MAX_WIDTH + 1] = {0, 9, 99, 999, 9999};
+
+// Splits value into width decimal digits, most significant first, and renders their glyphs.
+// value / 10 is a multiply by 0xCCCD and a shift by 19, exact for values below 81920.
+// dp is the digit, counted from the right (0 = units), that gets the decimal point, or SEG7_DP_NONE.
+// With blank set, leading zeros are blank, except the digit with the decimal point and the units.
+void seg7_format(u8 out[], u32 value, u8 width, u8 dp, bool blank) {
+	u32 v = value;				// clamped below, so v * 0xCCCD stays within 32 bits
+
+	if (width > SEG7_MAX_WIDTH)
+		width = SEG7_MAX_WIDTH;
+	if (v > seg7_limit[width])
+		v = seg7_limit[width];
+
+	for (u8 i = width; i > 0; i--) {
+		u32 q = (v * 0xCCCD) >> 19;
+		out[i - 1] = seg7_digit(v - ((q << 3) + (q << 1)));
+		v = q;
+	}
+	if (dp < width)
+		out[width - 1 - dp] |= SEG7_DP;
+	if (blank) {
+		for (u8 i = 0; (i + 1 < width) && (out[i] == seg7_ascii['0' - 0x20]); i++)
+			out[i] = SEG7_BLANK;
+	}
+}
+
+// Renders a number, right aligned in width digits, into a 7-seg led display (display back buffer).
+// Digits left of width are blank.
+void seg7_printNum(u8 icNumber, u32 value, u8 width, u8 dp, bool blank) {
+	u8 glyph[SEG7_MAX_WIDTH];
+
+	if (width > SEG7_WIDTH)
+		width = SEG7_WIDTH;
+	seg7_format(glyph, value, width, dp, blank);
+	for (u8 i = 0; i < SEG7_WIDTH - width; i++)
+		display_setRow(icNumber, SEG7_FIRST_DIGIT - i, SEG7_BLANK);
+	for (u8 i = 0; i < width; i++)
+		display_setRow(icNumber, SEG7_FIRST_DIGIT - (SEG7_WIDTH - width) - i, glyph[i]);
+}
+
+// Starts a marquee: text scrolls in from the right, one digit per period msec. Without loop it
+// stops when the last character reached the right-most digit, with loop it scrolls out and repeats.
+void seg7_marqueeStart(SEG7_MARQUEE *m, u8 icNumber, const char *text, u16 period, bool loop, u32 now) {
+	for (u8 i = 0; i < SEG7_WIDTH; i++)
+		m->glyph[i] = SEG7_BLANK;
+	u8 n = seg7_render(&m->glyph[SEG7_WIDTH], SEG7_MARQUEE_LEN - SEG7_WIDTH, text);
+	if (n > SEG7_MARQUEE_LEN - SEG7_WIDTH)
+		n = SEG7_MARQUEE_LEN - SEG7_WIDTH;
+
+	m->icNumber = icNumber;
+	m->len = SEG7_WIDTH + n;
+	m->pos = 1;				// first step shows the first character on the right-most digit
+	m->loop = loop;
+	m->period = period;
+	m->time = now - period;		// first step at once
+	m->running = true;
+}
+
+// Moves the marquee one digit when its period elapsed and draws the window into the display
+// back buffer. Returns true if a new frame was drawn (publish it with display_swap()).
+bool seg7_marqueeStep(SEG7_MARQUEE *m, u32 now) {
+	if ((!m->running) || ((now - m->time) < m->period))
+		return false;
+	m->time = now;
+
+	for (u8 i = 0; i < SEG7_WIDTH; i++) {
+		u8 p = m->pos + i;
+		if (p >= m->len)
+			p = m->loop ? (p - m->len) : m->len;
+		display_setRow(m->icNumber, SEG7_FIRST_DIGIT - i, (p < m->len) ? m->glyph[p] : SEG7_BLANK);
+	}
+
+	if (m->loop) {
+		if (++m->pos >= m->len)
+			m->pos = 0;
+	} else if (m->pos + SEG7_WIDTH >= m->len) {
+		m->running = false;		// text in place
+	} else {
+		m->pos++;
+	}
+	return true;
+}
+
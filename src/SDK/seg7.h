@@ -0,0 +1,57 @@
+/*
+ * seg7.h
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#ifndef SRC_SEG7_H_
+#define SRC_SEG7_H_
+
+#include "xil_types.h"
+#include "stdbool.h"
+#include "display.h"		// display_setRow
+
+
+// Seven-segment glyph renderer for the 7-seg led displays (MAX7221 digits 7-4, no decode mode).
+// Register bit order  :  7 6 5 4 3 2 1 0  (msb to lsb)
+// Led display segment : DP A B C D E F G
+// Text is rendered from a precomputed ASCII table, a '.' lights the decimal point of the
+// previous character. Letters that have no 7-segment shape are drawn as close as possible
+// (M as three legs, W as three bars); characters outside 0x20-0x7F are blank.
+// A marquee renders its text once, then every step only moves the window by one digit.
+
+#define SEG7_DP              0x80		// decimal point
+#define SEG7_BLANK           0x00
+#define SEG7_WIDTH           4			// digits per 7-seg led display
+#define SEG7_FIRST_DIGIT     7			// left-most digit of a display, the others follow downwards
+
+// Number formatting (seg7_format): no divisions, the MicroBlaze has no hardware divider
+#define SEG7_DP_NONE         0xFF		// dp argument: no decimal point
+#define SEG7_BLANK_ZEROS     true		// blank argument: leading zeros off, up to the decimal point
+#define SEG7_MAX_WIDTH       SEG7_WIDTH	// up to 9999, keeps the reciprocal multiply exact
+
+#define SEG7_MARQUEE_LEN     32			// glyphs per marquee text (including the blank lead-in)
+
+typedef struct {
+	u8 icNumber;			// display (MAX7221) the marquee runs on
+	u8 glyph[SEG7_MARQUEE_LEN];	// rendered text, lead-in of SEG7_WIDTH blanks
+	u8 len;					// glyphs in glyph[]
+	u8 pos;					// first glyph shown in the window
+	bool loop;				// start again after the text left the display
+	bool running;
+	u16 period;				// msec per step
+	u32 time;				// time of the last step
+} SEG7_MARQUEE;
+
+
+u8 seg7_glyph(char c);
+u8 seg7_digit(u8 value);
+u8 seg7_render(u8 out[], u8 width, const char *text);
+void seg7_print(u8 icNumber, const char *text);
+void seg7_format(u8 out[], u32 value, u8 width, u8 dp, bool blank);
+void seg7_printNum(u8 icNumber, u32 value, u8 width, u8 dp, bool blank);
+void seg7_marqueeStart(SEG7_MARQUEE *m, u8 icNumber, const char *text, u16 period, bool loop, u32 now);
+bool seg7_marqueeStep(SEG7_MARQUEE *m, u32 now);
+
+
+#endif /* SRC_SEG7_H_ */
@@ -0,0 +1,46 @@
+/*
+ * switches.c
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#include "switches.h"
+
+// Gather table: logical bit of each snapshot bit (16 * IC + 8 for port B + pin), SW_NONE for the Rotary Enc A/B pins
+static const u8 sw_logical[48] = {
+	// IC1 port A: S1 - S8
+	 1,  2,  3,  4,  5,  6,  7,  8,
+	// IC1 port B: S9, R.Enc 1 (B_2,1), R.Enc switch 1, S10 - S13
+	 9, SW_NONE, SW_NONE, SW_ENC_SW(1), 10, 11, 12, 13,
+	// IC2 port A: S14 - S16, R.Enc 2 (A_4,3), R.Enc switch 2, S17, S18
+	14, 15, 16, SW_NONE, SW_NONE, SW_ENC_SW(2), 17, 18,
+	// IC2 port B: S19 - S25, S35
+	19, 20, 21, 22, 23, 24, 25, 35,
+	// IC3 port A: R.Enc 3 (A_1,0), R.Enc switch 3, S26 - S30
+	SW_NONE, SW_NONE, SW_ENC_SW(3), 26, 27, 28, 29, 30,
+	// IC3 port B: S31 - S34, bits 7-4 are outputs (info leds)
+	31, 32, 33, 34, SW_NONE, SW_NONE, SW_NONE, SW_NONE
+};
+
+
+// Remaps a port snapshot to logical switch order, visits only the set switch inputs
+u64 sw_gather(u64 ports) {
+	u64 logical = 0;
+
+	ports &= SW_PORT_MASK;
+	while (ports != 0) {
+		logical |= (u64)1 << sw_logical[__builtin_ctzll(ports)];
+		ports &= ports - 1;			// clear the lowest set bit
+	}
+	return logical;
+}
+
+// Decodes a (debounced) port snapshot and finds the switches that changed since the previous call
+void sw_decode(SW_DECODE *d, u64 ports) {
+	u64 state = sw_gather(ports);
+
+	d->changed = state ^ d->state;
+	d->pressed = d->changed & state;
+	d->released = d->changed & ~state;
+	d->state = state;
+}
@@ -0,0 +1,42 @@
+/*
+ * switches.h
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#ifndef SRC_SWITCHES_H_
+#define SRC_SWITCHES_H_
+
+#include "xil_types.h"
+#include "stdbool.h"
+
+
+// Bit-parallel switch decoding. The 48-bit MCP23S17 port snapshot (16 bits per IC, port A low byte)
+// is remapped to logical order with a gather table: bit n is switch Sn (1 to 35), bits
+// SW_ENC_SW(1) to SW_ENC_SW(3) the Rotary Enc switches. Only the set bits of the snapshot are
+// visited (count trailing zeros), changes are found with one XOR against the previous state.
+
+#define SW_CNT               35
+#define SW_ENC_SW(n)         (SW_CNT + (n))		// logical bit of Rotary Enc switch n (1 to 3)
+#define SW_NONE              0xFF				// snapshot bit that is not a switch
+
+// Switch and Rotary Enc switch inputs in the port snapshot (the Rotary Enc A/B pins are not)
+#define SW_PORT_MASK         0x0FFCFFE7F9FFULL	// IC3: A_7-2, B_3-0   IC2: A_7-5, A_2-0, B_7-0   IC1: A_7-0, B_7-3, B_0
+
+#define SW_ALL               ((((u64)1 << SW_CNT) - 1) << 1)	// logical bits of S1 to S35
+
+#define SW_BIT(map, n)       (((map) >> (n)) & 1)
+
+typedef struct {
+	u64 state;				// logical switch state, 1 = pressed
+	u64 changed;			// switches that changed in the last sw_decode()
+	u64 pressed;			// of them, the ones now pressed
+	u64 released;			// of them, the ones now released
+} SW_DECODE;
+
+
+u64 sw_gather(u64 ports);
+void sw_decode(SW_DECODE *d, u64 ports);
+
+
+#endif /* SRC_SWITCHES_H_ */
@@ -0,0 +1,87 @@
+/*
+ * telemetry.c
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#include "telemetry.h"
+
+// Parser states
+#define TELEM_STATE_SYNC_1   0
+#define TELEM_STATE_SYNC_2   1
+#define TELEM_STATE_PAYLOAD  2
+
+// Indicator bit n drives switch led S(n+1)
+const u8 telem_flagSw[TELEM_FLAG_CNT] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+
+void telem_init(TELEM_PARSER *parser) {
+	parser->state = TELEM_STATE_SYNC_1;
+	parser->idx = 0;
+	parser->sum = 0;
+	parser->frames = 0;
+	parser->errors = 0;
+}
+
+// Feed one received byte to the parser. Returns true when the byte completes a valid frame,
+// in which case *data is updated. No buffering beyond the parser state, bytes may arrive
+// in any chunk size.
+bool telem_parseByte(TELEM_PARSER *parser, u8 byte, TELEM_DATA *data) {
+	switch (parser->state) {
+	case TELEM_STATE_SYNC_1:
+		if (byte == TELEM_SYNC_1)
+			parser->state = TELEM_STATE_SYNC_2;
+		return false;
+
+	case TELEM_STATE_SYNC_2:
+		if (byte == TELEM_SYNC_2) {
+			parser->state = TELEM_STATE_PAYLOAD;
+			parser->idx = 0;
+			parser->sum = 0;
+		} else if (byte != TELEM_SYNC_1) {		// 0xA5 0xA5 0x5A still synchronises
+			parser->state = TELEM_STATE_SYNC_1;
+		}
+		return false;
+
+	default:
+		parser->payload[parser->idx++] = byte;
+		parser->sum += byte;
+		if (parser->idx < TELEM_PAYLOAD_LEN)
+			return false;
+
+		parser->state = TELEM_STATE_SYNC_1;
+		if (parser->sum != 0x00) {
+			parser->errors++;
+			return false;
+		}
+
+		data->seq   = parser->payload[0];
+		data->rpm   = parser->payload[1] | (parser->payload[2] << 8);
+		data->sp    = parser->payload[3] | (parser->payload[4] << 8);
+		data->fuel  = parser->payload[5];
+		data->flags = parser->payload[6];
+		parser->frames++;
+		return true;
+	}
+}
+
+// Map a telemetry value to the Instrument Panel Cluster dial byte, by linear interpolation
+// between the calibrated dial values (rpm_dial, fuel_dial, sp_dial in main.c).
+// dial[i] is the CAN-Bus value for (i * step) units, dial_cnt is the number of entries.
+u8 telem_mapDial(u16 value, u16 step, const u8 *dial, u8 dial_cnt) {
+	u16 idx = value / step;
+	if (idx >= dial_cnt - 1)
+		return dial[dial_cnt - 1];		// saturate at full scale
+
+	u16 frac = value - (idx * step);
+	u16 span = dial[idx + 1] - dial[idx];
+	return dial[idx] + (u8)(((span * frac) + (step / 2)) / step);
+}
+
+// Dial led position for a telemetry value (same steps as the rotary encoders)
+u8 telem_ledIndex(u16 value, u16 step, u8 dial_cnt) {
+	u16 idx = value / step;
+	if (idx >= dial_cnt)
+		idx = dial_cnt - 1;
+	return (u8)idx;
+}
@@ -0,0 +1,67 @@
+/*
+ * telemetry.h
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#ifndef SRC_TELEMETRY_H_
+#define SRC_TELEMETRY_H_
+
+#include "xil_types.h"
+#include "stdbool.h"
+
+// Binary telemetry frame, sent by the host (e.g. a racing simulator) over the UART at 50-100 Hz.
+// 10 bytes per frame, multi-byte fields are little-endian:
+//
+//   byte 0    : TELEM_SYNC_1 (0xA5)
+//   byte 1    : TELEM_SYNC_2 (0x5A)
+//   byte 2    : sequence number (wraps at 255)
+//   byte 3..4 : engine speed, rpm           (0 - 8000)
+//   byte 5..6 : vehicle speed, km/h         (0 - 240)
+//   byte 7    : fuel tank level, litres     (0 - 48)
+//   byte 8    : indicator bits, bit n drives switch led S(n+1) and its cluster indication (telem_flagSw)
+//   byte 9    : checksum, the 8-bit sum of bytes 2..9 must be 0x00
+//
+// 100 frames/sec need at least 19200 bps, the AXI UartLite should be built for 115200 bps.
+
+#define TELEM_SYNC_1         0xA5
+#define TELEM_SYNC_2         0x5A
+#define TELEM_PAYLOAD_LEN    8			// bytes 2..9 (sequence number to checksum)
+#define TELEM_FRAME_LEN      (TELEM_PAYLOAD_LEN + 2)
+
+// Indicator bits of byte 8: the switch leds S1 - S8 (IC1 port A, the first row of the Control Board).
+// The host addresses the switch leds directly, the cluster indication of each switch follows
+// from the lights[] table in main.c.
+#define TELEM_FLAG_CNT       8
+extern const u8 telem_flagSw[TELEM_FLAG_CNT];		// switch number driven by indicator bit n
+
+// Telemetry units per dial led step, same steps as the rotary encoders
+#define TELEM_RPM_STEP       500
+#define TELEM_FUEL_STEP      6
+#define TELEM_SP_STEP        10
+
+typedef struct {
+	u8 seq;
+	u16 rpm;
+	u16 sp;
+	u8 fuel;
+	u8 flags;
+} TELEM_DATA;
+
+typedef struct {
+	u8 state;					// TELEM_STATE_xxx
+	u8 idx;						// payload bytes received so far
+	u8 sum;						// running checksum of the payload
+	u8 payload[TELEM_PAYLOAD_LEN];
+	u32 frames;					// valid frames decoded
+	u32 errors;					// frames dropped on checksum error
+} TELEM_PARSER;
+
+
+void telem_init(TELEM_PARSER *parser);
+bool telem_parseByte(TELEM_PARSER *parser, u8 byte, TELEM_DATA *data);
+u8 telem_mapDial(u16 value, u16 step, const u8 *dial, u8 dial_cnt);
+u8 telem_ledIndex(u16 value, u16 step, u8 dial_cnt);
+
+
+#endif /* SRC_TELEMETRY_H_ */
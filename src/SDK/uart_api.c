@@ -0,0 +1,65 @@
+/*
+ * uart_api.c
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#include "uart_api.h"
+
+static u8 rx_buf[UART_RX_BUF_SIZE];
+static volatile u16 rx_head = 0;	// written only by uart_poll() (interrupt context)
+static volatile u16 rx_tail = 0;	// written only by uart_recv() (main loop)
+static volatile u32 rx_overflow = 0;	// bytes dropped because the software buffer was full
+
+
+int uart_init() {
+	int Status;
+
+	Status = XUartLite_Initialize(&UartInstance, UART_DEVICE_ID);
+	if (Status != XST_SUCCESS) {
+		xil_printf("UartLite Initialization Failed\r\n");
+		return XST_FAILURE;
+	}
+
+	XUartLite_ResetFifos(&UartInstance);
+	rx_head = 0;
+	rx_tail = 0;
+
+	return XST_SUCCESS;
+}
+
+// Move all bytes waiting in the UartLite receive FIFO into the software buffer.
+// Called from the Timer 2 ISR (every 1 msec), never blocks
+void uart_poll() {
+	u16 head = rx_head;
+
+	while (!XUartLite_IsReceiveEmpty(UART_BASEADDR)) {
+		u8 data = (u8)XUartLite_ReadReg(UART_BASEADDR, XUL_RX_FIFO_OFFSET);
+		u16 next = (head + 1) & (UART_RX_BUF_SIZE - 1);
+		if (next == rx_tail) {
+			rx_overflow++;		// drop the byte, the parser resynchronises on the next frame
+			continue;
+		}
+		rx_buf[head] = data;
+		head = next;
+	}
+	rx_head = head;
+}
+
+// Copy up to MaxCount received bytes to Data, returns the number of bytes copied (0 if none)
+int uart_recv(u8 *Data, int MaxCount) {
+	u16 tail = rx_tail;
+	u16 head = rx_head;
+	int count = 0;
+
+	while ((tail != head) && (count < MaxCount)) {
+		Data[count++] = rx_buf[tail];
+		tail = (tail + 1) & (UART_RX_BUF_SIZE - 1);
+	}
+	rx_tail = tail;
+	return count;
+}
+
+u32 uart_overflows() {
+	return rx_overflow;
+}
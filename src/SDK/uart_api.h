@@ -0,0 +1,32 @@
+/*
+ * uart_api.h
+ *
+ *      Author: Spiropoulos Vasilis
+ */
+
+#ifndef SRC_UART_API_H_
+#define SRC_UART_API_H_
+
+#include "xparameters.h"
+#include "xuartlite.h"
+#include "xuartlite_l.h"
+#include "xstatus.h"
+#include "xil_printf.h"
+
+#define UART_DEVICE_ID  XPAR_UARTLITE_0_DEVICE_ID
+#define UART_BASEADDR   XPAR_UARTLITE_0_BASEADDR
+
+// Software receive buffer, filled from the 1 msec timer interrupt (the AXI UartLite
+// interrupt is not connected). Size must be a power of 2.
+// At 115200 bps about 12 bytes arrive per msec, the UartLite FIFO holds 16.
+#define UART_RX_BUF_SIZE  256
+
+XUartLite UartInstance;	/* The Instance of the UartLite Driver */
+
+int uart_init();
+void uart_poll();
+int uart_recv(u8 *Data, int MaxCount);
+u32 uart_overflows();
+
+
+#endif /* SRC_UART_API_H_ */
@@ -0,0 +1,12 @@
+/*
+ * platform.h
+ *
+ * Host stand-in for the Xilinx SDK platform header, for the host build of the tests only.
+ */
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include "xil_types.h"
+
+#endif /* PLATFORM_H */
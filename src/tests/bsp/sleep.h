@@ -0,0 +1,12 @@
+/*
+ * sleep.h
+ *
+ * Host stand-in for the Xilinx BSP header, for the host build of the tests only.
+ */
+
+#ifndef SLEEP_H
+#define SLEEP_H
+
+#include <unistd.h>
+
+#endif /* SLEEP_H */
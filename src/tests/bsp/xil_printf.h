@@ -0,0 +1,14 @@
+/*
+ * xil_printf.h
+ *
+ * Host stand-in for the Xilinx BSP header, for the host build of the tests only.
+ */
+
+#ifndef XIL_PRINTF_H
+#define XIL_PRINTF_H
+
+#include <stdio.h>
+
+#define xil_printf printf
+
+#endif /* XIL_PRINTF_H */
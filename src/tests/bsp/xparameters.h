@@ -0,0 +1,12 @@
+/*
+ * xparameters.h
+ *
+ * Host stand-in for the Xilinx BSP header, for the host build of the tests only.
+ */
+
+#ifndef XPARAMETERS_H
+#define XPARAMETERS_H
+
+#define XPAR_AXI_QUAD_SPI_0_DEVICE_ID  0
+
+#endif /* XPARAMETERS_H */
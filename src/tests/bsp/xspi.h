@@ -0,0 +1,19 @@
+/*
+ * xspi.h
+ *
+ * Host stand-in for the Xilinx BSP header, for the host build of the tests only.
+ * The tests that link a driver provide the functions they need.
+ */
+
+#ifndef XSPI_H
+#define XSPI_H
+
+#include "xil_types.h"
+
+typedef struct {
+	u32 SlaveSelect;
+} XSpi;
+
+int XSpi_SetSlaveSelect(XSpi *InstancePtr, u32 SlaveMask);
+
+#endif /* XSPI_H */
@@ -0,0 +1,14 @@
+/*
+ * xstatus.h
+ *
+ * Host stand-in for the Xilinx BSP header, for the host build of the tests only.
+ */
+
+#ifndef XSTATUS_H
+#define XSTATUS_H
+
+#define XST_SUCCESS        0L
+#define XST_FAILURE        1L
+#define XST_DEVICE_BUSY    21L
+
+#endif /* XSTATUS_H */
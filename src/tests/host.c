@@ -0,0 +1,9 @@
+/*
+ * host.c
+ *
+ * Common state of the host tests and benchmarks.
+ */
+
+#include "host.h"
+
+int host_failures = 0;
@@ -0,0 +1,35 @@
+/*
+ * host.h
+ *
+ * Common helpers of the host tests and benchmarks: checks and a monotonic clock.
+ */
+
+#ifndef TESTS_HOST_H_
+#define TESTS_HOST_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+extern int host_failures;
+
+// Count and report a failed check, the test continues
+#define CHECK(cond) do { \
+		if (!(cond)) { \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			host_failures++; \
+		} \
+	} while (0)
+
+// Result line and exit code of a test
+#define HOST_RESULT(name) \
+	(printf("%s: %s\n", (name), (host_failures == 0) ? "passed" : "FAILED"), (host_failures == 0) ? 0 : 1)
+
+// Monotonic time in nsec, for the benchmarks
+static inline uint64_t host_nsec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+#endif /* TESTS_HOST_H_ */
@@ -0,0 +1,98 @@
+/*
+ * test_evq.c
+ *
+ * Input event queue (evq.c) with the producer and the consumer running at the same time: a thread
+ * pushes events as the timer and MCP23S17 interrupts would, the main thread pops them. Every event
+ * must come out once, in order and complete, the dropped ones must match the overflow count.
+ * On the board the producer is an interrupt on the same core; two threads on the host also test
+ * that the head is published only after the event is written (x86 keeps the store order).
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include "host.h"
+#include "evq.h"
+
+#define EVENTS          500000
+
+static volatile bool producer_done;
+
+
+// Interrupt stand-in: event n has time n and source n & 1, bursts of up to EVQ_SIZE, then a yield
+static void *producer(void *arg) {
+	for (u32 n = 0; n < EVENTS; n++) {
+		evq_push((u8)(n & 1), n);
+		if ((n % (EVQ_SIZE + 3)) == 0)
+			sched_yield();
+	}
+	producer_done = true;
+	return NULL;
+}
+
+static void test_concurrent() {
+	EVQ_EVENT event;
+	pthread_t thread;
+	u32 popped = 0, dropped = 0;
+	u32 last_time = 0;
+	u8 last_seq = 0;
+	bool first = true, ordered = true, complete = true;
+
+	evq_init();
+	producer_done = false;
+	pthread_create(&thread, NULL, producer, NULL);
+
+	while (true) {
+		bool done = producer_done;			// read before the pop: nothing is pushed after it
+		if (!evq_pop(&event)) {
+			if (done)
+				break;
+			sched_yield();					// let the producer run on a single core host
+			continue;
+		}
+		if (event.source != (event.time & 1))
+			complete = false;
+		if (!first) {
+			u8 gap = (u8)(event.seq - last_seq) - 1;	// events dropped in between
+			if ((event.time <= last_time) || ((u8)(event.time - last_time - 1) != gap))
+				ordered = false;
+			dropped += event.time - last_time - 1;
+		} else {
+			dropped += event.time;
+		}
+		first = false;
+		last_time = event.time;
+		last_seq = event.seq;
+		popped++;
+	}
+	pthread_join(thread, NULL);
+	dropped += EVENTS - 1 - last_time;
+
+	CHECK(ordered);
+	CHECK(complete);
+	CHECK(popped + dropped == EVENTS);
+	CHECK(dropped == evq_overflows());
+	CHECK(evq_count() == 0);
+	CHECK(evq_highWater() <= EVQ_SIZE - 1);
+	printf("Event queue, %d events: %u popped, %u dropped (queue full), high water %u\n",
+			EVENTS, popped, dropped, evq_highWater());
+}
+
+// Single thread: a full queue keeps the oldest events
+static void test_full() {
+	EVQ_EVENT event;
+
+	evq_init();
+	for (u32 n = 0; n < EVQ_SIZE + 5; n++)
+		evq_push(EVQ_SRC_MCP, n);
+	CHECK(evq_count() == EVQ_SIZE - 1);
+	CHECK(evq_overflows() == 6);
+	for (u32 n = 0; n < EVQ_SIZE - 1; n++)
+		CHECK(evq_pop(&event) && (event.time == n) && (event.seq == (u8)(n + 1)));
+	CHECK(!evq_pop(&event));
+}
+
+int main() {
+	test_full();
+	test_concurrent();
+	return HOST_RESULT("evq");
+}
@@ -0,0 +1,80 @@
+/*
+ * test_fade.c
+ *
+ * MAX7221 intensity fading (fade.c): pulses with odd and too short periods, ramps. The chain
+ * transfer is replaced by a capture of the intensity registers written. Built with the address
+ * sanitizer, so a level past FADE_LEVEL_MAX (a read past the curve table) stops the test.
+ */
+
+#include "host.h"
+#include "fade.h"
+
+static u8 intensity[MAX_CNT];			// last intensity register written per chip
+static u32 writes;
+
+
+// Stand-ins for the SPI driver and max7221.c
+int XSpi_SetSlaveSelect(XSpi *InstancePtr, u32 SlaveMask) {
+	return 0;
+}
+
+void sendSPIChain(const u8 opcode[], const u8 data[]) {
+	for (u8 icNumber = 0; icNumber < MAX_CNT; icNumber++) {
+		if (opcode[icNumber] == MAX7221_INTENSITY_REG) {
+			CHECK(data[icNumber] <= 0x0F);
+			intensity[icNumber] = data[icNumber];
+		}
+	}
+	writes++;
+}
+
+// msec of timer ticks, with a fade_task() per FADE_STEP_MS
+static void run(u32 ms) {
+	for (u32 i = 0; i < ms; i++) {
+		fade_tick();
+		if ((i % FADE_STEP_MS) == FADE_STEP_MS - 1)
+			fade_task();
+	}
+}
+
+// Pulse from off to full: over a few periods the register must reach 0x0F and 0x00 and stay in range
+static void test_pulse(u16 period) {
+	u8 reg_min = 0xFF, reg_max = 0;
+
+	fade_init(FADE_LEVEL_NORMAL);
+	run(FADE_STEP_MS);
+	fade_pulse(FADE_ALL, 0, FADE_LEVEL_MAX, period);
+	for (u32 ms = 0; ms < 5 * (u32)period + 100; ms += FADE_STEP_MS) {
+		run(FADE_STEP_MS);
+		if (intensity[0] < reg_min)
+			reg_min = intensity[0];
+		if (intensity[0] > reg_max)
+			reg_max = intensity[0];
+		CHECK((intensity[1] == intensity[0]) && (intensity[2] == intensity[0]));
+	}
+	CHECK(reg_min == 0x00);
+	CHECK(reg_max == 0x0F);
+}
+
+static void test_ramp() {
+	fade_init(0);
+	run(FADE_STEP_MS);
+	CHECK(intensity[0] == 0x00);
+	fade_to(FADE_ALL, FADE_LEVEL_NORMAL, 200);
+	run(100);
+	CHECK((intensity[0] > 0x00) && (intensity[0] < 0x08));
+	run(100);
+	CHECK(intensity[0] == 0x08);			// FADE_LEVEL_NORMAL
+	u32 n = writes;
+	run(100);
+	CHECK(writes == n);						// nothing changed, nothing sent
+}
+
+int main() {
+	test_pulse(800);						// the alarm pulse of main.c
+	test_pulse(801);						// odd: duration - time reaches half + 1
+	test_pulse(21);
+	test_pulse(0);							// raised to 2 * FADE_STEP_MS
+	test_ramp();
+	return HOST_RESULT("fade");
+}
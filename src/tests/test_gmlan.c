@@ -0,0 +1,89 @@
+/*
+ * test_gmlan.c
+ *
+ * GMLAN message builders (gmlan_db.h) and the code generated from the DBC file (gmlan_dbc.c):
+ * the frames must match the hand-packed frames of the original main.c, every generated message
+ * must survive a pack / unpack round trip. Then a benchmark of the generated packing against
+ * the hand-packed template frames.
+ */
+
+#include "host.h"
+#include "gmlan_db.h"
+
+#define BENCH_LOOPS     10000000
+
+
+// Dial frame as the original main.c built it: template frame, then byte patches
+static void hand_dial(CAN_FRAME *frame, u8 cpid, u8 value) {
+	frame->id = 0x255;
+	frame->length = 8;
+	frame->data.low  = 0x0100AE04;
+	frame->data.high = 0x00000000;
+	frame->data.byte[2] = cpid;
+	frame->data.byte[4] = value;
+}
+
+// Every dial value and cluster identifier, against the hand-packed frame
+static void test_dials() {
+	const u8 cpid[3] = {GMLAN_DC_CPID_RPM, GMLAN_DC_CPID_FUEL, GMLAN_DC_CPID_SPEED};
+	CAN_FRAME gen, hand;
+
+	for (int c = 0; c < 3; c++) {
+		for (int v = 0; v < 256; v++) {
+			gmlan_ipcDial(&gen, cpid[c], (u8)v);
+			hand_dial(&hand, cpid[c], (u8)v);
+			CHECK((gen.id == hand.id) && (gen.length == hand.length) && (gen.data.value == hand.data.value));
+		}
+	}
+}
+
+// Generated unpacking of a built frame gives back the fields
+static void test_unpack() {
+	CAN_FRAME frame;
+	GMLAN_IPC_DC dc;
+	GMLAN_HAZARD hazard;
+
+	gmlan_ipcLamps(&frame, 4, 0x5A);
+	gmlan_unpackIpcDc(&frame, &dc);
+	CHECK(dc.dc_pci == GMLAN_DC_PCI_SF_LEN_4);
+	CHECK(dc.dc_sid == GMLAN_DC_SID_DEVICE_CONTROL);
+	CHECK(dc.dc_cpid == 4);
+	CHECK((dc.dc_ctrl == 0x5A) && (dc.dc_value == 0x5A));
+	CHECK(GMLAN_UNPACK(GMLAN_DC_VALUE, frame.data.value) == 0x5A);
+
+	gmlan_hazard(&frame, true);
+	gmlan_unpackHazard(&frame, &hazard);
+	CHECK(hazard.hazard_ctrl == GMLAN_HAZARD_CTRL_ON);
+}
+
+static void bench_pack() {
+	volatile u64 sink = 0;
+	volatile u8 cpid = GMLAN_DC_CPID_RPM;
+	CAN_FRAME frame;
+	u64 t_start, t_hand, t_gen;
+
+	t_start = host_nsec();
+	for (u32 i = 0; i < BENCH_LOOPS; i++) {
+		hand_dial(&frame, cpid, (u8)i);
+		sink ^= frame.data.value;
+	}
+	t_hand = host_nsec() - t_start;
+
+	t_start = host_nsec();
+	for (u32 i = 0; i < BENCH_LOOPS; i++) {
+		gmlan_ipcDial(&frame, cpid, (u8)i);
+		sink ^= frame.data.value;
+	}
+	t_gen = host_nsec() - t_start;
+
+	printf("GMLAN dial frame, %d frames: hand-packed %.2f nsec/frame, generated %.2f nsec/frame\n",
+			BENCH_LOOPS, (double)t_hand / BENCH_LOOPS, (double)t_gen / BENCH_LOOPS);
+}
+
+int main() {
+	CHECK(gmlan_selfTest() == XST_SUCCESS);		// builders against the original frames, round trips
+	test_dials();
+	test_unpack();
+	bench_pack();
+	return HOST_RESULT("gmlan");
+}
@@ -0,0 +1,308 @@
+/*
+ * test_isotp.c
+ *
+ * Two ISO-TP links (isotp.c) paired through a simulated 33.3 kbps single wire CAN-Bus.
+ * The fake MCP2515 layer below replaces mcp2515.c: one transmit buffer (TXB0) and two
+ * receive buffers per controller, one frame on the bus at a time, CAN_FRAME_MS per frame.
+ * Both nodes run as in the main loop, once per msec: receive, isotp_onFrame(), isotp_poll().
+ *
+ * Checks the First Frame / Flow Control / Consecutive Frame sequencing, block size, STmin,
+ * the N_Bs / N_Cr timeouts and the error cases, then measures the transfer rate for a few
+ * BS / STmin settings.
+ */
+
+#include <string.h>
+#include "host.h"
+#include "isotp.h"
+
+#define CAN_FRAME_MS    4			// 8 data bytes, 11-bit identifier, stuffing: ~130 bits at 33.3 kbps
+#define RXB_CNT         2			// MCP2515 receive buffers
+#define LOG_MAX         1024
+
+#define TESTER_ID       0x7E0		// node A sends on this identifier
+#define ECU_ID          0x7E8		// node B sends on this identifier
+
+typedef struct {
+	bool txb_busy;					// TXB0 holds a frame, TXREQ set
+	CAN_FRAME txb;
+	CAN_FRAME rxb[RXB_CNT];
+	u8 rxb_cnt;
+	u32 rx_lost;					// frames lost, both receive buffers full
+	u32 tx_busy;					// sends refused, TXB0 pending
+	bool mute;						// frames sent to this node are lost (peer gone)
+} FAKE_CAN;
+
+typedef struct {
+	u32 time;
+	u8 node;						// sender, 0 = A, 1 = B
+	CAN_FRAME frame;
+} BUS_LOG;
+
+static MCP2515 can[2];
+static FAKE_CAN fake[2];
+static u32 now;
+static u8 bus_node;					// node whose frame is on the bus
+static u32 bus_free;				// time the bus is free again, 0 if idle
+static BUS_LOG bus_log[LOG_MAX];
+static int bus_log_cnt;
+static u8 drop_cf_after;			// 0, or drop every Consecutive Frame after this many
+
+
+// Fake MCP2515 layer used by isotp.c
+static FAKE_CAN *fake_of(MCP2515 *c) {
+	return &fake[(c == &can[0]) ? 0 : 1];
+}
+
+int sendCANMessage(MCP2515 *c, CAN_FRAME *can_message) {
+	FAKE_CAN *f = fake_of(c);
+	if (f->txb_busy) {				// TXREQ still set, the pending frame is kept
+		f->tx_busy++;
+		return XST_DEVICE_BUSY;
+	}
+	f->txb = *can_message;
+	f->txb_busy = true;
+	c->tx_frames++;
+	return XST_SUCCESS;
+}
+
+bool receiveCANMessage(MCP2515 *c, CAN_FRAME *can_message) {
+	FAKE_CAN *f = fake_of(c);
+	if (f->rxb_cnt == 0)
+		return false;
+	*can_message = f->rxb[0];
+	f->rxb[0] = f->rxb[1];
+	f->rxb_cnt--;
+	c->rx_frames++;
+	return true;
+}
+
+// One msec of bus time: finish the frame on the bus, start the next one (node A wins arbitration)
+static void bus_tick() {
+	if ((bus_free != 0) && (now >= bus_free)) {
+		FAKE_CAN *from = &fake[bus_node];
+		FAKE_CAN *to = &fake[bus_node ^ 1];
+		static u8 cf_cnt;
+
+		if ((from->txb.data.byte[0] & 0xF0) == 0x20)
+			cf_cnt++;
+		else
+			cf_cnt = 0;
+		bool dropped = to->mute || ((drop_cf_after != 0) && (cf_cnt > drop_cf_after));
+
+		if (bus_log_cnt < LOG_MAX) {
+			bus_log[bus_log_cnt].time = now;
+			bus_log[bus_log_cnt].node = bus_node;
+			bus_log[bus_log_cnt].frame = from->txb;
+			bus_log_cnt++;
+		}
+		if (!dropped) {
+			if (to->rxb_cnt < RXB_CNT)
+				to->rxb[to->rxb_cnt++] = from->txb;
+			else
+				to->rx_lost++;
+		}
+		from->txb_busy = false;
+		bus_free = 0;
+	}
+	if (bus_free == 0) {
+		for (u8 n = 0; n < 2; n++) {
+			if (fake[n].txb_busy) {
+				bus_node = n;
+				bus_free = now + CAN_FRAME_MS;
+				break;
+			}
+		}
+	}
+}
+
+static void sim_reset(ISOTP_LINK *a, ISOTP_LINK *b, u8 *rx_a, u16 size_a, u8 *rx_b, u16 size_b) {
+	memset(fake, 0, sizeof(fake));
+	now = 1000;
+	bus_free = 0;
+	bus_log_cnt = 0;
+	drop_cf_after = 0;
+	isotp_init(a, &can[0], TESTER_ID, ECU_ID, rx_a, size_a);
+	isotp_init(b, &can[1], ECU_ID, TESTER_ID, rx_b, size_b);
+}
+
+// Main loop of both nodes, once per msec, until node a is done sending or the time is up
+static u32 sim_run(ISOTP_LINK *a, ISOTP_LINK *b, u32 max_ms) {
+	CAN_FRAME frame;
+	u32 start = now;
+
+	while ((now - start) < max_ms) {
+		now++;
+		bus_tick();
+		while (receiveCANMessage(&can[0], &frame))
+			isotp_onFrame(a, &frame, now);
+		while (receiveCANMessage(&can[1], &frame))
+			isotp_onFrame(b, &frame, now);
+		isotp_poll(a, now);
+		isotp_poll(b, now);
+		if ((a->tx_state != ISOTP_BUSY) && (b->rx_state != ISOTP_BUSY) && !fake[0].txb_busy && !fake[1].txb_busy)
+			break;
+	}
+	return now - start;
+}
+
+static void fill(u8 *data, u16 len, u8 seed) {
+	for (u16 i = 0; i < len; i++)
+		data[i] = (u8)(seed + i * 7);
+}
+
+
+static void test_single_frame() {
+	ISOTP_LINK a, b;
+	u8 rx_a[16], rx_b[16], data[7];
+
+	sim_reset(&a, &b, rx_a, sizeof(rx_a), rx_b, sizeof(rx_b));
+	fill(data, 7, 1);
+	CHECK(isotp_send(&a, data, 7, now) == XST_SUCCESS);
+	sim_run(&a, &b, 100);
+
+	CHECK(a.tx_state == ISOTP_DONE);
+	CHECK(isotp_received(&b) == 7);
+	CHECK(memcmp(rx_b, data, 7) == 0);
+	CHECK(bus_log_cnt == 1);
+	CHECK(bus_log[0].frame.data.byte[0] == 0x07);		// SF, length 7
+	CHECK(bus_log[0].frame.length == 8);				// always padded to DLC 8
+	CHECK(isotp_received(&b) == 0);					// reported once
+}
+
+// FF, FC, then blocks of BS consecutive frames with their sequence numbers, a FC after each block,
+// STmin between the consecutive frames
+static void test_sequencing() {
+	ISOTP_LINK a, b;
+	static u8 rx_a[16], rx_b[512], data[300];
+	const u8 bs = 4, stmin = 10;
+
+	sim_reset(&a, &b, rx_a, sizeof(rx_a), rx_b, sizeof(rx_b));
+	isotp_setParams(&b, bs, stmin);
+	fill(data, sizeof(data), 3);
+	CHECK(isotp_send(&a, data, sizeof(data), now) == XST_SUCCESS);
+	CHECK(isotp_send(&a, data, sizeof(data), now) == XST_DEVICE_BUSY);
+	sim_run(&a, &b, 5000);
+
+	CHECK(a.tx_state == ISOTP_DONE);
+	CHECK(isotp_received(&b) == sizeof(data));
+	CHECK(memcmp(rx_b, data, sizeof(data)) == 0);
+
+	int cf_total = (sizeof(data) - 6 + 6) / 7;		// 294 bytes after the FF, 7 per CF, rounded up
+	int cf = 0, fc = 0, in_block = 0;
+	u8 sn = 1;
+	u32 last_cf = 0;
+	CHECK((bus_log[0].node == 0) && (bus_log[0].frame.data.byte[0] == (0x10 | (sizeof(data) >> 8))));
+	CHECK(bus_log[0].frame.data.byte[1] == (sizeof(data) & 0xFF));
+	for (int i = 1; i < bus_log_cnt; i++) {
+		u8 *d = bus_log[i].frame.data.byte;
+		if (bus_log[i].node == 1) {					// Flow Control from the receiver
+			CHECK((d[0] == 0x30) && (d[1] == bs) && (d[2] == stmin));
+			CHECK(in_block == 0 || in_block == bs);
+			in_block = 0;
+			fc++;
+			continue;
+		}
+		CHECK((d[0] & 0xF0) == 0x20);
+		CHECK((d[0] & 0x0F) == sn);
+		CHECK(in_block < bs);						// no CF beyond the block before the next FC
+		if ((in_block > 0) && (last_cf != 0))		// msec ticks: more than stmin apart is at least stmin msec
+			CHECK((bus_log[i].time - last_cf) > stmin);
+		sn = (sn + 1) & 0x0F;
+		in_block++;
+		cf++;
+		last_cf = bus_log[i].time;
+	}
+	CHECK(cf == cf_total);
+	CHECK(fc == (cf_total + bs - 1) / bs);			// one FC after the FF, one after every full block but the last
+}
+
+// N_Bs: the sender gives up when no Flow Control comes
+static void test_timeout_bs() {
+	ISOTP_LINK a, b;
+	u8 rx_a[16], rx_b[64], data[20];
+
+	sim_reset(&a, &b, rx_a, sizeof(rx_a), rx_b, sizeof(rx_b));
+	fake[1].mute = true;							// the peer is gone
+	fill(data, sizeof(data), 5);
+	isotp_send(&a, data, sizeof(data), now);
+	sim_run(&a, &b, ISOTP_TIMEOUT_BS - 10);
+	CHECK(a.tx_state == ISOTP_BUSY);				// still waiting
+	sim_run(&a, &b, 100);
+	CHECK(a.tx_state == ISOTP_ERROR);
+	CHECK(a.errors == 1);
+}
+
+// N_Cr: the receiver gives up when the consecutive frames stop
+static void test_timeout_cr() {
+	ISOTP_LINK a, b;
+	static u8 rx_a[16], rx_b[128], data[100];
+
+	sim_reset(&a, &b, rx_a, sizeof(rx_a), rx_b, sizeof(rx_b));
+	drop_cf_after = 3;
+	fill(data, sizeof(data), 9);
+	isotp_send(&a, data, sizeof(data), now);
+	sim_run(&a, &b, ISOTP_TIMEOUT_CR + 200);
+	CHECK(b.rx_state == ISOTP_ERROR);
+	CHECK(b.errors == 1);
+	CHECK(isotp_received(&b) == 0);
+}
+
+// Payload larger than the receive buffer: FC overflow, the sender aborts
+static void test_overflow() {
+	ISOTP_LINK a, b;
+	static u8 rx_a[16], rx_b[32], data[100];
+
+	sim_reset(&a, &b, rx_a, sizeof(rx_a), rx_b, sizeof(rx_b));
+	fill(data, sizeof(data), 11);
+	isotp_send(&a, data, sizeof(data), now);
+	sim_run(&a, &b, 200);
+	CHECK(a.tx_state == ISOTP_ERROR);
+	CHECK(b.rx_state == ISOTP_ERROR);
+	CHECK((bus_log_cnt == 2) && (bus_log[1].frame.data.byte[0] == 0x32));
+}
+
+// A consecutive frame with a wrong sequence number aborts the reception
+static void test_wrong_sn() {
+	ISOTP_LINK a, b;
+	u8 rx_a[16], rx_b[64];
+	CAN_FRAME ff = {TESTER_ID, 8, {0}}, cf = {TESTER_ID, 8, {0}};
+
+	sim_reset(&a, &b, rx_a, sizeof(rx_a), rx_b, sizeof(rx_b));
+	ff.data.byte[0] = 0x10;
+	ff.data.byte[1] = 20;
+	isotp_onFrame(&b, &ff, now);
+	CHECK(b.rx_state == ISOTP_BUSY);
+	cf.data.byte[0] = 0x22;							// SN 2, 1 expected
+	isotp_onFrame(&b, &cf, now);
+	CHECK(b.rx_state == ISOTP_ERROR);
+}
+
+// Transfer rate of a 4095 byte payload for a few receiver settings
+static void bench_throughput() {
+	static const u8 params[][2] = {{0, 0}, {8, 0}, {0, 5}, {8, 5}, {0, 10}};
+	ISOTP_LINK a, b;
+	static u8 rx_a[16], rx_b[ISOTP_MAX_LEN], data[ISOTP_MAX_LEN];
+
+	fill(data, sizeof(data), 13);
+	for (u8 i = 0; i < sizeof(params) / sizeof(params[0]); i++) {
+		sim_reset(&a, &b, rx_a, sizeof(rx_a), rx_b, sizeof(rx_b));
+		isotp_setParams(&b, params[i][0], params[i][1]);
+		isotp_send(&a, data, sizeof(data), now);
+		u32 ms = sim_run(&a, &b, 60000);
+		CHECK(isotp_received(&b) == sizeof(data));
+		CHECK(memcmp(rx_b, data, sizeof(data)) == 0);
+		printf("ISO-TP 33.3 kbps, BS %2d STmin %2d: %d bytes in %5d msec, %4d bytes/sec, %d frames\n",
+				params[i][0], params[i][1], ISOTP_MAX_LEN, ms, (int)(ISOTP_MAX_LEN * 1000 / ms), bus_log_cnt);
+	}
+}
+
+int main() {
+	test_single_frame();
+	test_sequencing();
+	test_timeout_bs();
+	test_timeout_cr();
+	test_overflow();
+	test_wrong_sn();
+	bench_throughput();
+	return HOST_RESULT("isotp");
+}
@@ -0,0 +1,168 @@
+/*
+ * test_leds.c
+ *
+ * Packed switch leds and dial leds (leds.c): after every change the MAX7221 byte value table
+ * must match the one the bool arrays and fill_led_table() of the original main.c gave. Then a
+ * benchmark of both, every update moves the RPM dial one led and toggles one switch led, and
+ * of a main loop pass without a led change (the original rebuilt the table on every pass).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+#include "leds.h"
+
+#define BENCH_LOOPS     10000000
+#define STEPS           100000
+
+#define RPM_MAX         17
+#define FUEL_MAX        9
+#define SP_MAX          25
+
+
+// Dial leds of the original calc_rpm_leds(), calc_fuel_leds() and calc_sp_leds().
+// Not inlined, as the calls of main.c: inlined in the bench loop, gcc keeps the bytes of the
+// unchanged fuel and speed dials out of the loop.
+static __attribute__((noinline)) void calc_dial(u8 pos, bool dot_mode, bool led[], u8 max) {
+	for (u8 i = 0; i < pos; i++)
+		led[i] = !dot_mode;
+	led[pos] = 1;
+	for (u8 i = pos + 1; i < max; i++)
+		led[i] = 0;
+}
+
+// The original fill_led_table()
+static __attribute__((noinline)) void fill_led_table(bool led_rpm[], bool led_fuel[], bool led_sp[], bool led_sw[], bool *led_sw11_color, u8 mx[][8]) {
+	bool led_sw11_R, led_sw11_Y;
+	led_sw11_R = led_sw[11] & (*led_sw11_color);
+	led_sw11_Y = led_sw[11] & (!(*led_sw11_color));
+
+	mx[0][0] =   led_sw[1] | (  led_sw[2] << 1) | (  led_sw[3] << 2) | (  led_sw[4] << 3) | (  led_sw[5] << 4) | (  led_sw[6] << 5) | (  led_sw[7] << 6) | (  led_sw[8] << 7);
+	mx[0][1] =   led_sw[9] | ( led_sw[10] << 1) | ( led_sw11_R << 2) | ( led_sw11_Y << 3) | ( led_sw[12] << 4) | ( led_sw[13] << 5) | ( led_sw[14] << 6) | ( led_rpm[0] << 7);
+	mx[0][2] =  led_rpm[1] | ( led_rpm[2] << 1) | ( led_rpm[3] << 2) | ( led_rpm[4] << 3) | ( led_rpm[5] << 4) | ( led_rpm[6] << 5) | ( led_rpm[7] << 6) | ( led_rpm[8] << 7);
+	mx[0][3] =  led_rpm[9] | (led_rpm[10] << 1) | (led_rpm[11] << 2) | (led_rpm[12] << 3) | (led_rpm[13] << 4) | (led_rpm[14] << 5) | (led_rpm[15] << 6) | (led_rpm[16] << 7);
+
+	mx[1][1] =  led_sw[23] | ( led_sw[22] << 1) | ( led_sw[21] << 2) | ( led_sw[20] << 3) | ( led_sw[24] << 4) | ( led_sw[25] << 5) | ( led_sw[35] << 6) | (  led_sp[0] << 7);
+	mx[1][2] =  led_sw[15] | ( led_sw[16] << 1) | ( led_sw[17] << 2) | ( led_sw[18] << 3) | ( led_sw[19] << 4) | ( led_sw[26] << 5)                      | (led_fuel[0] << 7);
+	mx[1][3] = led_fuel[1] | (led_fuel[2] << 1) | (led_fuel[3] << 2) | (led_fuel[4] << 3) | (led_fuel[5] << 4) | (led_fuel[6] << 5) | (led_fuel[7] << 6) | (led_fuel[8] << 7);
+
+	mx[2][0] =  led_sw[27] | ( led_sw[28] << 1) | ( led_sw[29] << 2) | ( led_sw[30] << 3) | ( led_sw[31] << 4) | ( led_sw[32] << 5) | ( led_sw[33] << 6) | ( led_sw[34] << 7);
+	mx[2][1] =   led_sp[1] | (  led_sp[2] << 1) | (  led_sp[3] << 2) | (  led_sp[4] << 3) | (  led_sp[5] << 4) | (  led_sp[6] << 5) | (  led_sp[7] << 6) | (  led_sp[8] << 7);
+	mx[2][2] =   led_sp[9] | ( led_sp[10] << 1) | ( led_sp[11] << 2) | ( led_sp[12] << 3) | ( led_sp[13] << 4) | ( led_sp[14] << 5) | ( led_sp[15] << 6) | ( led_sp[16] << 7);
+	mx[2][3] =  led_sp[17] | ( led_sp[18] << 1) | ( led_sp[19] << 2) | ( led_sp[20] << 3) | ( led_sp[21] << 4) | ( led_sp[22] << 5) | ( led_sp[23] << 6) | ( led_sp[24] << 7);
+}
+
+// Random switch toggles, dial moves, mode and S11 color changes, applied to both representations
+static void test_table() {
+	bool led_rpm[RPM_MAX] = {0}, led_fuel[FUEL_MAX] = {0}, led_sp[SP_MAX] = {0}, led_sw[36] = {0};
+	bool sw11_color = 0;
+	u8 mx_bool[3][8] = {{0}}, mx_packed[3][8] = {{0}};
+	LED_STATE s;
+
+	led_init(&s);
+	srand(4321);
+	for (int n = 0; n < STEPS; n++) {
+		u8 pos, sw_i;
+		bool dot = rand() & 1;
+		switch (rand() % 5) {
+		case 0:
+			pos = rand() % RPM_MAX;
+			calc_dial(pos, dot, led_rpm, RPM_MAX);
+			s.word[LED_W_RPM] = led_dialMask(pos, dot);
+			break;
+		case 1:
+			pos = rand() % FUEL_MAX;
+			calc_dial(pos, dot, led_fuel, FUEL_MAX);
+			s.word[LED_W_FUEL] = led_dialMask(pos, dot);
+			break;
+		case 2:
+			pos = rand() % SP_MAX;
+			calc_dial(pos, dot, led_sp, SP_MAX);
+			s.word[LED_W_SP] = led_dialMask(pos, dot);
+			break;
+		case 3:
+			sw11_color = !sw11_color;
+			break;
+		default:
+			sw_i = 1 + rand() % 35;
+			led_sw[sw_i] = !led_sw[sw_i];
+			LED_PUT(s.word, sw_i, led_sw[sw_i]);
+			break;
+		}
+
+		fill_led_table(led_rpm, led_fuel, led_sp, led_sw, &sw11_color, mx_bool);
+		if (led_gather(&s, sw11_color) != 0)
+			led_toTable(&s, mx_packed);
+		else if (memcmp(mx_bool, mx_packed, sizeof(mx_bool)) != 0) {
+			CHECK(!"led change not reported");
+			printf("  step %d\n", n);
+			return;
+		}
+		for (int ic = 0; ic < 3; ic++) {
+			for (int d = 0; d < 4; d++) {
+				if ((ic == 1) && (d == 0))			// MAX_2 digit 0 not used
+					continue;
+				if (mx_bool[ic][d] != mx_packed[ic][d]) {
+					CHECK(!"led table differs");
+					printf("  step %d, mx[%d][%d] %02X, expected %02X\n", n, ic, d, mx_packed[ic][d], mx_bool[ic][d]);
+					return;
+				}
+			}
+		}
+	}
+}
+
+static void bench_leds() {
+	static bool led_rpm[RPM_MAX], led_fuel[FUEL_MAX], led_sp[SP_MAX], led_sw[36];
+	static LED_STATE s;
+	volatile u32 sink = 0;
+	bool sw11_color = 0;
+	u8 mx[3][8];
+	u64 t_start, t_bool, t_packed, t_bool_idle, t_packed_idle;
+
+	t_start = host_nsec();
+	for (u32 i = 0; i < BENCH_LOOPS; i++) {
+		calc_dial(i % RPM_MAX, false, led_rpm, RPM_MAX);
+		led_sw[1 + (i % 35)] ^= 1;
+		fill_led_table(led_rpm, led_fuel, led_sp, led_sw, &sw11_color, mx);
+		sink ^= mx[0][2] ^ mx[1][1];
+	}
+	t_bool = host_nsec() - t_start;
+
+	led_init(&s);
+	t_start = host_nsec();
+	for (u32 i = 0; i < BENCH_LOOPS; i++) {
+		s.word[LED_W_RPM] = led_dialMask(i % RPM_MAX, false);
+		s.word[(1 + (i % 35)) >> 5] ^= (u32)1 << ((1 + (i % 35)) & 0x1F);
+		if (led_gather(&s, sw11_color) != 0)
+			led_toTable(&s, mx);
+		sink ^= mx[0][2] ^ mx[1][1];
+	}
+	t_packed = host_nsec() - t_start;
+
+	t_start = host_nsec();
+	for (u32 i = 0; i < BENCH_LOOPS; i++) {
+		fill_led_table(led_rpm, led_fuel, led_sp, led_sw, &sw11_color, mx);
+		sink ^= mx[0][2] ^ mx[1][1];
+	}
+	t_bool_idle = host_nsec() - t_start;
+
+	t_start = host_nsec();
+	for (u32 i = 0; i < BENCH_LOOPS; i++) {
+		if (led_gather(&s, sw11_color) != 0)
+			led_toTable(&s, mx);
+		sink ^= mx[0][2] ^ mx[1][1];
+	}
+	t_packed_idle = host_nsec() - t_start;
+
+	printf("Leds, %d updates: bool arrays %.2f nsec/update, packed %.2f nsec/update\n",
+			BENCH_LOOPS, (double)t_bool / BENCH_LOOPS, (double)t_packed / BENCH_LOOPS);
+	printf("Leds, %d passes without a change: bool arrays %.2f nsec/pass, packed %.2f nsec/pass\n",
+			BENCH_LOOPS, (double)t_bool_idle / BENCH_LOOPS, (double)t_packed_idle / BENCH_LOOPS);
+}
+
+int main() {
+	test_table();
+	bench_leds();
+	return HOST_RESULT("leds");
+}
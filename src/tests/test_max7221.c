@@ -0,0 +1,83 @@
+/*
+ * test_max7221.c
+ *
+ * MAX7221 shadow framebuffer (max7221.c): random deferred digit writes are flushed through a
+ * model of the chain, which must end up with the requested frame. Every transfer must hold
+ * a command or a NO-OP in each slot, and a command after a flush must find the other slots
+ * back at NO-OP.
+ */
+
+#include <stdlib.h>
+#include "host.h"
+#include "max7221.h"
+
+#define ROUNDS          20000
+
+static u8 chip[MAX_CNT][8];				// digit registers of the modelled chips
+static u8 last[MAX_CNT * 2];			// last transfer
+static u32 transfers;
+
+
+// Stand-ins for the SPI driver: the chain is shifted out last chip first
+int XSpi_SetSlaveSelect(XSpi *InstancePtr, u32 SlaveMask) {
+	return 0;
+}
+
+void send_spi_data(u8 *Data, int ByteCount) {
+	CHECK(ByteCount == MAX_CNT * 2);
+	for (int i = 0; i < ByteCount; i++)
+		last[i] = Data[i];
+	for (u8 icNumber = 0; icNumber < MAX_CNT; icNumber++) {
+		u8 opcode = Data[(MAX_CNT - 1 - icNumber) * 2];
+		u8 data = Data[(MAX_CNT - 1 - icNumber) * 2 + 1];
+		if ((opcode >= MAX7221_DIGIT0_REG) && (opcode <= MAX7221_DIGIT7_REG))
+			chip[icNumber][opcode - MAX7221_DIGIT0_REG] = data;
+		else if (opcode == MAX7221_NO_OP_REG)
+			CHECK(data == 0x00);
+	}
+	transfers++;
+}
+
+static void test_flush() {
+	u8 frame[MAX_CNT][8] = {{0}};
+
+	srand(99);
+	for (int n = 0; n < ROUNDS; n++) {
+		for (int w = rand() % 6; w > 0; w--) {
+			u8 icNumber = rand() % MAX_CNT;
+			u8 digit = rand() % 8;
+			frame[icNumber][digit] = rand() & 0xFF;
+			setRowDeferred(icNumber, digit, frame[icNumber][digit]);
+		}
+		u32 before = transfers;
+		flushMAX7221();
+		CHECK(transfers - before <= 8);			// one transfer per digit at most
+
+		for (u8 icNumber = 0; icNumber < MAX_CNT; icNumber++) {
+			for (u8 digit = 0; digit < 8; digit++) {
+				if (chip[icNumber][digit] != frame[icNumber][digit]) {
+					CHECK(!"chip differs from the frame");
+					printf("  round %d, chip %d digit %d\n", n, icNumber, digit);
+					return;
+				}
+			}
+		}
+
+		// A single command after the flush: the other slots are NO-OPs
+		u8 icNumber = rand() % MAX_CNT;
+		sendSPICommand(icNumber, MAX7221_INTENSITY_REG, 0x05);
+		for (u8 i = 0; i < MAX_CNT; i++) {
+			u8 *slot = &last[(MAX_CNT - 1 - i) * 2];
+			if (i == icNumber)
+				CHECK((slot[0] == MAX7221_INTENSITY_REG) && (slot[1] == 0x05));
+			else
+				CHECK((slot[0] == MAX7221_NO_OP_REG) && (slot[1] == 0x00));
+		}
+	}
+	CHECK(flushMAX7221() == 0);					// nothing left
+}
+
+int main() {
+	test_flush();
+	return HOST_RESULT("max7221");
+}
@@ -0,0 +1,151 @@
+/*
+ * test_seg7.c
+ *
+ * 7-seg glyph renderer (seg7.c): seg7_format() must give the digits of the / and % split that
+ * show_num_rpm() and show_num_sp() of the original main.c used, for every 4 digit value. Then a
+ * benchmark of both. On the host / and % by a constant compile to multiplies, so the split is
+ * also timed with the division of a MicroBlaze without the hardware divider (the default): a
+ * libgcc call that computes one quotient bit per loop iteration. The display back buffer is
+ * replaced by a capture of the rows.
+ */
+
+#include "host.h"
+#include "seg7.h"
+
+#define BENCH_LOOPS     10000000
+
+static u8 rows[MAX_CNT + 1][8];
+static u32 soft_iterations;			// loop iterations of soft_udivmod()
+
+
+// Stand-in for display.c: keep the row the renderer writes
+void display_setRow(u8 icNumber, u8 row, u8 value) {
+	rows[icNumber][row] = value;
+}
+
+// Digit split of the original show_num_rpm()
+static void div_split(unsigned int value, u8 digit[]) {
+	digit[0] = value / 1000;
+	value = value - (digit[0] * 1000);
+	digit[1] = value / 100;
+	value = value - (digit[1] * 100);
+	digit[2] = value / 10;
+	value = value - (digit[2] * 10);
+	digit[3] = value % 10;
+}
+
+// Division without the hardware divider: restoring shift & subtract, one quotient bit per
+// iteration, as __udivsi3 / __umodsi3 of libgcc for the MicroBlaze. Not inlined, a call as there.
+static __attribute__((noinline)) u32 soft_udivmod(u32 n, u32 d, u32 *rem) {
+	u32 q = 0, r = 0;
+
+	for (int i = 31; i >= 0; i--) {
+		r = (r << 1) | ((n >> i) & 1);
+		if (r >= d) {
+			r -= d;
+			q |= (u32)1 << i;
+		}
+		soft_iterations++;
+	}
+	*rem = r;
+	return q;
+}
+
+// Digit split of the original show_num_rpm(), with the divisions of a MicroBlaze (library calls)
+static void soft_div_split(unsigned int value, u8 digit[]) {
+	u32 rem;
+
+	digit[0] = soft_udivmod(value, 1000, &rem);
+	value = value - (digit[0] * 1000);
+	digit[1] = soft_udivmod(value, 100, &rem);
+	value = value - (digit[1] * 100);
+	digit[2] = soft_udivmod(value, 10, &rem);
+	value = value - (digit[2] * 10);
+	soft_udivmod(value, 10, &rem);
+	digit[3] = rem;
+}
+
+static void test_format() {
+	u8 out[SEG7_WIDTH], digit[SEG7_WIDTH];
+
+	for (u32 v = 0; v < 10000; v++) {
+		seg7_format(out, v, SEG7_WIDTH, SEG7_DP_NONE, false);
+		div_split(v, digit);
+		for (int i = 0; i < SEG7_WIDTH; i++) {
+			if (out[i] != seg7_digit(digit[i])) {
+				CHECK(!"seg7_format digit differs");
+				printf("  value %u, digit %d\n", v, i);
+				return;
+			}
+		}
+		soft_div_split(v, out);
+		for (int i = 0; i < SEG7_WIDTH; i++) {
+			if (out[i] != digit[i]) {
+				CHECK(!"soft division split differs");
+				printf("  value %u, digit %d\n", v, i);
+				return;
+			}
+		}
+	}
+
+	seg7_format(out, 12345, SEG7_WIDTH, SEG7_DP_NONE, false);	// saturates
+	CHECK((out[0] == seg7_digit(9)) && (out[3] == seg7_digit(9)));
+	seg7_format(out, 7, SEG7_WIDTH, 1, SEG7_BLANK_ZEROS);		// " 0.7"
+	CHECK((out[0] == SEG7_BLANK) && (out[1] == SEG7_BLANK));
+	CHECK((out[2] == (seg7_digit(0) | SEG7_DP)) && (out[3] == seg7_digit(7)));
+}
+
+static void test_render() {
+	u8 out[SEG7_WIDTH];
+
+	CHECK(seg7_render(out, SEG7_WIDTH, "rPM") == 3);
+	CHECK((out[0] == seg7_glyph('r')) && (out[2] == seg7_glyph('M')) && (out[3] == SEG7_BLANK));
+	CHECK(seg7_render(out, SEG7_WIDTH, "1.2.3") == 3);
+	CHECK((out[0] == (seg7_digit(1) | SEG7_DP)) && (out[1] == (seg7_digit(2) | SEG7_DP)));
+
+	seg7_printNum(MAX_1, 42, 3, SEG7_DP_NONE, SEG7_BLANK_ZEROS);
+	CHECK((rows[MAX_1][7] == SEG7_BLANK) && (rows[MAX_1][6] == SEG7_BLANK));
+	CHECK((rows[MAX_1][5] == seg7_digit(4)) && (rows[MAX_1][4] == seg7_digit(2)));
+}
+
+static void bench_format() {
+	volatile u32 sink = 0;
+	volatile u32 step = 9;
+	u8 out[SEG7_WIDTH];
+	u64 t_start, t_div, t_soft, t_fmt;
+
+	t_start = host_nsec();
+	for (u32 i = 0; i < BENCH_LOOPS; i++) {
+		div_split((i * step) % 10000, out);
+		sink ^= out[0] ^ out[1] ^ out[2] ^ out[3];
+	}
+	t_div = host_nsec() - t_start;
+
+	soft_iterations = 0;
+	t_start = host_nsec();
+	for (u32 i = 0; i < BENCH_LOOPS; i++) {
+		soft_div_split((i * step) % 10000, out);
+		sink ^= out[0] ^ out[1] ^ out[2] ^ out[3];
+	}
+	t_soft = host_nsec() - t_start;
+
+	t_start = host_nsec();
+	for (u32 i = 0; i < BENCH_LOOPS; i++) {
+		seg7_format(out, (i * step) % 10000, SEG7_WIDTH, SEG7_DP_NONE, false);
+		sink ^= out[0] ^ out[1] ^ out[2] ^ out[3];
+	}
+	t_fmt = host_nsec() - t_start;
+
+	printf("7-seg format, %d numbers: / and %% (host multiplies) %.2f nsec/number, seg7_format %.2f nsec/number (glyphs included)\n",
+			BENCH_LOOPS, (double)t_div / BENCH_LOOPS, (double)t_fmt / BENCH_LOOPS);
+	printf("7-seg format, MicroBlaze division: 4 calls, %u loop iterations/number, %.2f nsec/number on the host; "
+			"seg7_format: 4 multiplies, no calls\n",
+			soft_iterations / BENCH_LOOPS, (double)t_soft / BENCH_LOOPS);
+}
+
+int main() {
+	test_format();
+	test_render();
+	bench_format();
+	return HOST_RESULT("seg7");
+}
@@ -0,0 +1,203 @@
+/*
+ * test_telemetry.c
+ *
+ * Telemetry stream parser (telemetry.c) fed through a pseudo terminal, as the UART bytes
+ * arrive on the board: the stream is written to the pty master in random chunks, the parser
+ * reads the pty slave in chunks of up to 32 bytes (rx_data[] in main.c).
+ *
+ * Usage: test_telemetry              generated stream with noise, bad checksums and false syncs
+ *        test_telemetry <file>       replay a recorded stream, print the decoded frames
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <pthread.h>
+#include "host.h"
+#include "telemetry.h"
+
+#define STREAM_MAX      65536
+#define FRAMES_MAX      2048
+
+static u8 stream[STREAM_MAX];
+static size_t stream_len;
+static TELEM_DATA expected[FRAMES_MAX];
+static int expected_cnt;
+
+typedef struct {
+	int fd;
+	const u8 *data;
+	size_t len;
+} PTY_WRITER;
+
+
+// Append one frame, with a valid or a broken checksum
+static void put_frame(TELEM_DATA *d, bool valid) {
+	u8 *f = &stream[stream_len];
+	u8 sum = 0;
+
+	f[0] = TELEM_SYNC_1;
+	f[1] = TELEM_SYNC_2;
+	f[2] = d->seq;
+	f[3] = d->rpm & 0xFF;
+	f[4] = d->rpm >> 8;
+	f[5] = d->sp & 0xFF;
+	f[6] = d->sp >> 8;
+	f[7] = d->fuel;
+	f[8] = d->flags;
+	for (int i = 2; i < TELEM_FRAME_LEN - 1; i++)
+		sum += f[i];
+	f[9] = (u8)(0 - sum) ^ (valid ? 0x00 : 0x01);
+	stream_len += TELEM_FRAME_LEN;
+
+	if (valid)
+		expected[expected_cnt++] = *d;
+}
+
+// Recorded-like stream at 100 frames/sec: sweeps, noise between frames, a false sync
+// (0xA5 0xA5 0x5A) and frames with a bad checksum
+static void make_stream() {
+	TELEM_DATA d;
+
+	srand(1234);
+	for (int n = 0; n < 1500; n++) {
+		d.seq = (u8)n;
+		d.rpm = (n * 37) % 8001;
+		d.sp = (n / 3) % 241;
+		d.fuel = 48 - (n % 49);
+		d.flags = (u8)(n >> 4);
+
+		if ((n % 50) == 7) {			// line noise, without sync bytes
+			for (int i = rand() % 5; i > 0; i--)
+				stream[stream_len++] = 0x11 * (1 + rand() % 8);
+		}
+		if ((n % 97) == 3)				// false sync, the frame follows
+			stream[stream_len++] = TELEM_SYNC_1;
+		put_frame(&d, (n % 101) != 50);
+	}
+}
+
+static void *pty_write(void *arg) {
+	PTY_WRITER *w = arg;
+	size_t pos = 0;
+
+	while (pos < w->len) {
+		size_t cnt = 1 + rand() % 40;
+		if (cnt > w->len - pos)
+			cnt = w->len - pos;
+		ssize_t n = write(w->fd, w->data + pos, cnt);
+		if (n < 0)
+			break;
+		pos += n;
+	}
+	return NULL;
+}
+
+// Send the stream through a raw mode pty, parse what comes out. Returns the frames decoded.
+static int pty_parse(const u8 *data, size_t len, TELEM_PARSER *parser, TELEM_DATA *out, int out_max) {
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	CHECK(master >= 0);
+	CHECK(grantpt(master) == 0);
+	CHECK(unlockpt(master) == 0);
+	int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+	CHECK(slave >= 0);
+
+	struct termios tio;
+	tcgetattr(slave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(slave, TCSANOW, &tio);
+
+	PTY_WRITER w = {master, data, len};
+	pthread_t writer;
+	pthread_create(&writer, NULL, pty_write, &w);
+
+	u8 rx_data[32];
+	TELEM_DATA d;
+	size_t received = 0;
+	int frames = 0;
+	while (received < len) {
+		ssize_t rx_cnt = read(slave, rx_data, sizeof(rx_data));
+		if (rx_cnt <= 0)
+			break;
+		received += rx_cnt;
+		for (int i = 0; i < rx_cnt; i++) {
+			if (telem_parseByte(parser, rx_data[i], &d) && (frames < out_max))
+				out[frames++] = d;
+		}
+	}
+
+	pthread_join(writer, NULL);
+	close(slave);
+	close(master);
+	CHECK(received == len);
+	return frames;
+}
+
+static void test_stream() {
+	static TELEM_DATA decoded[FRAMES_MAX];
+	TELEM_PARSER parser;
+
+	make_stream();
+	telem_init(&parser);
+	int frames = pty_parse(stream, stream_len, &parser, decoded, FRAMES_MAX);
+
+	CHECK(frames == expected_cnt);
+	CHECK(parser.frames == (u32)expected_cnt);
+	CHECK(parser.errors == 15);					// frames 50, 151, ... 1464 of the sweep
+	for (int i = 0; (i < frames) && (i < expected_cnt); i++) {
+		if ((decoded[i].seq != expected[i].seq) || (decoded[i].rpm != expected[i].rpm) || (decoded[i].sp != expected[i].sp)
+				|| (decoded[i].fuel != expected[i].fuel) || (decoded[i].flags != expected[i].flags)) {
+			CHECK(!"decoded frame differs");
+			printf("  frame %d: seq %d rpm %d, expected seq %d rpm %d\n", i,
+					decoded[i].seq, decoded[i].rpm, expected[i].seq, expected[i].rpm);
+			break;
+		}
+	}
+}
+
+static void test_mapping() {
+	const u8 rpm_dial[17] = {0, 10, 21, 30, 41, 50, 60, 70, 79, 89, 99, 109, 118, 128, 138, 148, 158};
+
+	CHECK(telem_mapDial(0, TELEM_RPM_STEP, rpm_dial, 17) == 0);
+	CHECK(telem_mapDial(500, TELEM_RPM_STEP, rpm_dial, 17) == 10);
+	CHECK(telem_mapDial(750, TELEM_RPM_STEP, rpm_dial, 17) == 16);		// half way 10 - 21, rounded
+	CHECK(telem_mapDial(8000, TELEM_RPM_STEP, rpm_dial, 17) == 158);
+	CHECK(telem_mapDial(9999, TELEM_RPM_STEP, rpm_dial, 17) == 158);		// saturates
+	CHECK(telem_ledIndex(7999, TELEM_RPM_STEP, 17) == 15);
+	CHECK(telem_ledIndex(65535, TELEM_RPM_STEP, 17) == 16);
+
+	for (int bit = 0; bit < TELEM_FLAG_CNT; bit++)
+		CHECK(telem_flagSw[bit] == bit + 1);
+}
+
+static int replay(const char *path) {
+	static TELEM_DATA decoded[FRAMES_MAX];
+	TELEM_PARSER parser;
+	FILE *f = fopen(path, "rb");
+
+	if (f == NULL) {
+		perror(path);
+		return 1;
+	}
+	stream_len = fread(stream, 1, sizeof(stream), f);
+	fclose(f);
+
+	telem_init(&parser);
+	int frames = pty_parse(stream, stream_len, &parser, decoded, FRAMES_MAX);
+	for (int i = 0; i < frames; i++)
+		printf("seq %3d  rpm %5d  speed %3d  fuel %2d  flags %02X\n",
+				decoded[i].seq, decoded[i].rpm, decoded[i].sp, decoded[i].fuel, decoded[i].flags);
+	printf("%zu bytes, %u frames, %u checksum errors\n", stream_len, parser.frames, parser.errors);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc > 1)
+		return replay(argv[1]);
+
+	test_stream();
+	test_mapping();
+	return HOST_RESULT("telemetry");
+}